@@ -0,0 +1,83 @@
+/**
+* Copyright (C) 2018 Chalmers Revere
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+* USA.
+*/
+
+#include <chrono>
+#include <thread>
+#include <utility>
+
+#include "clock.hpp"
+
+Clock::Clock(bool replay) :
+  m_replay(replay)
+, m_timeMutex()
+, m_timeCondition()
+, m_listenerMutex()
+, m_listener()
+{
+}
+
+cluon::data::TimeStamp Clock::now(){
+  if(!m_replay){
+    return cluon::time::now();
+  }
+  std::lock_guard<std::mutex> lockTime(m_timeMutex);
+  return cluon::time::fromMicroseconds(m_now);
+}
+
+void Clock::update(cluon::data::TimeStamp const &sampleTime){
+  if(!m_replay){
+    return;
+  }
+  int64_t sampleMicroseconds = cluon::time::toMicroseconds(sampleTime);
+  {
+    std::lock_guard<std::mutex> lockTime(m_timeMutex);
+    if(sampleMicroseconds <= m_now){ //Time never goes backwards
+      return;
+    }
+    m_now = sampleMicroseconds;
+  }
+  m_timeCondition.notify_all();
+  std::lock_guard<std::mutex> lockListener(m_listenerMutex);
+  if(m_listener){
+    m_listener(sampleTime);
+  }
+}
+
+bool Clock::waitUntil(cluon::data::TimeStamp const &deadline){
+  int64_t deadlineMicroseconds = cluon::time::toMicroseconds(deadline);
+  if(!m_replay){
+    int64_t remaining = deadlineMicroseconds - cluon::time::toMicroseconds(cluon::time::now());
+    if(remaining > 0){
+      std::this_thread::sleep_for(std::chrono::microseconds(remaining));
+    }
+    return true;
+  }
+  //Replayed time only moves with new data, so return now and then to let callers check for shutdown
+  std::unique_lock<std::mutex> lockTime(m_timeMutex);
+  return m_timeCondition.wait_for(lockTime, std::chrono::milliseconds(100), [this, deadlineMicroseconds]{return m_now >= deadlineMicroseconds;});
+}
+
+bool Clock::isReplay() const{
+  return m_replay;
+}
+
+void Clock::setListener(std::function<void(cluon::data::TimeStamp const &)> listener){
+  std::lock_guard<std::mutex> lockListener(m_listenerMutex);
+  m_listener = std::move(listener);
+}
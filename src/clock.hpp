@@ -0,0 +1,60 @@
+/**
+ * Copyright (C) 2018 Chalmers Revere
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+
+#ifndef CLOCK_HPP
+#define CLOCK_HPP
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include "cluon-complete.hpp"
+
+/*
+ * Source of time for every timing decision. Live it follows the wall clock,
+ * in replay mode it only moves when sample timestamps are fed in so recorded
+ * data can be processed as fast as it arrives with the same results each run.
+ * Timed output in replay hangs on the listener instead of a thread waiting on
+ * the clock, it then runs on the thread that fed the time in.
+ */
+class Clock {
+ private:
+  Clock(const Clock &) = delete;
+  Clock(Clock &&)      = delete;
+  Clock &operator=(const Clock &) = delete;
+  Clock &operator=(Clock &&) = delete;
+ public:
+  explicit Clock(bool replay);
+  ~Clock() = default;
+  cluon::data::TimeStamp now();
+  void update(cluon::data::TimeStamp const &sampleTime);
+  bool waitUntil(cluon::data::TimeStamp const &deadline);
+  bool isReplay() const;
+  //Replay only, called each time update moves the clock forward. nullptr removes it
+  void setListener(std::function<void(cluon::data::TimeStamp const &)> listener);
+
+ private:
+  const bool m_replay;
+  std::mutex m_timeMutex;
+  std::condition_variable m_timeCondition;
+  int64_t m_now = 0;
+  std::mutex m_listenerMutex;
+  std::function<void(cluon::data::TimeStamp const &)> m_listener;
+};
+
+#endif
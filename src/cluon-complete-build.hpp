@@ -3925,7 +3925,7 @@ class LIB_API Envelope {
         int32_t dataType() const noexcept;
         
         Envelope& serializedData(const std::string &v) noexcept;
-        std::string serializedData() const noexcept;
+        const std::string &serializedData() const noexcept;
         
         Envelope& sent(const cluon::data::TimeStamp &v) noexcept;
         cluon::data::TimeStamp sent() const noexcept;
@@ -5108,6 +5108,7 @@ namespace cluon {
 #include <mutex>
 #include <string>
 #include <utility>
+#include <vector>
 
 namespace cluon {
 /**
@@ -5162,6 +5163,28 @@ class LIBCLUON_API UDPSender {
      */
     std::pair<ssize_t, int32_t> send(std::string &&data) const noexcept;
 
+    /**
+     * Send a burst of strings, one UDP packet per string. On Linux, the
+     * burst is handed to the kernel with sendmmsg in chunks of
+     * MAX_PACKETS_PER_SYSCALL packets; elsewhere sendto is called per packet.
+     *
+     * @param data Strings to send; the vector is cleared afterwards.
+     * @return Pair: Number of packets sent and errno.
+     */
+    std::pair<ssize_t, int32_t> send(std::vector<std::string> &&data) const noexcept;
+
+    /**
+     * Send a burst of strings like above, leaving them untouched so that
+     * the caller can reuse their buffers.
+     *
+     * @param data First string to send.
+     * @param count Number of strings to send.
+     * @return Pair: Number of packets sent and errno.
+     */
+    std::pair<ssize_t, int32_t> send(const std::string *data, std::size_t count) const noexcept;
+
+    static constexpr uint32_t MAX_PACKETS_PER_SYSCALL{64};
+
    public:
     /**
      * @return Port that this UDP sender will use for sending or 0 if no information available.
@@ -5277,8 +5300,35 @@ class LIBCLUON_API UDPReceiver {
                 uint16_t receiveFromPort,
                 std::function<void(std::string &&, std::string &&, std::chrono::system_clock::time_point &&)> delegate,
                 uint16_t localSendFromPort = 0) noexcept;
+
+    /**
+     * One received UDP packet: received data, sender, timestamp.
+     */
+    class Datagram {
+       public:
+        std::string m_data;
+        std::string m_from;
+        std::chrono::system_clock::time_point m_sampleTime;
+    };
+
+    /**
+     * Constructor for batch mode: on Linux, up to MAX_PACKETS_PER_SYSCALL
+     * packets are read per recvmmsg call and all packets that are pending
+     * when the delegate is called are handed over at once in arrival order.
+     *
+     * @param receiveFromAddress Numerical IPv4 address to receive UDP packets from.
+     * @param receiveFromPort Port to receive UDP packets from.
+     * @param batchDelegate Functional (noexcept) to handle a batch of received packets.
+     * @param localSendFromPort Port that an application is using to send data. This port (> 0) is ignored when data is received.
+     */
+    UDPReceiver(const std::string &receiveFromAddress,
+                uint16_t receiveFromPort,
+                std::function<void(std::vector<Datagram> &&)> batchDelegate,
+                uint16_t localSendFromPort = 0) noexcept;
     ~UDPReceiver() noexcept;
 
+    static constexpr uint32_t MAX_PACKETS_PER_SYSCALL{64};
+
     /**
      * @return true if the UDPReceiver could successfully be created and is able to receive data.
      */
@@ -5292,8 +5342,20 @@ class LIBCLUON_API UDPReceiver {
      */
     void closeSocket(int errorCode) noexcept;
 
+    UDPReceiver(const std::string &receiveFromAddress,
+                uint16_t receiveFromPort,
+                std::function<void(std::string &&, std::string &&, std::chrono::system_clock::time_point &&)> delegate,
+                std::function<void(std::vector<Datagram> &&)> batchDelegate,
+                uint16_t localSendFromPort) noexcept;
+
     void readFromSocket() noexcept;
 
+#ifdef __linux__
+    void readBatchesFromSocket() noexcept;
+#endif
+
+    bool isSentFromUs(const struct sockaddr_storage &remote) const noexcept;
+
     void processPipeline() noexcept;
 
    private:
@@ -5310,6 +5372,7 @@ class LIBCLUON_API UDPReceiver {
 
    private:
     std::function<void(std::string &&, std::string &&, std::chrono::system_clock::time_point)> m_delegate{};
+    std::function<void(std::vector<Datagram> &&)> m_batchDelegate{};
 
    private:
     std::atomic<bool> m_pipelineThreadRunning{false};
@@ -5317,13 +5380,7 @@ class LIBCLUON_API UDPReceiver {
     std::mutex m_pipelineMutex{};
     std::condition_variable m_pipelineCondition{};
 
-    class PipelineEntry {
-       public:
-        std::string m_data;
-        std::string m_from;
-        std::chrono::system_clock::time_point m_sampleTime;
-    };
-    std::deque<PipelineEntry> m_pipeline{};
+    std::deque<Datagram> m_pipeline{};
 };
 } // namespace cluon
 
@@ -7686,6 +7743,7 @@ class LIBCLUON_API LCMToGenericMessage {
 #ifndef CLUON_OD4SESSION_HPP
 #define CLUON_OD4SESSION_HPP
 
+//#include "cluon/Envelope.hpp"
 //#include "cluon/Time.hpp"
 //#include "cluon/ToProtoVisitor.hpp"
 //#include "cluon/UDPReceiver.hpp"
@@ -7701,6 +7759,7 @@ class LIBCLUON_API LCMToGenericMessage {
 #include <mutex>
 #include <string>
 #include <utility>
+#include <vector>
 
 namespace cluon {
 /**
@@ -7766,8 +7825,11 @@ class LIBCLUON_API OD4Session {
      *        if a nullptr is passed, the method dataTrigger can be used to set
      *        message specific delegates. Please note that it is NOT possible
      *        to have both: a delegate for "catch-all" and the data-triggered ones.
+     * @param batchReceive If true, UDP packets are received in batches (see
+     *        UDPReceiver) and all Envelopes of a batch are dispatched in
+     *        arrival order while holding the delegate lock only once.
      */
-    OD4Session(uint16_t CID, std::function<void(cluon::data::Envelope &&envelope)> delegate = nullptr) noexcept;
+    OD4Session(uint16_t CID, std::function<void(cluon::data::Envelope &&envelope)> delegate = nullptr, bool batchReceive = false) noexcept;
 
     /**
      * This method will send a given Envelope to this OpenDaVINCI v4 session.
@@ -7786,6 +7848,18 @@ class LIBCLUON_API OD4Session {
      */
     bool dataTrigger(int32_t messageIdentifier, std::function<void(cluon::data::Envelope &&envelope)> delegate) noexcept;
 
+    /**
+     * This method sets a delegate to be called data-triggered on arrival
+     * of a new Envelope for a given message identifier and sender stamp.
+     * Envelopes from other senders are dropped before the delegate is called.
+     *
+     * @param messageIdentifier Message identifier to assign a delegate.
+     * @param senderStamp Sender stamp the Envelopes must carry.
+     * @param delegate Function to call on newly arriving Envelopes; setting it to nullptr will erase it.
+     * @return true if the given delegate could be successfully set or unset.
+     */
+    bool dataTrigger(int32_t messageIdentifier, uint32_t senderStamp, std::function<void(cluon::data::Envelope &&envelope)> delegate) noexcept;
+
     /**
      * This method sets a delegate to be called time-triggered using the
      * specified frequency until the delegate returns false. This method
@@ -7809,29 +7883,69 @@ class LIBCLUON_API OD4Session {
     void send(T &message, const cluon::data::TimeStamp &sampleTimeStamp = cluon::data::TimeStamp(), uint32_t senderStamp = 0) noexcept {
         try {
             std::lock_guard<std::mutex> lck(m_senderMutex);
-            cluon::ToProtoVisitor protoEncoder;
-
-            cluon::data::Envelope envelope;
-            {
-                envelope.dataType(static_cast<int32_t>(message.ID()));
-                message.accept(protoEncoder);
-                envelope.serializedData(protoEncoder.encodedData());
-                envelope.sent(cluon::time::now());
-                envelope.sampleTimeStamp((0 == (sampleTimeStamp.seconds() + sampleTimeStamp.microseconds())) ? envelope.sent() : sampleTimeStamp);
-                envelope.senderStamp(senderStamp);
-            }
+            send(createEnvelope(message, sampleTimeStamp, senderStamp));
+        } catch (...) {} // LCOV_EXCL_LINE
+    }
 
-            send(std::move(envelope));
+    /**
+     * This method serializes a given message into an Envelope and appends
+     * it to the given batch without sending it. All envelopes of a batch
+     * are sent at once using sendBatch, one UDP packet per Envelope so that
+     * any OD4Session receiver can decode them.
+     *
+     * @param batch Batch to append the serialized Envelope to.
+     * @param message Message to be sent.
+     * @param sampleTimeStamp Time stamp for this message.
+     * @param senderStamp Optional sender stamp.
+     */
+    template <typename T>
+    void appendToBatch(std::vector<std::string> &batch, T &message, const cluon::data::TimeStamp &sampleTimeStamp = cluon::data::TimeStamp(), uint32_t senderStamp = 0) noexcept {
+        try {
+            batch.push_back(cluon::serializeEnvelope(createEnvelope(message, sampleTimeStamp, senderStamp)));
         } catch (...) {} // LCOV_EXCL_LINE
     }
 
+    /**
+     * This method sends all Envelopes collected with appendToBatch with as
+     * few system calls as possible and clears the batch.
+     *
+     * @param batch Serialized Envelopes to be sent.
+     */
+    void sendBatch(std::vector<std::string> &batch) noexcept;
+
+    /**
+     * This method sends already serialized Envelopes like sendBatch but
+     * leaves them untouched, so that their buffers can be reused.
+     *
+     * @param batch First serialized Envelope to be sent.
+     * @param count Number of Envelopes to be sent.
+     */
+    void sendBatch(const std::string *batch, std::size_t count) noexcept;
+
    public:
     bool isRunning() noexcept;
 
    private:
     void callback(std::string &&data, std::string &&from, std::chrono::system_clock::time_point &&timepoint) noexcept;
+    void callbackBatch(std::vector<cluon::UDPReceiver::Datagram> &&batch) noexcept;
     void sendInternal(std::string &&dataToSend) noexcept;
 
+    template <typename T>
+    static cluon::data::Envelope createEnvelope(T &message, const cluon::data::TimeStamp &sampleTimeStamp, uint32_t senderStamp) {
+        cluon::ToProtoVisitor protoEncoder;
+
+        cluon::data::Envelope envelope;
+        {
+            envelope.dataType(static_cast<int32_t>(message.ID()));
+            message.accept(protoEncoder);
+            envelope.serializedData(protoEncoder.encodedData());
+            envelope.sent(cluon::time::now());
+            envelope.sampleTimeStamp((0 == (sampleTimeStamp.seconds() + sampleTimeStamp.microseconds())) ? envelope.sent() : sampleTimeStamp);
+            envelope.senderStamp(senderStamp);
+        }
+        return envelope;
+    }
+
    private:
     std::unique_ptr<cluon::UDPReceiver> m_receiver;
     cluon::UDPSender m_sender;
@@ -7840,8 +7954,16 @@ class LIBCLUON_API OD4Session {
 
     std::function<void(cluon::data::Envelope &&envelope)> m_delegate{nullptr};
 
+    struct DataTrigger {
+        std::function<void(cluon::data::Envelope &&envelope)> m_delegate{nullptr};
+        bool m_filterSenderStamp{false};
+        uint32_t m_senderStamp{0};
+    };
+    bool setDataTrigger(int32_t messageIdentifier, DataTrigger &&trigger) noexcept;
+    void dispatch(cluon::data::Envelope &&envelope) noexcept;
+
     std::mutex m_mapOfDataTriggeredDelegatesMutex{};
-    std::map<int32_t, std::function<void(cluon::data::Envelope &&envelope)>> m_mapOfDataTriggeredDelegates{};
+    std::map<int32_t, DataTrigger> m_mapOfDataTriggeredDelegates{};
 };
 
 } // namespace cluon
@@ -8253,7 +8375,7 @@ inline Envelope& Envelope::serializedData(const std::string &v) noexcept {
     m_serializedData = v;
     return *this;
 }
-inline std::string Envelope::serializedData() const noexcept {
+inline const std::string &Envelope::serializedData() const noexcept {
     return m_serializedData;
 }
 
@@ -9068,6 +9190,74 @@ inline std::pair<ssize_t, int32_t> UDPSender::send(std::string &&data) const noe
 
     return {bytesSent, (0 > bytesSent ? errno : 0)};
 }
+
+inline std::pair<ssize_t, int32_t> UDPSender::send(std::vector<std::string> &&data) const noexcept {
+    auto retVal = send(data.data(), data.size());
+    data.clear();
+    return retVal;
+}
+
+inline std::pair<ssize_t, int32_t> UDPSender::send(const std::string *data, std::size_t count) const noexcept {
+    if (-1 == m_socket) {
+        return {-1, EBADF};
+    }
+
+    constexpr uint16_t MAX_LENGTH = static_cast<uint16_t>(UDPPacketSizeConstraints::MAX_SIZE_UDP_PACKET)
+                                    - static_cast<uint16_t>(UDPPacketSizeConstraints::SIZE_IPv4_HEADER)
+                                    - static_cast<uint16_t>(UDPPacketSizeConstraints::SIZE_UDP_HEADER);
+    for (std::size_t i{0}; i < count; i++) {
+        if (MAX_LENGTH < data[i].size()) {
+            return {-1, E2BIG};
+        }
+    }
+
+    ssize_t packetsSent{0};
+    int32_t error{0};
+    std::lock_guard<std::mutex> lck(m_socketMutex);
+#ifdef __linux__
+    struct mmsghdr messages[MAX_PACKETS_PER_SYSCALL];
+    struct iovec buffers[MAX_PACKETS_PER_SYSCALL];
+    std::size_t next{0};
+    while ((next < count) && (0 == error)) {
+        uint32_t burst{0};
+        for (; (burst < MAX_PACKETS_PER_SYSCALL) && (next + burst < count); burst++) {
+            const std::string &e = data[next + burst];
+            buffers[burst].iov_base = const_cast<char *>(e.data()); // NOLINT
+            buffers[burst].iov_len  = e.size();
+            std::memset(&messages[burst], 0, sizeof(struct mmsghdr));
+            messages[burst].msg_hdr.msg_name    = const_cast<struct sockaddr_in *>(&m_sendToAddress); // NOLINT
+            messages[burst].msg_hdr.msg_namelen = sizeof(m_sendToAddress);
+            messages[burst].msg_hdr.msg_iov     = &buffers[burst];
+            messages[burst].msg_hdr.msg_iovlen  = 1;
+        }
+        int retVal = ::sendmmsg(m_socket, messages, burst, 0);
+        if (0 > retVal) {
+            error = errno;
+        } else {
+            // Partially sent bursts are continued from the first packet not sent.
+            next += static_cast<std::size_t>(retVal);
+            packetsSent += retVal;
+        }
+    }
+#else
+    for (std::size_t i{0}; i < count; i++) {
+        const std::string &e = data[i];
+        ssize_t bytesSent = ::sendto(m_socket,
+                                     e.c_str(),
+                                     e.length(),
+                                     0,
+                                     reinterpret_cast<const struct sockaddr *>(&m_sendToAddress), // NOLINT
+                                     sizeof(m_sendToAddress));
+        if (0 > bytesSent) {
+            error = errno;
+            break;
+        }
+        packetsSent++;
+    }
+#endif
+
+    return {packetsSent, error};
+}
 } // namespace cluon
 /*
  * Copyright (C) 2017-2018  Christian Berger
@@ -9130,11 +9320,25 @@ inline UDPReceiver::UDPReceiver(const std::string &receiveFromAddress,
                          uint16_t receiveFromPort,
                          std::function<void(std::string &&, std::string &&, std::chrono::system_clock::time_point &&)> delegate,
                          uint16_t localSendFromPort) noexcept
+    : UDPReceiver(receiveFromAddress, receiveFromPort, std::move(delegate), nullptr, localSendFromPort) {}
+
+inline UDPReceiver::UDPReceiver(const std::string &receiveFromAddress,
+                         uint16_t receiveFromPort,
+                         std::function<void(std::vector<Datagram> &&)> batchDelegate,
+                         uint16_t localSendFromPort) noexcept
+    : UDPReceiver(receiveFromAddress, receiveFromPort, nullptr, std::move(batchDelegate), localSendFromPort) {}
+
+inline UDPReceiver::UDPReceiver(const std::string &receiveFromAddress,
+                         uint16_t receiveFromPort,
+                         std::function<void(std::string &&, std::string &&, std::chrono::system_clock::time_point &&)> delegate,
+                         std::function<void(std::vector<Datagram> &&)> batchDelegate,
+                         uint16_t localSendFromPort) noexcept
     : m_localSendFromPort(localSendFromPort)
     , m_receiveFromAddress()
     , m_mreq()
     , m_readFromSocketThread()
-    , m_delegate(std::move(delegate)) {
+    , m_delegate(std::move(delegate))
+    , m_batchDelegate(std::move(batchDelegate)) {
     // Decompose given address string to check validity with numerical IPv4 address.
     std::string tmp{receiveFromAddress};
     std::replace(tmp.begin(), tmp.end(), '.', ' ');
@@ -9404,6 +9608,19 @@ inline void UDPReceiver::processPipeline() noexcept {
         // Wait until the thread should stop or data is available.
         m_pipelineCondition.wait(lck, [this] { return (!this->m_pipelineThreadRunning.load() || !this->m_pipeline.empty()); });
 
+        // In batch mode, everything pending is handed over at once.
+        if (nullptr != m_batchDelegate) {
+            std::vector<Datagram> batch;
+            batch.reserve(m_pipeline.size());
+            std::move(m_pipeline.begin(), m_pipeline.end(), std::back_inserter(batch));
+            m_pipeline.clear();
+            lck.unlock();
+            if (!batch.empty()) {
+                m_batchDelegate(std::move(batch));
+            }
+            continue;
+        }
+
         // The condition will automatically lock the mutex after waking up.
         // As we are locking per entry, we need to unlock the mutex first.
         lck.unlock();
@@ -9415,7 +9632,7 @@ inline void UDPReceiver::processPipeline() noexcept {
             lck.unlock();
         }
         for (uint32_t i{0}; i < entries; i++) {
-            PipelineEntry entry;
+            Datagram entry;
             {
                 lck.lock();
                 entry = m_pipeline.front();
@@ -9436,6 +9653,13 @@ inline void UDPReceiver::processPipeline() noexcept {
 }
 
 inline void UDPReceiver::readFromSocket() noexcept {
+#ifdef __linux__
+    if (nullptr != m_batchDelegate) {
+        readBatchesFromSocket();
+        return;
+    }
+#endif
+
     // Create buffer to store data from socket.
     constexpr uint16_t MAX_LENGTH = static_cast<uint16_t>(UDPPacketSizeConstraints::MAX_SIZE_UDP_PACKET)
                                     - static_cast<uint16_t>(UDPPacketSizeConstraints::SIZE_IPv4_HEADER)
@@ -9479,7 +9703,7 @@ inline void UDPReceiver::readFromSocket() noexcept {
                                        reinterpret_cast<struct sockaddr *>(&remote), // NOLINT
                                        reinterpret_cast<socklen_t *>(&addrLength));  // NOLINT
 
-                if ((0 < bytesRead) && (nullptr != m_delegate)) {
+                if ((0 < bytesRead) && ((nullptr != m_delegate) || (nullptr != m_batchDelegate))) {
 #ifdef __linux__
                     std::chrono::system_clock::time_point timestamp;
                     struct timeval receivedTimeStamp {};
@@ -9505,16 +9729,11 @@ inline void UDPReceiver::readFromSocket() noexcept {
                     const uint16_t RECVFROM_PORT{ntohs(reinterpret_cast<struct sockaddr_in *>(&remote)->sin_port)};    // NOLINT
 
                     // Check if the bytes actually came from us.
-                    bool sentFromUs{false};
-                    {
-                        auto pos                   = m_listOfLocalIPAddresses.find(RECVFROM_IP);
-                        const bool sentFromLocalIP = (pos != m_listOfLocalIPAddresses.end() && (*pos == RECVFROM_IP));
-                        sentFromUs                 = sentFromLocalIP && (m_localSendFromPort == RECVFROM_PORT);
-                    }
+                    const bool sentFromUs{isSentFromUs(remote)};
 
                     // Create a pipeline entry to be processed concurrently.
                     if (!sentFromUs) {
-                        PipelineEntry pe;
+                        Datagram pe;
                         pe.m_data       = std::string(buffer.data(), static_cast<size_t>(bytesRead));
                         pe.m_from       = std::string(remoteAddress.data()) + ':' + std::to_string(RECVFROM_PORT);
                         pe.m_sampleTime = timestamp;
@@ -9535,6 +9754,116 @@ inline void UDPReceiver::readFromSocket() noexcept {
         }
     }
 }
+
+inline bool UDPReceiver::isSentFromUs(const struct sockaddr_storage &remote) const noexcept {
+    const unsigned long RECVFROM_IP{reinterpret_cast<const struct sockaddr_in *>(&remote)->sin_addr.s_addr}; // NOLINT
+    const uint16_t RECVFROM_PORT{ntohs(reinterpret_cast<const struct sockaddr_in *>(&remote)->sin_port)};    // NOLINT
+    auto pos                   = m_listOfLocalIPAddresses.find(RECVFROM_IP);
+    const bool sentFromLocalIP = (pos != m_listOfLocalIPAddresses.end() && (*pos == RECVFROM_IP));
+    return sentFromLocalIP && (m_localSendFromPort == RECVFROM_PORT);
+}
+
+#ifdef __linux__
+inline void UDPReceiver::readBatchesFromSocket() noexcept {
+    constexpr uint16_t MAX_LENGTH = static_cast<uint16_t>(UDPPacketSizeConstraints::MAX_SIZE_UDP_PACKET)
+                                    - static_cast<uint16_t>(UDPPacketSizeConstraints::SIZE_IPv4_HEADER)
+                                    - static_cast<uint16_t>(UDPPacketSizeConstraints::SIZE_UDP_HEADER);
+    constexpr std::size_t CONTROL_LENGTH{CMSG_SPACE(sizeof(struct timeval))};
+
+    // One full sized buffer per packet; the kernel only touches what is received.
+    std::vector<char> buffers(static_cast<std::size_t>(MAX_PACKETS_PER_SYSCALL) * MAX_LENGTH);
+    std::vector<char> controls(static_cast<std::size_t>(MAX_PACKETS_PER_SYSCALL) * CONTROL_LENGTH);
+    struct mmsghdr messages[MAX_PACKETS_PER_SYSCALL];
+    struct iovec iovecs[MAX_PACKETS_PER_SYSCALL];
+    struct sockaddr_storage remotes[MAX_PACKETS_PER_SYSCALL];
+
+    // Let the kernel attach the receive time to every packet as SIOCGSTAMP only reports the last one.
+    int enableTimestamp{1};
+    const bool hasTimestamps{0 == ::setsockopt(m_socket, SOL_SOCKET, SO_TIMESTAMP, &enableTimestamp, sizeof(enableTimestamp))};
+
+    constexpr uint16_t MAX_ADDR_SIZE{1024};
+    std::array<char, MAX_ADDR_SIZE> remoteAddress{};
+
+    struct timeval timeout {};
+    fd_set setOfFiledescriptorsToReadFrom{};
+
+    // Indicate to main thread that we are ready.
+    m_readFromSocketThreadRunning.store(true);
+
+    while (m_readFromSocketThreadRunning.load()) {
+        timeout.tv_sec  = 0;
+        timeout.tv_usec = 20 * 1000; // Check for new data with 50Hz.
+
+        FD_ZERO(&setOfFiledescriptorsToReadFrom);          // NOLINT
+        FD_SET(m_socket, &setOfFiledescriptorsToReadFrom); // NOLINT
+        ::select(m_socket + 1, &setOfFiledescriptorsToReadFrom, nullptr, nullptr, &timeout);
+
+        uint32_t totalPacketsRead{0};
+        if (FD_ISSET(m_socket, &setOfFiledescriptorsToReadFrom)) { // NOLINT
+            int packetsRead{0};
+            do {
+                for (uint32_t i{0}; i < MAX_PACKETS_PER_SYSCALL; i++) {
+                    iovecs[i].iov_base = &buffers[i * MAX_LENGTH];
+                    iovecs[i].iov_len  = MAX_LENGTH;
+                    std::memset(&messages[i], 0, sizeof(struct mmsghdr));
+                    messages[i].msg_hdr.msg_name       = &remotes[i];
+                    messages[i].msg_hdr.msg_namelen    = sizeof(remotes[i]);
+                    messages[i].msg_hdr.msg_iov        = &iovecs[i];
+                    messages[i].msg_hdr.msg_iovlen     = 1;
+                    messages[i].msg_hdr.msg_control    = &controls[i * CONTROL_LENGTH];
+                    messages[i].msg_hdr.msg_controllen = CONTROL_LENGTH;
+                }
+                packetsRead = ::recvmmsg(m_socket, messages, MAX_PACKETS_PER_SYSCALL, (m_isBlockingSocket ? MSG_WAITFORONE : 0), nullptr);
+
+                const std::chrono::system_clock::time_point now{std::chrono::system_clock::now()};
+                std::vector<Datagram> received;
+                received.reserve(static_cast<std::size_t>((packetsRead > 0) ? packetsRead : 0));
+                for (int i{0}; i < packetsRead; i++) {
+                    if ((0 == messages[i].msg_len) || isSentFromUs(remotes[i])) {
+                        continue;
+                    }
+
+                    std::chrono::system_clock::time_point timestamp{now};
+                    if (hasTimestamps) {
+                        for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&messages[i].msg_hdr); nullptr != cmsg; cmsg = CMSG_NXTHDR(&messages[i].msg_hdr, cmsg)) {
+                            if ((SOL_SOCKET == cmsg->cmsg_level) && (SCM_TIMESTAMP == cmsg->cmsg_type)) {
+                                struct timeval receivedTimeStamp {};
+                                std::memcpy(&receivedTimeStamp, CMSG_DATA(cmsg), sizeof(receivedTimeStamp));
+                                std::chrono::time_point<std::chrono::system_clock, std::chrono::microseconds> transformedTimePoint(
+                                    std::chrono::microseconds(receivedTimeStamp.tv_sec * 1000000L + receivedTimeStamp.tv_usec));
+                                timestamp = std::chrono::time_point_cast<std::chrono::system_clock::duration>(transformedTimePoint);
+                            }
+                        }
+                    }
+
+                    ::inet_ntop(remotes[i].ss_family,
+                                &((reinterpret_cast<struct sockaddr_in *>(&remotes[i]))->sin_addr), // NOLINT
+                                remoteAddress.data(),
+                                remoteAddress.max_size());
+                    const uint16_t RECVFROM_PORT{ntohs(reinterpret_cast<struct sockaddr_in *>(&remotes[i])->sin_port)}; // NOLINT
+
+                    Datagram d;
+                    d.m_data       = std::string(&buffers[static_cast<std::size_t>(i) * MAX_LENGTH], messages[i].msg_len);
+                    d.m_from       = std::string(remoteAddress.data()) + ':' + std::to_string(RECVFROM_PORT);
+                    d.m_sampleTime = timestamp;
+                    received.emplace_back(std::move(d));
+                }
+
+                // Store all entries of this syscall in the queue with one lock.
+                if (!received.empty()) {
+                    std::unique_lock<std::mutex> lck(m_pipelineMutex);
+                    std::move(received.begin(), received.end(), std::back_inserter(m_pipeline));
+                    totalPacketsRead += static_cast<uint32_t>(received.size());
+                }
+            } while (!m_isBlockingSocket && (packetsRead == static_cast<int>(MAX_PACKETS_PER_SYSCALL)));
+        }
+
+        if (totalPacketsRead > 0) {
+            m_pipelineCondition.notify_all();
+        }
+    }
+}
+#endif
 } // namespace cluon
 /*
  * Copyright (C) 2018  Christian Berger
@@ -12776,12 +13105,20 @@ inline void ToMsgPackVisitor::visit(uint32_t id, std::string &&typeName, std::st
 
 namespace cluon {
 
-inline OD4Session::OD4Session(uint16_t CID, std::function<void(cluon::data::Envelope &&envelope)> delegate) noexcept
+inline OD4Session::OD4Session(uint16_t CID, std::function<void(cluon::data::Envelope &&envelope)> delegate, bool batchReceive) noexcept
     : m_receiver{nullptr}
     , m_sender{"225.0.0." + std::to_string(CID), 12175}
     , m_delegate(std::move(delegate))
     , m_mapOfDataTriggeredDelegatesMutex{}
     , m_mapOfDataTriggeredDelegates{} {
+    if (batchReceive) {
+        m_receiver = std::make_unique<cluon::UDPReceiver>(
+            "225.0.0." + std::to_string(CID),
+            12175,
+            [this](std::vector<cluon::UDPReceiver::Datagram> &&batch) { this->callbackBatch(std::move(batch)); },
+            m_sender.getSendFromPort() /* passing our local send from port to the UDPReceiver to filter out our own bytes */);
+        return;
+    }
     m_receiver = std::make_unique<cluon::UDPReceiver>(
         "225.0.0." + std::to_string(CID),
         12175,
@@ -12821,17 +13158,31 @@ inline void OD4Session::timeTrigger(float freq, std::function<bool()> delegate)
 }
 
 inline bool OD4Session::dataTrigger(int32_t messageIdentifier, std::function<void(cluon::data::Envelope &&envelope)> delegate) noexcept {
+    DataTrigger trigger;
+    trigger.m_delegate = std::move(delegate);
+    return setDataTrigger(messageIdentifier, std::move(trigger));
+}
+
+inline bool OD4Session::dataTrigger(int32_t messageIdentifier, uint32_t senderStamp, std::function<void(cluon::data::Envelope &&envelope)> delegate) noexcept {
+    DataTrigger trigger;
+    trigger.m_delegate          = std::move(delegate);
+    trigger.m_filterSenderStamp = true;
+    trigger.m_senderStamp       = senderStamp;
+    return setDataTrigger(messageIdentifier, std::move(trigger));
+}
+
+inline bool OD4Session::setDataTrigger(int32_t messageIdentifier, DataTrigger &&trigger) noexcept {
     bool retVal{false};
     if (nullptr == m_delegate) {
         try {
             std::lock_guard<std::mutex> lck{m_mapOfDataTriggeredDelegatesMutex};
-            if ((nullptr == delegate) && (m_mapOfDataTriggeredDelegates.count(messageIdentifier) > 0)) {
+            if ((nullptr == trigger.m_delegate) && (m_mapOfDataTriggeredDelegates.count(messageIdentifier) > 0)) {
                 auto element = m_mapOfDataTriggeredDelegates.find(messageIdentifier);
                 if (element != m_mapOfDataTriggeredDelegates.end()) {
                     m_mapOfDataTriggeredDelegates.erase(element);
                 }
             } else {
-                m_mapOfDataTriggeredDelegates[messageIdentifier] = delegate;
+                m_mapOfDataTriggeredDelegates[messageIdentifier] = std::move(trigger);
             }
             retVal = true;
         } catch (...) {} // LCOV_EXCL_LINE
@@ -12839,12 +13190,21 @@ inline bool OD4Session::dataTrigger(int32_t messageIdentifier, std::function<voi
     return retVal;
 }
 
+// Must be called with m_mapOfDataTriggeredDelegatesMutex held.
+inline void OD4Session::dispatch(cluon::data::Envelope &&envelope) noexcept {
+    auto element = m_mapOfDataTriggeredDelegates.find(envelope.dataType());
+    if ((element != m_mapOfDataTriggeredDelegates.end()) && (nullptr != element->second.m_delegate)
+        && (!element->second.m_filterSenderStamp || (element->second.m_senderStamp == envelope.senderStamp()))) {
+        element->second.m_delegate(std::move(envelope));
+    }
+}
+
 inline void OD4Session::callback(std::string &&data, std::string && /*from*/, std::chrono::system_clock::time_point &&timepoint) noexcept {
     std::stringstream sstr(data);
     auto retVal = extractEnvelope(sstr);
 
     if (retVal.first) {
-        cluon::data::Envelope env{retVal.second};
+        cluon::data::Envelope env{std::move(retVal.second)};
         env.received(cluon::time::convert(timepoint));
 
         // "Catch all"-delegate.
@@ -12854,14 +13214,40 @@ inline void OD4Session::callback(std::string &&data, std::string && /*from*/, st
             try {
                 // Data triggered-delegates.
                 std::lock_guard<std::mutex> lck{m_mapOfDataTriggeredDelegatesMutex};
-                if (m_mapOfDataTriggeredDelegates.count(env.dataType()) > 0) {
-                    m_mapOfDataTriggeredDelegates[env.dataType()](std::move(env));
-                }
+                dispatch(std::move(env));
             } catch (...) {} // LCOV_EXCL_LINE
         }
     }
 }
 
+inline void OD4Session::callbackBatch(std::vector<cluon::UDPReceiver::Datagram> &&batch) noexcept {
+    std::vector<cluon::data::Envelope> envelopes;
+    envelopes.reserve(batch.size());
+    for (auto &d : batch) {
+        std::stringstream sstr(d.m_data);
+        auto retVal = extractEnvelope(sstr);
+        if (retVal.first) {
+            envelopes.emplace_back(std::move(retVal.second));
+            envelopes.back().received(cluon::time::convert(d.m_sampleTime));
+        }
+    }
+
+    // "Catch all"-delegate.
+    if (nullptr != m_delegate) {
+        for (auto &env : envelopes) {
+            m_delegate(std::move(env));
+        }
+    } else {
+        try {
+            // Data triggered-delegates.
+            std::lock_guard<std::mutex> lck{m_mapOfDataTriggeredDelegatesMutex};
+            for (auto &env : envelopes) {
+                dispatch(std::move(env));
+            }
+        } catch (...) {} // LCOV_EXCL_LINE
+    }
+}
+
 inline void OD4Session::send(cluon::data::Envelope &&envelope) noexcept {
     sendInternal(cluon::serializeEnvelope(std::move(envelope)));
 }
@@ -12870,6 +13256,17 @@ inline void OD4Session::sendInternal(std::string &&dataToSend) noexcept {
     m_sender.send(std::move(dataToSend));
 }
 
+inline void OD4Session::sendBatch(std::vector<std::string> &batch) noexcept {
+    std::lock_guard<std::mutex> lck(m_senderMutex);
+    m_sender.send(std::move(batch));
+    batch.clear();
+}
+
+inline void OD4Session::sendBatch(const std::string *batch, std::size_t count) noexcept {
+    std::lock_guard<std::mutex> lck(m_senderMutex);
+    m_sender.send(batch, count);
+}
+
 inline bool OD4Session::isRunning() noexcept {
     return m_receiver->isRunning();
 }
@@ -18,22 +18,19 @@
 */
 
 #include "cone.hpp"
+#include "landmarkstore.hpp"
 
-Cone::Cone(double x, double y,int type,int id):
-  m_x()
-, m_y()
-, m_type()
-, m_id()
+constexpr double Cone::RAD2DEG;
+
+Cone::Cone(LandmarkStore const &store, uint32_t index):
+  m_store(store)
+, m_index(index)
 {
-  m_x = x;
-  m_y = y;
-  m_type = type;
-  m_id = id;
 }
 
-opendlv::logic::perception::ObjectDirection Cone::getDirection(Eigen::Vector3d pose){
-  double x = m_x-pose(0);
-  double y = m_y-pose(1);
+opendlv::logic::perception::ObjectDirection Cone::getDirection(Eigen::Vector3d const &pose) const{
+  double x = getX()-pose(0);
+  double y = getY()-pose(1);
   double heading = pose(2)*static_cast<double>(1/RAD2DEG);
   double azimuthAngle = atan2(y,x)*static_cast<double>(RAD2DEG);
   azimuthAngle = azimuthAngle-heading;
@@ -43,43 +40,31 @@ opendlv::logic::perception::ObjectDirection Cone::getDirection(Eigen::Vector3d p
   return direction;
 }
 
-opendlv::logic::perception::ObjectDistance Cone::getDistance(Eigen::Vector3d pose){
-  double x = m_x-pose(0);
-  double y = m_y-pose(1);
+opendlv::logic::perception::ObjectDistance Cone::getDistance(Eigen::Vector3d const &pose) const{
+  double x = getX()-pose(0);
+  double y = getY()-pose(1);
   double distance = sqrt(x*x+y*y);
   opendlv::logic::perception::ObjectDistance msgDistance;
   msgDistance.distance(static_cast<float>(distance));
   return msgDistance;
 }
 
-double Cone::getX(){
-  return m_x;
-}
-
-double Cone::getY(){
-  return m_y;
-}
-
-int Cone::getType(){
-  return m_type;
-}
-
-int Cone::getId(){
-  return m_id;
+double Cone::getX() const{
+  return m_store.x(m_index);
 }
 
-void Cone::setX(double x){
-  m_x = x;
+double Cone::getY() const{
+  return m_store.y(m_index);
 }
 
-void Cone::setY(double y){
-  m_y = y;
+int Cone::getType() const{
+  return m_store.type(m_index);
 }
 
-void Cone::setType(int type){
-  m_type = type;
+int Cone::getId() const{
+  return m_store.id(m_index);
 }
 
-void Cone::setId(int id){
-  m_id = id;
+uint32_t Cone::getIndex() const{
+  return m_index;
 }
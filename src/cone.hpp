@@ -22,37 +22,35 @@
 
 #include <iostream>
 #include <cmath>
+#include <cstdint>
 #include <vector>
 #include <Eigen/Dense>
 #include "opendlv-standard-message-set.hpp"
 
+class LandmarkStore;
+
+//View of one landmark in a LandmarkStore
 class Cone{
   public:
-    Cone(double x, double y,int type,int id);
+    Cone(LandmarkStore const &store, uint32_t index);
     ~Cone() = default;
     
-    opendlv::logic::perception::ObjectDirection getDirection(Eigen::Vector3d pose);
-    opendlv::logic::perception::ObjectDistance getDistance(Eigen::Vector3d pose);
-    
+    opendlv::logic::perception::ObjectDirection getDirection(Eigen::Vector3d const &pose) const;
+    opendlv::logic::perception::ObjectDistance getDistance(Eigen::Vector3d const &pose) const;
     
-    double getX();
-    double getY();
-    int getType();
-    int getId();
     
-    void setX(double x);
-    void setY(double y);
-    void setType(int type);
-    void setId(int id);
+    double getX() const;
+    double getY() const;
+    int getType() const;
+    int getId() const;
+    uint32_t getIndex() const;
 
 
 
   private:
-    double m_x;
-    double m_y;
-    int m_type;
-    int m_id;
-    const double RAD2DEG = 57.295779513082325; // 1.0 / DEG2RAD;
+    LandmarkStore const &m_store;
+    uint32_t m_index;
+    static constexpr double RAD2DEG = 57.295779513082325; // 1.0 / DEG2RAD;
 
 };
 
@@ -0,0 +1,210 @@
+/**
+* Copyright (C) 2018 Chalmers Revere
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+* USA.
+*/
+
+#include <endian.h>
+#include <cstring>
+
+#include "coneframe.hpp"
+
+namespace {
+void putUint32(char *out, uint32_t value){
+  value = htole32(value);
+  std::memcpy(out, &value, sizeof(value));
+}
+
+void putFloat(char *out, float value){
+  uint32_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  putUint32(out, bits);
+}
+
+uint32_t getUint32(char const *in){
+  uint32_t value;
+  std::memcpy(&value, in, sizeof(value));
+  return le32toh(value);
+}
+
+float getFloat(char const *in){
+  uint32_t bits = getUint32(in);
+  float value;
+  std::memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+bool readVarInt(std::string const &payload, std::size_t &position, uint64_t &value){
+  value = 0;
+  for(uint32_t shift = 0; shift < 64; shift += 7){
+    if(position >= payload.size()){
+      return false;
+    }
+    uint8_t byte = static_cast<uint8_t>(payload[position++]);
+    value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+    if((byte & 0x80) == 0){
+      return true;
+    }
+  }
+  return false;
+}
+}
+
+std::string packCones(ConeFrameCone const *cones, uint32_t numberOfCones){
+  std::string packed;
+  packed.reserve(numberOfCones*PACKED_CONE_SIZE);
+  appendPackedCones(packed, cones, numberOfCones);
+  return packed;
+}
+
+void appendPackedCones(std::string &packed, ConeFrameCone const *cones, uint32_t numberOfCones){
+  char out[PACKED_CONE_SIZE];
+  for(uint32_t i = 0; i < numberOfCones; i++){
+    putFloat(out, cones[i].azimuthAngle);
+    putFloat(out+4, cones[i].zenithAngle);
+    putFloat(out+8, cones[i].distance);
+    putUint32(out+12, cones[i].type);
+    putUint32(out+16, cones[i].objectId);
+    packed.append(out, PACKED_CONE_SIZE);
+  }
+}
+
+uint32_t unpackCones(std::string const &packed, ConeFrameCone *cones, uint32_t maxNumberOfCones){
+  return unpackCones(packed.data(), packed.size(), cones, maxNumberOfCones);
+}
+
+uint32_t unpackCones(char const *packed, std::size_t length, ConeFrameCone *cones, uint32_t maxNumberOfCones){
+  uint32_t numberOfCones = static_cast<uint32_t>(length/PACKED_CONE_SIZE);
+  numberOfCones = (numberOfCones < maxNumberOfCones)?(numberOfCones):(maxNumberOfCones);
+  char const *in = packed;
+  for(uint32_t i = 0; i < numberOfCones; i++){
+    cones[i].azimuthAngle = getFloat(in);
+    cones[i].zenithAngle = getFloat(in+4);
+    cones[i].distance = getFloat(in+8);
+    cones[i].type = getUint32(in+12);
+    cones[i].objectId = getUint32(in+16);
+    in += PACKED_CONE_SIZE;
+  }
+  return numberOfCones;
+}
+
+bool nextProtoField(std::string const &payload, std::size_t &position, ProtoField &field){
+  uint64_t key;
+  if(!readVarInt(payload, position, key)){
+    return false;
+  }
+  field.id = static_cast<uint32_t>(key >> 3);
+  field.wireType = static_cast<uint32_t>(key & 0x7);
+  field.value = 0;
+  field.data = nullptr;
+  field.length = 0;
+  switch(field.wireType){
+    case 0: //Varint
+      return readVarInt(payload, position, field.value);
+    case 1: //Eight bytes
+      if(payload.size()-position < 8){
+        return false;
+      }
+      field.value = static_cast<uint64_t>(getUint32(payload.data()+position)) | (static_cast<uint64_t>(getUint32(payload.data()+position+4)) << 32);
+      position += 8;
+      return true;
+    case 2: //Length delimited
+    {
+      uint64_t length;
+      if(!readVarInt(payload, position, length) || payload.size()-position < length){
+        return false;
+      }
+      field.data = payload.data()+position;
+      field.length = static_cast<std::size_t>(length);
+      position += field.length;
+      return true;
+    }
+    case 5: //Four bytes
+      if(payload.size()-position < 4){
+        return false;
+      }
+      field.value = getUint32(payload.data()+position);
+      position += 4;
+      return true;
+    default:
+      return false;
+  }
+}
+
+float protoFloat(ProtoField const &field){
+  uint32_t bits = static_cast<uint32_t>(field.value);
+  float value;
+  std::memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+double protoDouble(ProtoField const &field){
+  double value;
+  std::memcpy(&value, &field.value, sizeof(value));
+  return value;
+}
+
+void appendVarInt(std::string &out, uint64_t value){
+  while(value > 0x7f){
+    out.push_back(static_cast<char>((value & 0x7f) | 0x80));
+    value >>= 7;
+  }
+  out.push_back(static_cast<char>(value));
+}
+
+std::size_t varIntSize(uint64_t value){
+  std::size_t size = 1;
+  while(value > 0x7f){
+    value >>= 7;
+    size++;
+  }
+  return size;
+}
+
+void appendProtoVarInt(std::string &out, uint32_t id, uint64_t value){
+  appendVarInt(out, (id << 3) | 0);
+  appendVarInt(out, value);
+}
+
+void appendProtoInt32(std::string &out, uint32_t id, int32_t value){
+  appendProtoVarInt(out, id, zigZag32(value));
+}
+
+void appendProtoFloat(std::string &out, uint32_t id, float value){
+  char bytes[4];
+  putFloat(bytes, value);
+  appendVarInt(out, (id << 3) | 5);
+  out.append(bytes, sizeof(bytes));
+}
+
+void appendProtoDouble(std::string &out, uint32_t id, double value){
+  uint64_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  char bytes[8];
+  putUint32(bytes, static_cast<uint32_t>(bits));
+  putUint32(bytes+4, static_cast<uint32_t>(bits >> 32));
+  appendVarInt(out, (id << 3) | 1);
+  out.append(bytes, sizeof(bytes));
+}
+
+void appendProtoLength(std::string &out, uint32_t id, std::size_t length){
+  appendVarInt(out, (id << 3) | 2);
+  appendVarInt(out, length);
+}
+
+uint32_t zigZag32(int32_t value){
+  return (static_cast<uint32_t>(value) << 1) ^ static_cast<uint32_t>(value >> 31);
+}
@@ -0,0 +1,100 @@
+/**
+ * Copyright (C) 2018 Chalmers Revere
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+
+#ifndef CONEFRAME_HPP
+#define CONEFRAME_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/*
+ * Layout of one complete cone frame as written by perception into shared
+ * memory. The writer locks the area, fills cones and numberOfCones, sets the
+ * sample time, increments sequence, unlocks and calls notifyAll.
+ */
+const uint32_t MAX_CONES_PER_FRAME = 200;
+
+struct ConeFrameCone {
+  float azimuthAngle; //Degrees
+  float zenithAngle; //Degrees
+  float distance; //Meters
+  uint32_t type;
+  uint32_t objectId;
+};
+
+struct ConeFrameHeader {
+  uint32_t sequence;
+  uint32_t numberOfCones;
+  int32_t seconds;
+  int32_t microseconds;
+};
+
+struct ConeFrameBuffer {
+  ConeFrameHeader header;
+  ConeFrameCone cones[MAX_CONES_PER_FRAME];
+};
+
+/*
+ * The cones field of opendlv.logic.perception.ConeFrame holds numberOfCones
+ * records of ConeFrameCone, each field little endian, 20 bytes per cone.
+ */
+const uint32_t PACKED_CONE_SIZE = 20;
+
+std::string packCones(ConeFrameCone const *cones, uint32_t numberOfCones);
+//Appends the packed cones, allocation free while the capacity of packed suffices
+void appendPackedCones(std::string &packed, ConeFrameCone const *cones, uint32_t numberOfCones);
+uint32_t unpackCones(std::string const &packed, ConeFrameCone *cones, uint32_t maxNumberOfCones);
+uint32_t unpackCones(char const *packed, std::size_t length, ConeFrameCone *cones, uint32_t maxNumberOfCones);
+
+/*
+ * One field of a serialized message payload as written by cluon (protobuf).
+ * Cone messages are decoded with this straight from the envelope, without a
+ * message object or a stream in between.
+ */
+struct ProtoField {
+  uint32_t id;
+  uint32_t wireType;
+  uint64_t value; //Varint, or the raw bits of a fixed size field
+  char const *data; //Length delimited fields only
+  std::size_t length;
+};
+
+//Reads the field at position and advances it, false at the end or on malformed data
+bool nextProtoField(std::string const &payload, std::size_t &position, ProtoField &field);
+float protoFloat(ProtoField const &field);
+double protoDouble(ProtoField const &field);
+
+/*
+ * The other way around, fields appended to a buffer byte for byte as cluon's
+ * ToProtoVisitor writes them. Nothing is allocated while the capacity of the
+ * buffer suffices, so messages can be encoded into buffers reserved once.
+ */
+void appendVarInt(std::string &out, uint64_t value);
+std::size_t varIntSize(uint64_t value);
+void appendProtoVarInt(std::string &out, uint32_t id, uint64_t value);
+//Signed fields are zigzag encoded
+void appendProtoInt32(std::string &out, uint32_t id, int32_t value);
+void appendProtoFloat(std::string &out, uint32_t id, float value);
+void appendProtoDouble(std::string &out, uint32_t id, double value);
+//Key and length only, the caller appends the bytes
+void appendProtoLength(std::string &out, uint32_t id, std::size_t length);
+uint32_t zigZag32(int32_t value);
+
+#endif
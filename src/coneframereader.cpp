@@ -0,0 +1,87 @@
+/**
+* Copyright (C) 2018 Chalmers Revere
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+* USA.
+*/
+
+#include <iostream>
+
+#include "coneframereader.hpp"
+
+ConeFrameReader::ConeFrameReader(std::string const &name, std::function<void(Eigen::Ref<Eigen::MatrixXd const> const &, cluon::data::TimeStamp const &)> delegate) :
+  m_sharedMemory(new cluon::SharedMemory(name))
+, m_delegate(delegate)
+, m_running()
+, m_reader()
+{
+  m_running = m_sharedMemory->valid() && m_sharedMemory->size() >= sizeof(ConeFrameBuffer);
+  if(m_running){
+    m_reader = std::thread(&ConeFrameReader::run,this);
+  }
+  else{
+    std::cerr << "Could not attach to cone frame shared memory " << name << std::endl;
+  }
+}
+
+ConeFrameReader::~ConeFrameReader()
+{
+  m_running = false;
+  if(m_reader.joinable()){
+    //Wake up our own wait on the shared condition
+    m_sharedMemory->notifyAll();
+    m_reader.join();
+  }
+}
+
+bool ConeFrameReader::isRunning()
+{
+  return m_running;
+}
+
+void ConeFrameReader::run()
+{
+  ConeFrameBuffer const *frame = reinterpret_cast<ConeFrameBuffer const *>(m_sharedMemory->data());
+  Eigen::MatrixXd cones(4,MAX_CONES_PER_FRAME);
+  while(m_running){
+    m_sharedMemory->wait();
+    if(!m_running){
+      break;
+    }
+
+    uint32_t numberOfCones = 0;
+    cluon::data::TimeStamp sampleTime;
+    {
+      m_sharedMemory->lock();
+      bool newFrame = frame->header.sequence != m_lastSequence;
+      if(newFrame){
+        m_lastSequence = frame->header.sequence;
+        numberOfCones = (frame->header.numberOfCones < MAX_CONES_PER_FRAME)?(frame->header.numberOfCones):(MAX_CONES_PER_FRAME);
+        sampleTime.seconds(frame->header.seconds).microseconds(frame->header.microseconds);
+        for(uint32_t i = 0; i < numberOfCones; i++){
+          cones(0,i) = frame->cones[i].azimuthAngle;
+          cones(1,i) = frame->cones[i].zenithAngle;
+          cones(2,i) = frame->cones[i].distance;
+          cones(3,i) = frame->cones[i].type;
+        }
+      }
+      m_sharedMemory->unlock();
+    }
+
+    if(numberOfCones > 0 && nullptr != m_delegate){
+      m_delegate(cones.leftCols(numberOfCones),sampleTime);
+    }
+  }
+}
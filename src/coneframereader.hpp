@@ -0,0 +1,59 @@
+/**
+ * Copyright (C) 2018 Chalmers Revere
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+
+#ifndef CONEFRAMEREADER_HPP
+#define CONEFRAMEREADER_HPP
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <Eigen/Dense>
+#include "cluon-complete.hpp"
+
+#include "coneframe.hpp"
+
+/*
+ * Reads complete cone frames from a shared memory area written by a
+ * perception process on the same computer. Each new sequence number is
+ * handed to the delegate as a 4xN matrix (azimuth, zenith, distance, type).
+ */
+class ConeFrameReader {
+ private:
+  ConeFrameReader(const ConeFrameReader &) = delete;
+  ConeFrameReader(ConeFrameReader &&)      = delete;
+  ConeFrameReader &operator=(const ConeFrameReader &) = delete;
+  ConeFrameReader &operator=(ConeFrameReader &&) = delete;
+ public:
+  ConeFrameReader(std::string const &name, std::function<void(Eigen::Ref<Eigen::MatrixXd const> const &, cluon::data::TimeStamp const &)> delegate);
+  ~ConeFrameReader();
+  bool isRunning();
+
+ private:
+  void run();
+
+  std::unique_ptr<cluon::SharedMemory> m_sharedMemory;
+  std::function<void(Eigen::Ref<Eigen::MatrixXd const> const &, cluon::data::TimeStamp const &)> m_delegate;
+  std::atomic<bool> m_running;
+  std::thread m_reader;
+  uint32_t m_lastSequence = 0;
+};
+
+#endif
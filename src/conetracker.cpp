@@ -0,0 +1,159 @@
+/**
+ * Copyright (C) 2018 Chalmers Revere
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+
+#include "conetracker.hpp"
+#include "landmarkstore.hpp"
+
+ConeTracker::ConeTracker(uint32_t confirmations, uint32_t maxMissedKeyframes, double sameConeThreshold):
+  m_confirmations()
+, m_maxMissedKeyframes(maxMissedKeyframes)
+, m_sameConeThreshold(sameConeThreshold)
+, m_size(0)
+, m_x()
+, m_y()
+, m_type()
+, m_observations()
+, m_missedKeyframes()
+, m_poseIds()
+, m_measurements()
+{
+  setConfirmations(confirmations);
+}
+
+int32_t ConeTracker::observe(double x, double y, int type, int poseId, Eigen::Vector3d const &measurement)
+{
+  //Closest candidate of the same class
+  int32_t candidate = -1;
+  double minDistance = m_sameConeThreshold*m_sameConeThreshold;
+  ConeClass coneClass = LandmarkStore::coneClass(type);
+  for(uint32_t i = 0; i < m_size; i++){
+    double distance = (m_x[i]-x)*(m_x[i]-x)+(m_y[i]-y)*(m_y[i]-y);
+    if(distance < minDistance && LandmarkStore::coneClass(m_type[i]) == coneClass){
+      candidate = static_cast<int32_t>(i);
+      minDistance = distance;
+    }
+  }
+  if(candidate < 0){
+    if(m_size == MAX_CANDIDATES){
+      return -1;
+    }
+    candidate = static_cast<int32_t>(m_size++);
+    m_x[candidate] = x;
+    m_y[candidate] = y;
+    m_type[candidate] = type;
+    m_observations[candidate] = 0;
+  }
+  else{
+    //Running mean of the detections
+    double n = static_cast<double>(m_observations[candidate]);
+    m_x[candidate] = (m_x[candidate]*n+x)/(n+1);
+    m_y[candidate] = (m_y[candidate]*n+y)/(n+1);
+  }
+  if(m_observations[candidate] < MAX_CONFIRMATIONS){
+    m_poseIds[candidate][m_observations[candidate]] = poseId;
+    m_measurements[candidate][m_observations[candidate]] = measurement;
+    m_observations[candidate]++;
+  }
+  m_missedKeyframes[candidate] = 0;
+  return candidate;
+}
+
+bool ConeTracker::isConfirmed(uint32_t candidate) const
+{
+  return m_observations[candidate] >= m_confirmations;
+}
+
+void ConeTracker::remove(uint32_t candidate)
+{
+  //The last candidate takes the free slot
+  m_size--;
+  if(candidate == m_size){
+    return;
+  }
+  m_x[candidate] = m_x[m_size];
+  m_y[candidate] = m_y[m_size];
+  m_type[candidate] = m_type[m_size];
+  m_observations[candidate] = m_observations[m_size];
+  m_missedKeyframes[candidate] = m_missedKeyframes[m_size];
+  m_poseIds[candidate] = m_poseIds[m_size];
+  m_measurements[candidate] = m_measurements[m_size];
+}
+
+void ConeTracker::endKeyframe()
+{
+  uint32_t i = 0;
+  while(i < m_size){
+    if(++m_missedKeyframes[i] > m_maxMissedKeyframes){
+      remove(i);
+    }
+    else{
+      i++;
+    }
+  }
+}
+
+void ConeTracker::setConfirmations(uint32_t confirmations)
+{
+  m_confirmations = (confirmations < 1)?(1):((confirmations > MAX_CONFIRMATIONS)?(MAX_CONFIRMATIONS):(confirmations));
+}
+
+void ConeTracker::setMaxMissedKeyframes(uint32_t maxMissedKeyframes)
+{
+  m_maxMissedKeyframes = maxMissedKeyframes;
+}
+
+void ConeTracker::setSameConeThreshold(double sameConeThreshold)
+{
+  m_sameConeThreshold = sameConeThreshold;
+}
+
+uint32_t ConeTracker::size() const
+{
+  return m_size;
+}
+
+double ConeTracker::x(uint32_t candidate) const
+{
+  return m_x[candidate];
+}
+
+double ConeTracker::y(uint32_t candidate) const
+{
+  return m_y[candidate];
+}
+
+int ConeTracker::type(uint32_t candidate) const
+{
+  return m_type[candidate];
+}
+
+uint32_t ConeTracker::observations(uint32_t candidate) const
+{
+  return m_observations[candidate];
+}
+
+int ConeTracker::observationPoseId(uint32_t candidate, uint32_t observation) const
+{
+  return m_poseIds[candidate][observation];
+}
+
+Eigen::Vector3d const &ConeTracker::observationMeasurement(uint32_t candidate, uint32_t observation) const
+{
+  return m_measurements[candidate][observation];
+}
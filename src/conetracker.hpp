@@ -0,0 +1,76 @@
+/**
+ * Copyright (C) 2018 Chalmers Revere
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+
+#ifndef CONETRACKER_HPP
+#define CONETRACKER_HPP
+
+#include <array>
+#include <cstdint>
+#include <Eigen/Dense>
+
+/*
+ * Short term tracks of cones that are not in the map yet. A new detection
+ * becomes a candidate, later detections of the same class within the same
+ * cone threshold are added to it. After the configured number of
+ * observations the candidate is confirmed and can be promoted to a landmark,
+ * its observations (keyframe pose vertex and measurement) are kept until then
+ * so that none of them are lost. Candidates not seen for a number of
+ * keyframes are dropped. Fixed capacity, nothing is allocated after
+ * construction.
+ */
+class ConeTracker {
+ public:
+  ConeTracker(uint32_t confirmations, uint32_t maxMissedKeyframes, double sameConeThreshold);
+
+  //Returns the candidate the detection was added to, -1 if all slots are taken
+  int32_t observe(double x, double y, int type, int poseId, Eigen::Vector3d const &measurement);
+  bool isConfirmed(uint32_t candidate) const;
+  void remove(uint32_t candidate);
+  //Ages all candidates, called once per keyframe
+  void endKeyframe();
+  void setConfirmations(uint32_t confirmations);
+  void setMaxMissedKeyframes(uint32_t maxMissedKeyframes);
+  void setSameConeThreshold(double sameConeThreshold);
+
+  uint32_t size() const;
+  double x(uint32_t candidate) const;
+  double y(uint32_t candidate) const;
+  int type(uint32_t candidate) const;
+  uint32_t observations(uint32_t candidate) const;
+  int observationPoseId(uint32_t candidate, uint32_t observation) const;
+  Eigen::Vector3d const &observationMeasurement(uint32_t candidate, uint32_t observation) const;
+
+  static const uint32_t MAX_CANDIDATES = 256;
+  static const uint32_t MAX_CONFIRMATIONS = 8;
+
+ private:
+  uint32_t m_confirmations;
+  uint32_t m_maxMissedKeyframes;
+  double m_sameConeThreshold;
+  uint32_t m_size;
+  std::array<double,MAX_CANDIDATES> m_x;
+  std::array<double,MAX_CANDIDATES> m_y;
+  std::array<int,MAX_CANDIDATES> m_type;
+  std::array<uint32_t,MAX_CANDIDATES> m_observations;
+  std::array<uint32_t,MAX_CANDIDATES> m_missedKeyframes;
+  std::array<std::array<int,MAX_CONFIRMATIONS>,MAX_CANDIDATES> m_poseIds;
+  std::array<std::array<Eigen::Vector3d,MAX_CONFIRMATIONS>,MAX_CANDIDATES> m_measurements;
+};
+
+#endif
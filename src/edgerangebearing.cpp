@@ -0,0 +1,173 @@
+/**
+ * Copyright (C) 2018 Chalmers Revere
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+
+#include <cmath>
+#include <cstring>
+
+#include "g2o/core/factory.h"
+#include "edgerangebearing.hpp"
+
+G2O_REGISTER_TYPE(EDGE_SE2_RANGE_BEARING, EdgeRangeBearing);
+
+namespace {
+const double DEG2RAD = 0.017453292522222; // PI/180.0
+
+double wrapAngle(double angle)
+{
+  return std::atan2(std::sin(angle), std::cos(angle));
+}
+}
+
+EdgeRangeBearing::EdgeRangeBearing():
+  g2o::BaseBinaryEdge<2, Eigen::Vector2d, g2o::VertexSE2, g2o::VertexPointXY>()
+, m_sensorOffset(Eigen::Vector2d::Zero())
+, m_error(Eigen::Vector2d::Zero())
+, m_poseJacobian(Eigen::Matrix<double,2,3>::Zero())
+, m_coneJacobian(Eigen::Matrix2d::Zero())
+, m_cachedAt()
+, m_cached(false)
+{
+}
+
+void EdgeRangeBearing::setObservation(double azimuth, double zenith, double distance)
+{
+  //Cones are seen at a small zenith, the range is taken in the ground plane
+  double range = (std::fabs(zenith) > 0)?(distance*std::cos(zenith*DEG2RAD)):(distance);
+  setMeasurement(Eigen::Vector2d(range, azimuth*DEG2RAD));
+}
+
+void EdgeRangeBearing::setMeasurement(Eigen::Vector2d const &measurement)
+{
+  _measurement = measurement;
+  m_cached = false;
+}
+
+void EdgeRangeBearing::setSensorOffset(Eigen::Vector2d const &offset)
+{
+  m_sensorOffset = offset;
+  m_cached = false;
+}
+
+Eigen::Vector2d const &EdgeRangeBearing::sensorOffset() const
+{
+  return m_sensorOffset;
+}
+
+std::array<double,5> EdgeRangeBearing::estimates() const
+{
+  Eigen::Vector3d pose = static_cast<g2o::VertexSE2 const*>(_vertices[0])->estimate().toVector();
+  Eigen::Vector2d const &cone = static_cast<g2o::VertexPointXY const*>(_vertices[1])->estimate();
+  return {{pose(0), pose(1), pose(2), cone(0), cone(1)}};
+}
+
+bool EdgeRangeBearing::isCached(std::array<double,5> const &at) const
+{
+  //Bitwise, the cache must give exactly what evaluating again would
+  return m_cached && std::memcmp(at.data(), m_cachedAt.data(), sizeof(double)*at.size()) == 0;
+}
+
+void EdgeRangeBearing::evaluate(std::array<double,5> const &at, bool withJacobians)
+{
+  //Cone relative to the CoG and to the sensor, in the frame of the car
+  double c = std::cos(at[2]);
+  double s = std::sin(at[2]);
+  double dx = at[3]-at[0];
+  double dy = at[4]-at[1];
+  Eigen::Vector2d fromCoG(c*dx+s*dy, -s*dx+c*dy);
+  Eigen::Vector2d fromSensor = fromCoG-m_sensorOffset;
+  m_error << _measurement(0)-fromSensor.norm(), wrapAngle(_measurement(1)-std::atan2(fromSensor(1), fromSensor(0)));
+  m_cached = false;
+  if(!withJacobians){
+    return;
+  }
+  double squaredRange = fromSensor.squaredNorm();
+  double range = std::sqrt(squaredRange);
+  if(range < 1e-9){
+    m_poseJacobian.setZero();
+    m_coneJacobian.setZero();
+  }
+  else{
+    //Derivatives of the predicted range and bearing by the cone relative to the sensor
+    Eigen::Matrix2d byRelative;
+    byRelative << fromSensor(0)/range, fromSensor(1)/range,
+                  -fromSensor(1)/squaredRange, fromSensor(0)/squaredRange;
+    //The relative cone is rotated by the transposed heading, it moves against the position and turns with the heading
+    Eigen::Matrix2d byCone;
+    byCone << c, s,
+              -s, c;
+    Eigen::Vector2d byHeading(fromCoG(1), -fromCoG(0));
+    //The error is the measurement minus the prediction
+    m_coneJacobian = -byRelative*byCone;
+    m_poseJacobian.leftCols<2>() = byRelative*byCone;
+    m_poseJacobian.col(2) = -byRelative*byHeading;
+  }
+  m_cachedAt = at;
+  m_cached = true;
+}
+
+void EdgeRangeBearing::precompute()
+{
+  evaluate(estimates(), true);
+}
+
+void EdgeRangeBearing::computeError()
+{
+  std::array<double,5> at = estimates();
+  if(!isCached(at)){
+    evaluate(at, false);
+  }
+  _error = m_error;
+}
+
+void EdgeRangeBearing::linearizeOplus()
+{
+  std::array<double,5> at = estimates();
+  if(!isCached(at)){
+    evaluate(at, true);
+  }
+  _jacobianOplusXi = m_poseJacobian;
+  _jacobianOplusXj = m_coneJacobian;
+}
+
+bool EdgeRangeBearing::read(std::istream &is)
+{
+  Eigen::Vector2d measurement;
+  is >> measurement(0) >> measurement(1) >> m_sensorOffset(0) >> m_sensorOffset(1);
+  setMeasurement(measurement);
+  InformationType information;
+  for(int i = 0; i < 2; i++){
+    for(int j = i; j < 2; j++){
+      is >> information(i,j);
+      information(j,i) = information(i,j);
+    }
+  }
+  setInformation(information);
+  return is.good() || is.eof();
+}
+
+bool EdgeRangeBearing::write(std::ostream &os) const
+{
+  os << _measurement(0) << " " << _measurement(1) << " " << m_sensorOffset(0) << " " << m_sensorOffset(1);
+  for(int i = 0; i < 2; i++){
+    for(int j = i; j < 2; j++){
+      os << " " << information()(i,j);
+    }
+  }
+  return os.good();
+}
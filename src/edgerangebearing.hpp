@@ -0,0 +1,73 @@
+/**
+ * Copyright (C) 2018 Chalmers Revere
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+
+#ifndef EDGERANGEBEARING_HPP
+#define EDGERANGEBEARING_HPP
+
+#include <array>
+#include <iostream>
+#include <Eigen/Dense>
+
+#include "g2o/core/base_binary_edge.h"
+#include "g2o/types/slam2d/vertex_se2.h"
+#include "g2o/types/slam2d/vertex_point_xy.h"
+
+/*
+ * A cone seen by a sensor mounted at an offset from the CoG, with its axes
+ * along those of the car. The measurement is the range in the ground plane
+ * in metres and the bearing in radians, positive to the left, so noise is
+ * given per axis. The error is the measurement minus the prediction from the
+ * pose and the cone, with the bearing wrapped; the Jacobians are analytic.
+ * Saved as EDGE_SE2_RANGE_BEARING: ids, range, bearing, offset and the upper
+ * triangle of the information matrix.
+ *
+ * precompute evaluates the error and the Jacobians ahead of the optimizer,
+ * on any thread as it only touches this edge. As long as the estimates are
+ * bit for bit the ones it saw, computeError and linearizeOplus copy them.
+ */
+class EdgeRangeBearing : public g2o::BaseBinaryEdge<2, Eigen::Vector2d, g2o::VertexSE2, g2o::VertexPointXY> {
+ public:
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+  EdgeRangeBearing();
+  //Azimuth and zenith in degrees and the distance, as perception sends them
+  void setObservation(double azimuth, double zenith, double distance);
+  void setMeasurement(Eigen::Vector2d const &measurement) override;
+  void setSensorOffset(Eigen::Vector2d const &offset);
+  Eigen::Vector2d const &sensorOffset() const;
+  void precompute();
+  void computeError() override;
+  void linearizeOplus() override;
+  bool read(std::istream &is) override;
+  bool write(std::ostream &os) const override;
+
+ private:
+  //Pose and cone the estimates are read from, in the order they are cached
+  std::array<double,5> estimates() const;
+  void evaluate(std::array<double,5> const &at, bool withJacobians);
+  bool isCached(std::array<double,5> const &at) const;
+
+  Eigen::Vector2d m_sensorOffset;
+  Eigen::Vector2d m_error;
+  Eigen::Matrix<double,2,3> m_poseJacobian;
+  Eigen::Matrix2d m_coneJacobian;
+  std::array<double,5> m_cachedAt;
+  bool m_cached;
+};
+
+#endif
@@ -0,0 +1,224 @@
+/**
+ * Copyright (C) 2018 Chalmers Revere
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+
+#include <cmath>
+
+#include "ekfslam.hpp"
+
+namespace {
+double wrapAngle(double angle)
+{
+  return std::atan2(std::sin(angle), std::cos(angle));
+}
+}
+
+EkfSlam::EkfSlam(std::map<std::string, std::string> commandlineArguments):
+  m_odometryNoise(0.1)
+, m_headingNoise(0.05)
+, m_measurementNoise(0.3)
+, m_hasOdometry(false)
+, m_lastOdometry(Eigen::Vector3d::Zero())
+, m_size(3)
+, m_state(Eigen::VectorXd::Zero(3))
+, m_covariance(Eigen::MatrixXd::Zero(3,3))
+, m_pht(Eigen::MatrixXd::Zero(3,2))
+, m_gain(Eigen::MatrixXd::Zero(3,2))
+{
+  setUp(commandlineArguments);
+  reserve(3+2*128);
+}
+
+void EkfSlam::setUp(std::map<std::string, std::string> configuration)
+{
+  m_odometryNoise = (configuration.count("odometryNoise") != 0)?(static_cast<double>(std::stod(configuration["odometryNoise"]))):(0.1);
+  m_headingNoise = (configuration.count("headingNoise") != 0)?(static_cast<double>(std::stod(configuration["headingNoise"]))):(0.05);
+  m_measurementNoise = (configuration.count("measurementNoise") != 0)?(static_cast<double>(std::stod(configuration["measurementNoise"]))):(0.3);
+}
+
+void EkfSlam::predict(Eigen::Vector3d const &odometryPose)
+{
+  if(!m_hasOdometry){
+    //The first keyframe places the car
+    m_hasOdometry = true;
+    m_lastOdometry = odometryPose;
+    m_state.head<3>() = odometryPose;
+    return;
+  }
+  //Motion since the last keyframe in the frame of the car
+  double dx = odometryPose(0)-m_lastOdometry(0);
+  double dy = odometryPose(1)-m_lastOdometry(1);
+  double ux = std::cos(m_lastOdometry(2))*dx+std::sin(m_lastOdometry(2))*dy;
+  double uy = -std::sin(m_lastOdometry(2))*dx+std::cos(m_lastOdometry(2))*dy;
+  double uHeading = wrapAngle(odometryPose(2)-m_lastOdometry(2));
+  m_lastOdometry = odometryPose;
+
+  double c = std::cos(m_state(2));
+  double s = std::sin(m_state(2));
+  m_state(0) += c*ux-s*uy;
+  m_state(1) += s*ux+c*uy;
+  m_state(2) = wrapAngle(m_state(2)+uHeading);
+
+  Eigen::Matrix3d motionJacobian;
+  motionJacobian << 1, 0, -s*ux-c*uy,
+                    0, 1, c*ux-s*uy,
+                    0, 0, 1;
+  Eigen::Matrix3d noiseJacobian;
+  noiseJacobian << c, -s, 0,
+                   s, c, 0,
+                   0, 0, 1;
+  double distance = std::sqrt(ux*ux+uy*uy);
+  Eigen::Vector3d deviation(m_odometryNoise*distance+1e-3, m_odometryNoise*distance+1e-3, m_headingNoise*std::fabs(uHeading)+1e-3);
+  Eigen::Matrix3d motionNoise = deviation.cwiseProduct(deviation).asDiagonal();
+
+  //Only the pose rows and columns change
+  const uint32_t landmarkRows = m_size-3;
+  m_covariance.topLeftCorner<3,3>() = motionJacobian*m_covariance.topLeftCorner<3,3>()*motionJacobian.transpose()+noiseJacobian*motionNoise*noiseJacobian.transpose();
+  if(landmarkRows > 0){
+    m_covariance.block(0,3,3,landmarkRows) = motionJacobian*m_covariance.block(0,3,3,landmarkRows);
+    m_covariance.block(3,0,landmarkRows,3) = m_covariance.block(0,3,3,landmarkRows).transpose();
+  }
+}
+
+void EkfSlam::update(FilterObservation const *observations, uint32_t numberOfObservations)
+{
+  //Known landmarks first, new ones are placed from the corrected pose
+  for(uint32_t i = 0; i < numberOfObservations; i++){
+    if(!observations[i].isNew && observations[i].landmark < landmarks()){
+      correct(observations[i].landmark, observations[i].x, observations[i].y);
+    }
+  }
+  for(uint32_t i = 0; i < numberOfObservations; i++){
+    if(observations[i].isNew && observations[i].landmark == landmarks()){
+      initialize(observations[i].x, observations[i].y);
+    }
+  }
+}
+
+void EkfSlam::correct(uint32_t landmark, double x, double y)
+{
+  const uint32_t n = m_size;
+  const uint32_t column = 3+2*landmark;
+  double c = std::cos(m_state(2));
+  double s = std::sin(m_state(2));
+  double dx = m_state(column)-m_state(0);
+  double dy = m_state(column+1)-m_state(1);
+  Eigen::Vector2d innovation(x-(c*dx+s*dy), y-(-s*dx+c*dy));
+
+  Eigen::Matrix<double,2,3> poseJacobian;
+  poseJacobian << -c, -s, -s*dx+c*dy,
+                  s, -c, -c*dx-s*dy;
+  Eigen::Matrix2d landmarkJacobian;
+  landmarkJacobian << c, s,
+                      -s, c;
+
+  //P*H' from the five columns the measurement depends on
+  auto pht = m_pht.topRows(n);
+  pht.noalias() = m_covariance.block(0,0,n,3)*poseJacobian.transpose();
+  pht.noalias() += m_covariance.block(0,column,n,2)*landmarkJacobian.transpose();
+  Eigen::Matrix2d innovationCovariance = poseJacobian*pht.topRows<3>()+landmarkJacobian*pht.block<2,2>(column,0)+Eigen::Matrix2d::Identity()*m_measurementNoise*m_measurementNoise;
+  auto gain = m_gain.topRows(n);
+  gain.noalias() = pht*innovationCovariance.inverse();
+
+  m_state.head(n).noalias() += gain*innovation;
+  m_state(2) = wrapAngle(m_state(2));
+  m_covariance.topLeftCorner(n,n).noalias() -= gain*pht.transpose();
+}
+
+void EkfSlam::initialize(double x, double y)
+{
+  const uint32_t n = m_size;
+  reserve(n+2);
+  double c = std::cos(m_state(2));
+  double s = std::sin(m_state(2));
+  m_state(n) = m_state(0)+c*x-s*y;
+  m_state(n+1) = m_state(1)+s*x+c*y;
+
+  Eigen::Matrix<double,2,3> poseJacobian;
+  poseJacobian << 1, 0, -s*x-c*y,
+                  0, 1, c*x-s*y;
+  Eigen::Matrix2d measurementJacobian;
+  measurementJacobian << c, -s,
+                         s, c;
+  m_covariance.block(n,0,2,n) = poseJacobian*m_covariance.block(0,0,3,n);
+  m_covariance.block(0,n,n,2) = m_covariance.block(n,0,2,n).transpose();
+  m_covariance.block<2,2>(n,n) = poseJacobian*m_covariance.topLeftCorner<3,3>()*poseJacobian.transpose()+measurementJacobian*measurementJacobian.transpose()*m_measurementNoise*m_measurementNoise;
+  m_size = n+2;
+}
+
+void EkfSlam::addMappedLandmark(double x, double y)
+{
+  const uint32_t n = m_size;
+  reserve(n+2);
+  m_state(n) = x;
+  m_state(n+1) = y;
+  m_covariance.block(n,0,2,n+2).setZero();
+  m_covariance.block(0,n,n+2,2).setZero();
+  m_size = n+2;
+}
+
+void EkfSlam::reset(Eigen::Vector3d const &pose)
+{
+  m_hasOdometry = false;
+  m_state.head<3>() = pose;
+  m_covariance.topRows(3).leftCols(m_size).setZero();
+  m_covariance.leftCols(3).topRows(m_size).setZero();
+}
+
+Eigen::Vector3d EkfSlam::pose() const
+{
+  return m_state.head<3>();
+}
+
+Eigen::Vector2d EkfSlam::landmark(uint32_t landmark) const
+{
+  return m_state.segment<2>(3+2*landmark);
+}
+
+uint32_t EkfSlam::landmarks() const
+{
+  return (m_size-3)/2;
+}
+
+Eigen::Matrix2d EkfSlam::landmarkCovariance(uint32_t landmark) const
+{
+  return m_covariance.block<2,2>(3+2*landmark,3+2*landmark);
+}
+
+Eigen::Matrix3d EkfSlam::poseCovariance() const
+{
+  return m_covariance.topLeftCorner<3,3>();
+}
+
+void EkfSlam::reserve(uint32_t size)
+{
+  if(size <= m_state.size()){
+    return;
+  }
+  uint32_t capacity = static_cast<uint32_t>(m_state.size());
+  while(capacity < size){
+    capacity *= 2;
+  }
+  m_state.conservativeResize(capacity);
+  m_covariance.conservativeResize(capacity,capacity);
+  m_state.tail(capacity-m_size).setZero();
+  m_covariance.rightCols(capacity-m_size).setZero();
+  m_covariance.bottomRows(capacity-m_size).setZero();
+  m_pht.resize(capacity,2);
+  m_gain.resize(capacity,2);
+}
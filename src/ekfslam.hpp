@@ -0,0 +1,70 @@
+/**
+ * Copyright (C) 2018 Chalmers Revere
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+
+#ifndef EKFSLAM_HPP
+#define EKFSLAM_HPP
+
+#include <map>
+#include <string>
+#include <Eigen/Dense>
+
+#include "filterbackend.hpp"
+
+/*
+ * EKF-SLAM. The state is the car pose followed by the landmarks in store
+ * order, two rows each, so a landmark and its covariance blocks are found by
+ * index. A measurement only involves the pose and one landmark: the gain is
+ * formed from those five columns of the covariance, which makes an update
+ * linear in the state size for the gain and quadratic only for the
+ * covariance itself. Storage grows by doubling and is reused.
+ */
+class EkfSlam : public FilterBackend {
+ public:
+  EkfSlam(std::map<std::string, std::string> commandlineArguments);
+
+  void predict(Eigen::Vector3d const &odometryPose) override;
+  void update(FilterObservation const *observations, uint32_t numberOfObservations) override;
+  void addMappedLandmark(double x, double y) override;
+  void reset(Eigen::Vector3d const &pose) override;
+  Eigen::Vector3d pose() const override;
+  Eigen::Vector2d landmark(uint32_t landmark) const override;
+  uint32_t landmarks() const override;
+  Eigen::Matrix2d landmarkCovariance(uint32_t landmark) const;
+  Eigen::Matrix3d poseCovariance() const;
+
+ private:
+  void setUp(std::map<std::string, std::string> configuration);
+  void correct(uint32_t landmark, double x, double y);
+  void initialize(double x, double y);
+  void reserve(uint32_t size);
+
+  double m_odometryNoise;
+  double m_headingNoise;
+  double m_measurementNoise;
+  bool m_hasOdometry;
+  Eigen::Vector3d m_lastOdometry;
+  uint32_t m_size;
+  Eigen::VectorXd m_state;
+  Eigen::MatrixXd m_covariance;
+  //Per measurement P*H' and gain, sized with the state
+  Eigen::MatrixXd m_pht;
+  Eigen::MatrixXd m_gain;
+};
+
+#endif
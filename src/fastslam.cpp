@@ -0,0 +1,314 @@
+/**
+ * Copyright (C) 2018 Chalmers Revere
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+
+#include <cmath>
+#include <iostream>
+
+#include "fastslam.hpp"
+
+namespace {
+double wrapAngle(double angle)
+{
+  return std::atan2(std::sin(angle), std::cos(angle));
+}
+
+//Landmark in the frame of the car and its Jacobians to the pose and the landmark
+void measure(Eigen::Vector3d const &pose, LandmarkEstimate const &landmark, Eigen::Vector2d &prediction, Eigen::Matrix<double,2,3> &poseJacobian, Eigen::Matrix2d &landmarkJacobian)
+{
+  double c = std::cos(pose(2));
+  double s = std::sin(pose(2));
+  double dx = landmark.x-pose(0);
+  double dy = landmark.y-pose(1);
+  prediction << c*dx+s*dy, -s*dx+c*dy;
+  poseJacobian << -c, -s, -s*dx+c*dy,
+                  s, -c, -c*dx-s*dy;
+  landmarkJacobian << c, s,
+                      -s, c;
+}
+
+Eigen::Matrix2d covarianceOf(LandmarkEstimate const &landmark)
+{
+  Eigen::Matrix2d covariance;
+  covariance << landmark.xx, landmark.xy,
+                landmark.xy, landmark.yy;
+  return covariance;
+}
+}
+
+Particle::Particle():
+  pose(Eigen::Vector3d::Zero())
+, logWeight(0)
+, landmarks()
+{
+}
+
+FastSlam::FastSlam(std::map<std::string, std::string> commandlineArguments):
+  m_odometryNoise(0.1)
+, m_headingNoise(0.05)
+, m_measurementNoise(0.3)
+, m_resampleThreshold(0.5)
+, m_seed(5489u)
+, m_threadPool((commandlineArguments.count("particleThreads") != 0)?(static_cast<uint32_t>(std::stoi(commandlineArguments["particleThreads"]))):(0))
+, m_particles()
+, m_resampled()
+, m_best(0)
+, m_hasOdometry(false)
+, m_lastOdometry(Eigen::Vector3d::Zero())
+, m_motionVariance(Eigen::Vector3d::Zero())
+, m_updates(0)
+, m_observations(nullptr)
+, m_numberOfObservations(0)
+, m_updateTask()
+, m_generator(m_seed)
+{
+  setUp(commandlineArguments);
+  m_updateTask = [this](uint32_t index){updateParticle(index);};
+  std::cout << "FastSLAM with " << m_particles.size() << " particles on " << m_threadPool.threads() << " threads" << std::endl;
+}
+
+void FastSlam::setUp(std::map<std::string, std::string> configuration)
+{
+  uint32_t particles = (configuration.count("particles") != 0)?(static_cast<uint32_t>(std::stoi(configuration["particles"]))):(50);
+  m_odometryNoise = (configuration.count("odometryNoise") != 0)?(static_cast<double>(std::stod(configuration["odometryNoise"]))):(0.1);
+  m_headingNoise = (configuration.count("headingNoise") != 0)?(static_cast<double>(std::stod(configuration["headingNoise"]))):(0.05);
+  m_measurementNoise = (configuration.count("measurementNoise") != 0)?(static_cast<double>(std::stod(configuration["measurementNoise"]))):(0.3);
+  m_resampleThreshold = (configuration.count("resampleThreshold") != 0)?(static_cast<double>(std::stod(configuration["resampleThreshold"]))):(0.5);
+  m_particles.resize((particles > 0)?(particles):(1));
+  m_resampled.resize(m_particles.size());
+}
+
+void FastSlam::predict(Eigen::Vector3d const &odometryPose)
+{
+  if(!m_hasOdometry){
+    //The first keyframe places the car
+    m_hasOdometry = true;
+    m_lastOdometry = odometryPose;
+    for(auto &particle : m_particles){
+      particle.pose = odometryPose;
+    }
+    return;
+  }
+  //Motion since the last keyframe in the frame of the car, the noise is sampled on the update
+  double dx = odometryPose(0)-m_lastOdometry(0);
+  double dy = odometryPose(1)-m_lastOdometry(1);
+  double ux = std::cos(m_lastOdometry(2))*dx+std::sin(m_lastOdometry(2))*dy;
+  double uy = -std::sin(m_lastOdometry(2))*dx+std::cos(m_lastOdometry(2))*dy;
+  double uHeading = wrapAngle(odometryPose(2)-m_lastOdometry(2));
+  m_lastOdometry = odometryPose;
+  for(auto &particle : m_particles){
+    double c = std::cos(particle.pose(2));
+    double s = std::sin(particle.pose(2));
+    particle.pose(0) += c*ux-s*uy;
+    particle.pose(1) += s*ux+c*uy;
+    particle.pose(2) = wrapAngle(particle.pose(2)+uHeading);
+  }
+  double distance = std::sqrt(ux*ux+uy*uy);
+  Eigen::Vector3d deviation(m_odometryNoise*distance+1e-3, m_odometryNoise*distance+1e-3, m_headingNoise*std::fabs(uHeading)+1e-3);
+  m_motionVariance += deviation.cwiseProduct(deviation);
+}
+
+void FastSlam::update(FilterObservation const *observations, uint32_t numberOfObservations)
+{
+  if(numberOfObservations == 0 && m_motionVariance.isZero()){
+    return;
+  }
+  m_observations = observations;
+  m_numberOfObservations = numberOfObservations;
+  m_threadPool.run(static_cast<uint32_t>(m_particles.size()), m_updateTask);
+  m_motionVariance.setZero();
+  m_updates++;
+  normalize();
+  resample();
+}
+
+void FastSlam::updateParticle(uint32_t index)
+{
+  Particle &particle = m_particles[index];
+  //Independent of the thread the particle is updated on
+  std::mt19937 generator(m_seed+m_updates*2654435761u+index*40503u);
+  std::normal_distribution<double> normal(0.0, 1.0);
+  const Eigen::Matrix2d measurementNoise = Eigen::Matrix2d::Identity()*m_measurementNoise*m_measurementNoise;
+
+  double c = std::cos(particle.pose(2));
+  double s = std::sin(particle.pose(2));
+  Eigen::Matrix3d rotation;
+  rotation << c, -s, 0,
+              s, c, 0,
+              0, 0, 1;
+  Eigen::Matrix3d motionNoise = rotation*(m_motionVariance+Eigen::Vector3d::Constant(1e-9)).asDiagonal()*rotation.transpose();
+
+  //Proposal: the predicted pose corrected by the known landmarks one by one
+  Eigen::Vector3d mean = particle.pose;
+  Eigen::Matrix3d covariance = motionNoise;
+  Eigen::Vector2d prediction;
+  Eigen::Matrix<double,2,3> poseJacobian;
+  Eigen::Matrix2d landmarkJacobian;
+  for(uint32_t i = 0; i < m_numberOfObservations; i++){
+    FilterObservation const &observation = m_observations[i];
+    if(observation.isNew || observation.landmark >= particle.landmarks.size()){
+      continue;
+    }
+    LandmarkEstimate const &landmark = particle.landmarks.get(observation.landmark);
+    measure(mean, landmark, prediction, poseJacobian, landmarkJacobian);
+    Eigen::Matrix2d innovationInverse = (landmarkJacobian*covarianceOf(landmark)*landmarkJacobian.transpose()+measurementNoise).inverse();
+    covariance = (poseJacobian.transpose()*innovationInverse*poseJacobian+covariance.inverse()).inverse();
+    mean += covariance*poseJacobian.transpose()*innovationInverse*(Eigen::Vector2d(observation.x, observation.y)-prediction);
+  }
+  Eigen::LLT<Eigen::Matrix3d> cholesky(covariance);
+  Eigen::Vector3d sample(normal(generator), normal(generator), normal(generator));
+  if(cholesky.info() == Eigen::Success){
+    particle.pose = mean+cholesky.matrixL()*sample;
+  }
+  else{
+    particle.pose = mean+covariance.diagonal().cwiseAbs().cwiseSqrt().cwiseProduct(sample);
+  }
+  particle.pose(2) = wrapAngle(particle.pose(2));
+
+  //Weight and landmark updates from the sampled pose
+  for(uint32_t i = 0; i < m_numberOfObservations; i++){
+    FilterObservation const &observation = m_observations[i];
+    if(observation.isNew || observation.landmark >= particle.landmarks.size()){
+      continue;
+    }
+    LandmarkEstimate landmark = particle.landmarks.get(observation.landmark);
+    measure(particle.pose, landmark, prediction, poseJacobian, landmarkJacobian);
+    Eigen::Matrix2d landmarkCovariance = covarianceOf(landmark);
+    Eigen::Matrix2d innovationCovariance = landmarkJacobian*landmarkCovariance*landmarkJacobian.transpose()+measurementNoise;
+    Eigen::Vector2d innovation = Eigen::Vector2d(observation.x, observation.y)-prediction;
+    Eigen::Matrix2d weightCovariance = poseJacobian*motionNoise*poseJacobian.transpose()+innovationCovariance;
+    particle.logWeight += -0.5*innovation.dot(weightCovariance.inverse()*innovation)-0.5*std::log(weightCovariance.determinant());
+
+    Eigen::Matrix2d gain = landmarkCovariance*landmarkJacobian.transpose()*innovationCovariance.inverse();
+    Eigen::Vector2d position = Eigen::Vector2d(landmark.x, landmark.y)+gain*innovation;
+    landmarkCovariance = (Eigen::Matrix2d::Identity()-gain*landmarkJacobian)*landmarkCovariance;
+    particle.landmarks.set(observation.landmark, LandmarkEstimate(position(0), position(1), landmarkCovariance(0,0), 0.5*(landmarkCovariance(0,1)+landmarkCovariance(1,0)), landmarkCovariance(1,1)));
+  }
+
+  //New landmarks in store order
+  c = std::cos(particle.pose(2));
+  s = std::sin(particle.pose(2));
+  Eigen::Matrix2d toGlobal;
+  toGlobal << c, -s,
+              s, c;
+  Eigen::Matrix2d initialCovariance = toGlobal*measurementNoise*toGlobal.transpose();
+  for(uint32_t i = 0; i < m_numberOfObservations; i++){
+    FilterObservation const &observation = m_observations[i];
+    if(observation.isNew && observation.landmark == particle.landmarks.size()){
+      Eigen::Vector2d position = particle.pose.head<2>()+toGlobal*Eigen::Vector2d(observation.x, observation.y);
+      particle.landmarks.push(LandmarkEstimate(position(0), position(1), initialCovariance(0,0), initialCovariance(0,1), initialCovariance(1,1)));
+    }
+  }
+}
+
+void FastSlam::normalize()
+{
+  double maxLogWeight = m_particles[0].logWeight;
+  for(auto const &particle : m_particles){
+    maxLogWeight = std::max(maxLogWeight, particle.logWeight);
+  }
+  for(uint32_t i = 0; i < m_particles.size(); i++){
+    m_particles[i].logWeight -= maxLogWeight;
+    m_best = (m_particles[i].logWeight >= 0)?(i):(m_best);
+  }
+}
+
+void FastSlam::resample()
+{
+  //Effective number of particles
+  double sum = 0;
+  double squaredSum = 0;
+  for(auto const &particle : m_particles){
+    double weight = std::exp(particle.logWeight);
+    sum += weight;
+    squaredSum += weight*weight;
+  }
+  const uint32_t n = static_cast<uint32_t>(m_particles.size());
+  if(sum*sum/squaredSum >= m_resampleThreshold*n){
+    return;
+  }
+  //Systematic, a copied particle shares the landmark tree of its origin
+  std::uniform_real_distribution<double> uniform(0.0, sum/n);
+  double position = uniform(m_generator);
+  double cumulative = std::exp(m_particles[0].logWeight);
+  uint32_t j = 0;
+  uint32_t best = 0;
+  for(uint32_t i = 0; i < n; i++){
+    while(cumulative < position && j < n-1){
+      j++;
+      cumulative += std::exp(m_particles[j].logWeight);
+    }
+    m_resampled[i] = m_particles[j];
+    m_resampled[i].logWeight = 0;
+    best = (j == m_best)?(i):(best);
+    position += sum/n;
+  }
+  m_particles.swap(m_resampled);
+  m_best = best;
+}
+
+void FastSlam::addMappedLandmark(double x, double y)
+{
+  //Particles that share all landmarks keep sharing them
+  LandmarkTree before = m_particles[0].landmarks;
+  m_particles[0].landmarks.push(LandmarkEstimate(x, y, 0, 0, 0));
+  for(uint32_t i = 1; i < m_particles.size(); i++){
+    if(m_particles[i].landmarks.sharesAll(before)){
+      m_particles[i].landmarks = m_particles[0].landmarks;
+    }
+    else{
+      m_particles[i].landmarks.push(LandmarkEstimate(x, y, 0, 0, 0));
+    }
+  }
+}
+
+void FastSlam::reset(Eigen::Vector3d const &pose)
+{
+  m_hasOdometry = false;
+  m_motionVariance.setZero();
+  for(auto &particle : m_particles){
+    particle.pose = pose;
+    particle.logWeight = 0;
+  }
+}
+
+Eigen::Vector3d FastSlam::pose() const
+{
+  return m_particles[m_best].pose;
+}
+
+Eigen::Vector2d FastSlam::landmark(uint32_t landmark) const
+{
+  LandmarkEstimate const &estimate = m_particles[m_best].landmarks.get(landmark);
+  return Eigen::Vector2d(estimate.x, estimate.y);
+}
+
+uint32_t FastSlam::landmarks() const
+{
+  return m_particles[m_best].landmarks.size();
+}
+
+std::vector<Particle> const &FastSlam::particles() const
+{
+  return m_particles;
+}
+
+uint32_t FastSlam::threads() const
+{
+  return m_threadPool.threads();
+}
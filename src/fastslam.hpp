@@ -0,0 +1,98 @@
+/**
+ * Copyright (C) 2018 Chalmers Revere
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+
+#ifndef FASTSLAM_HPP
+#define FASTSLAM_HPP
+
+#include <functional>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+#include <Eigen/Dense>
+
+#include "filterbackend.hpp"
+#include "landmarktree.hpp"
+#include "threadpool.hpp"
+
+//One hypothesis of the car path with its own landmark estimates
+struct Particle {
+  Particle();
+  Eigen::Vector3d pose;
+  double logWeight;
+  LandmarkTree landmarks;
+};
+
+/*
+ * FastSLAM 2.0. Every particle is a car pose with an independent 2x2 EKF per
+ * landmark. On a keyframe the pose of each particle is sampled from the
+ * odometry corrected by the observed landmarks, then the particle is weighted
+ * by how well they fit and its landmarks are updated. Particles are updated in
+ * parallel on a thread pool; the random numbers of a particle only depend on
+ * its index and the keyframe, so the result does not depend on the number of
+ * threads. Landmark maps are shared between particles copy on write, the
+ * particles copied by resampling share their whole map.
+ */
+class FastSlam : public FilterBackend {
+ private:
+  FastSlam(const FastSlam &) = delete;
+  FastSlam(FastSlam &&)      = delete;
+  FastSlam &operator=(const FastSlam &) = delete;
+  FastSlam &operator=(FastSlam &&) = delete;
+ public:
+  FastSlam(std::map<std::string, std::string> commandlineArguments);
+
+  void predict(Eigen::Vector3d const &odometryPose) override;
+  void update(FilterObservation const *observations, uint32_t numberOfObservations) override;
+  void addMappedLandmark(double x, double y) override;
+  void reset(Eigen::Vector3d const &pose) override;
+  //Of the particle with the highest weight
+  Eigen::Vector3d pose() const override;
+  Eigen::Vector2d landmark(uint32_t landmark) const override;
+  uint32_t landmarks() const override;
+  std::vector<Particle> const &particles() const;
+  uint32_t threads() const;
+
+ private:
+  void setUp(std::map<std::string, std::string> configuration);
+  void updateParticle(uint32_t index);
+  void normalize();
+  void resample();
+
+  double m_odometryNoise;
+  double m_headingNoise;
+  double m_measurementNoise;
+  double m_resampleThreshold;
+  uint32_t m_seed;
+  ThreadPool m_threadPool;
+  std::vector<Particle> m_particles;
+  std::vector<Particle> m_resampled;
+  uint32_t m_best;
+  bool m_hasOdometry;
+  Eigen::Vector3d m_lastOdometry;
+  //Variance of the motion since the last update in the frame of the car
+  Eigen::Vector3d m_motionVariance;
+  uint32_t m_updates;
+  FilterObservation const *m_observations;
+  uint32_t m_numberOfObservations;
+  std::function<void(uint32_t)> m_updateTask;
+  std::mt19937 m_generator;
+};
+
+#endif
@@ -0,0 +1,39 @@
+/**
+ * Copyright (C) 2018 Chalmers Revere
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+
+#include <iostream>
+
+#include "filterbackend.hpp"
+#include "ekfslam.hpp"
+#include "fastslam.hpp"
+
+std::unique_ptr<FilterBackend> makeFilterBackend(std::map<std::string, std::string> commandlineArguments)
+{
+  std::string backend = (commandlineArguments.count("backend") != 0)?(commandlineArguments["backend"]):("graph");
+  if(backend == "ekf"){
+    return std::unique_ptr<FilterBackend>(new EkfSlam(commandlineArguments));
+  }
+  if(backend == "fastslam"){
+    return std::unique_ptr<FilterBackend>(new FastSlam(commandlineArguments));
+  }
+  if(backend != "graph"){
+    std::cerr << "Unknown backend " << backend << ", using the graph" << std::endl;
+  }
+  return nullptr;
+}
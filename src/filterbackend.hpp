@@ -0,0 +1,64 @@
+/**
+ * Copyright (C) 2018 Chalmers Revere
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+
+#ifndef FILTERBACKEND_HPP
+#define FILTERBACKEND_HPP
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <Eigen/Dense>
+
+//A cone of the keyframe associated with a landmark, x and y relative to the CoG
+struct FilterObservation {
+  uint32_t landmark;
+  double x;
+  double y;
+  //First observation of a landmark appended to the store, it is initialized from this
+  bool isNew;
+};
+
+/*
+ * Filter based alternative to the g2o pose graph, selected with --backend.
+ * Slam keeps the ingest, the association, the landmark store and the output;
+ * a backend only estimates the car pose and the landmark positions. Landmarks
+ * are addressed by their index in the landmark store, so new ones are always
+ * appended and the store is never compacted while a backend is used.
+ */
+class FilterBackend {
+ public:
+  virtual ~FilterBackend() {}
+  //Odometry pose of a keyframe, the motion since the previous one is predicted
+  virtual void predict(Eigen::Vector3d const &odometryPose) = 0;
+  //All observations of one keyframe
+  virtual void update(FilterObservation const *observations, uint32_t numberOfObservations) = 0;
+  //Landmark of a stored map, known without uncertainty
+  virtual void addMappedLandmark(double x, double y) = 0;
+  //Places the car, as after relocalization, odometry is taken relative to this pose
+  virtual void reset(Eigen::Vector3d const &pose) = 0;
+  virtual Eigen::Vector3d pose() const = 0;
+  virtual Eigen::Vector2d landmark(uint32_t landmark) const = 0;
+  virtual uint32_t landmarks() const = 0;
+};
+
+//nullptr for the default graph backend
+std::unique_ptr<FilterBackend> makeFilterBackend(std::map<std::string, std::string> commandlineArguments);
+
+#endif
@@ -0,0 +1,55 @@
+/**
+ * Copyright (C) 2018 Chalmers Revere
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+
+#include "g2o/core/factory.h"
+#include "graphfile.hpp"
+
+//The vertex and edge types are looked up by their tags in the file
+G2O_USE_TYPE_GROUP(slam2d);
+
+bool saveGraph(std::string const &path, g2o::SparseOptimizer const &optimizer)
+{
+  std::string temporaryPath = path+".tmp";
+  {
+    std::ofstream file(temporaryPath, std::ios::out | std::ios::trunc);
+    if(!file.is_open()){
+      return false;
+    }
+    //Every double is written so it reads back bit for bit
+    file << std::setprecision(std::numeric_limits<double>::max_digits10);
+    if(!optimizer.save(file) || !file.good()){
+      return false;
+    }
+  }
+  return std::rename(temporaryPath.c_str(), path.c_str()) == 0;
+}
+
+bool loadGraph(std::string const &path, g2o::SparseOptimizer &optimizer)
+{
+  std::ifstream file(path, std::ios::in);
+  if(!file.is_open()){
+    return false;
+  }
+  return optimizer.load(file);
+}
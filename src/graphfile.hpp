@@ -0,0 +1,38 @@
+/**
+ * Copyright (C) 2018 Chalmers Revere
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+
+#ifndef GRAPHFILE_HPP
+#define GRAPHFILE_HPP
+
+#include <string>
+
+#include "g2o/core/sparse_optimizer.h"
+
+/*
+ * A pose graph on disk in the g2o text format: vertices with their estimates,
+ * edges with their measurements and information matrices, and FIX lines for
+ * fixed vertices. Vertex ids are the ones Slam gave, see VertexIds. The file
+ * is written next to the path and moved over it, so it is either the old or
+ * the complete new graph.
+ */
+bool saveGraph(std::string const &path, g2o::SparseOptimizer const &optimizer);
+//Adds the graph in the file to the optimizer, which should be empty
+bool loadGraph(std::string const &path, g2o::SparseOptimizer &optimizer);
+
+#endif
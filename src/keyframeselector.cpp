@@ -0,0 +1,71 @@
+/**
+ * Copyright (C) 2018 Chalmers Revere
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+
+#include <cmath>
+
+#include "keyframeselector.hpp"
+
+namespace {
+const double RAD2DEG = 57.295779513082325; // 1.0 / DEG2RAD;
+}
+
+KeyframeSelector::KeyframeSelector(double distance, double heading, double interval):
+  m_distance(distance)
+, m_heading(heading)
+, m_interval(interval)
+, m_hasKeyframe(false)
+, m_pose(Eigen::Vector3d::Zero())
+, m_timeStamp()
+{
+}
+
+bool KeyframeSelector::isKeyframe(Eigen::Vector3d const &pose, cluon::data::TimeStamp const &timeStamp)
+{
+  if(!m_hasKeyframe){
+    m_hasKeyframe = true;
+    m_pose = pose;
+    m_timeStamp = timeStamp;
+    return true;
+  }
+  double timeElapsed = static_cast<double>(cluon::time::deltaInMicroseconds(timeStamp,m_timeStamp))/1000000;
+  double distance = std::sqrt((pose(0)-m_pose(0))*(pose(0)-m_pose(0)) + (pose(1)-m_pose(1))*(pose(1)-m_pose(1)));
+  double headingChange = std::fabs(std::atan2(std::sin(pose(2)-m_pose(2)),std::cos(pose(2)-m_pose(2))))*RAD2DEG;
+  bool moving = distance > m_distance*0.1 || headingChange > m_heading*0.1;
+  if(distance > m_distance || headingChange > m_heading || (timeElapsed > m_interval && moving)){
+    m_pose = pose;
+    m_timeStamp = timeStamp;
+    return true;
+  }
+  return false;
+}
+
+void KeyframeSelector::setDistance(double distance)
+{
+  m_distance = distance;
+}
+
+void KeyframeSelector::setHeading(double heading)
+{
+  m_heading = heading;
+}
+
+void KeyframeSelector::setInterval(double interval)
+{
+  m_interval = interval;
+}
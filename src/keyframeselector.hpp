@@ -0,0 +1,55 @@
+/**
+ * Copyright (C) 2018 Chalmers Revere
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+
+#ifndef KEYFRAMESELECTOR_HPP
+#define KEYFRAMESELECTOR_HPP
+
+#include <Eigen/Dense>
+#include "cluon-complete.hpp"
+
+/*
+ * Decides which cone frames become keyframes from the odometry pose and the
+ * sample time of the frame. A frame is a keyframe once the car has moved or
+ * turned far enough since the last keyframe, or when the interval has passed
+ * while it is moving. Below a tenth of both thresholds the car counts as
+ * standing still and no keyframes are added on time alone. The first frame
+ * is always a keyframe.
+ */
+class KeyframeSelector {
+ public:
+  //Distance in metres, heading in degrees and the interval in seconds. The
+  //defaults keep the keyframes about as far apart as the lidar range allows
+  //cones to be seen from several of them.
+  KeyframeSelector(double distance = 5.0, double heading = 20.0, double interval = 2.0);
+
+  bool isKeyframe(Eigen::Vector3d const &pose, cluon::data::TimeStamp const &timeStamp);
+  void setDistance(double distance);
+  void setHeading(double heading);
+  void setInterval(double interval);
+
+ private:
+  double m_distance;
+  double m_heading;
+  double m_interval;
+  bool m_hasKeyframe;
+  Eigen::Vector3d m_pose;
+  cluon::data::TimeStamp m_timeStamp;
+};
+
+#endif
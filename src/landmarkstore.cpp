@@ -0,0 +1,256 @@
+/**
+ * Copyright (C) 2018 Chalmers Revere
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+
+#include <algorithm>
+#include <cmath>
+
+#include "landmarkstore.hpp"
+
+namespace {
+//Grid cells of the pair search, keyed by both cell coordinates in one integer
+int64_t cellKey(int64_t cellX, int64_t cellY)
+{
+  return cellX*4294967296LL+cellY;
+}
+
+int64_t cellOf(double value, double cellSize)
+{
+  return static_cast<int64_t>(std::floor(value/cellSize));
+}
+}
+
+LandmarkStore::Partition::Partition():
+  x()
+, y()
+, index()
+, size(0)
+{
+}
+
+uint32_t LandmarkStore::Partition::add(double a_x, double a_y, uint32_t a_index)
+{
+  if(size == static_cast<uint32_t>(x.size())){
+    uint32_t capacity = (size > 0)?(2*size):(INITIAL_CAPACITY);
+    x.conservativeResize(capacity);
+    y.conservativeResize(capacity);
+    index.conservativeResize(capacity);
+  }
+  x(size) = a_x;
+  y(size) = a_y;
+  index(size) = static_cast<int>(a_index);
+  return size++;
+}
+
+LandmarkStore::LandmarkStore():
+  m_all()
+, m_classes()
+, m_type()
+, m_id()
+, m_observations()
+, m_slot()
+, m_changed()
+, m_size(0)
+, m_version(0)
+{
+  reserve(INITIAL_CAPACITY);
+}
+
+uint32_t LandmarkStore::size() const
+{
+  return m_size;
+}
+
+uint32_t LandmarkStore::add(double x, double y, int type, int id)
+{
+  if(m_size == static_cast<uint32_t>(m_type.size())){
+    reserve(2*m_size);
+  }
+  m_all.add(x, y, m_size);
+  m_slot(m_size) = static_cast<int>(m_classes[coneClass(type)].add(x, y, m_size));
+  m_type(m_size) = type;
+  m_id(m_size) = id;
+  m_observations(m_size) = 1;
+  m_changed(m_size) = ++m_version;
+  return m_size++;
+}
+
+void LandmarkStore::setPosition(uint32_t index, double x, double y)
+{
+  m_all.x(index) = x;
+  m_all.y(index) = y;
+  Partition &partition = m_classes[coneClass(m_type(index))];
+  partition.x(m_slot(index)) = x;
+  partition.y(m_slot(index)) = y;
+  m_changed(index) = ++m_version;
+}
+
+void LandmarkStore::addObservation(uint32_t index)
+{
+  m_observations(index)++;
+}
+
+double LandmarkStore::x(uint32_t index) const
+{
+  return m_all.x(index);
+}
+
+double LandmarkStore::y(uint32_t index) const
+{
+  return m_all.y(index);
+}
+
+int LandmarkStore::type(uint32_t index) const
+{
+  return m_type(index);
+}
+
+int LandmarkStore::id(uint32_t index) const
+{
+  return m_id(index);
+}
+
+int LandmarkStore::observations(uint32_t index) const
+{
+  return m_observations(index);
+}
+
+Cone LandmarkStore::cone(uint32_t index) const
+{
+  return Cone(*this, index);
+}
+
+uint64_t LandmarkStore::version() const
+{
+  return m_version;
+}
+
+uint32_t LandmarkStore::changedSince(uint64_t version, std::vector<uint32_t> &indices) const
+{
+  indices.clear();
+  for(uint32_t i = 0; i < m_size; i++){
+    if(m_changed(i) > version){
+      indices.push_back(i);
+    }
+  }
+  return static_cast<uint32_t>(indices.size());
+}
+
+uint32_t LandmarkStore::withinRadius(double x, double y, double radius, int type, std::vector<uint32_t> &indices) const
+{
+  indices.clear();
+  Partition const &candidates = partition(type);
+  //Distances are evaluated in fixed size blocks to stay off the heap
+  const double squaredRadius = radius*radius;
+  const uint32_t block = static_cast<uint32_t>(QUERY_BLOCK);
+  for(uint32_t start = 0; start < candidates.size; start += block){
+    const uint32_t n = (candidates.size-start < block)?(candidates.size-start):(block);
+    Eigen::Array<double,Eigen::Dynamic,1,Eigen::ColMajor,QUERY_BLOCK,1> squaredDistance = (candidates.x.segment(start,n)-x).square()+(candidates.y.segment(start,n)-y).square();
+    for(uint32_t i = 0; i < n; i++){
+      if(squaredDistance(i) < squaredRadius){
+        indices.push_back(static_cast<uint32_t>(candidates.index(start+i)));
+      }
+    }
+  }
+  return static_cast<uint32_t>(indices.size());
+}
+
+int32_t LandmarkStore::nearest(double x, double y, int type, double maxDistance) const
+{
+  Partition const &candidates = partition(type);
+  if(candidates.size == 0){
+    return -1;
+  }
+  Eigen::Index slot = 0;
+  double squaredDistance = ((candidates.x.head(candidates.size)-x).square()+(candidates.y.head(candidates.size)-y).square()).minCoeff(&slot);
+  return (squaredDistance < maxDistance*maxDistance)?(candidates.index(slot)):(-1);
+}
+
+uint32_t LandmarkStore::pairsWithin(double radius, std::vector<std::pair<uint32_t,uint32_t>> &pairs) const
+{
+  pairs.clear();
+  const double squaredRadius = radius*radius;
+  std::vector<std::pair<int64_t,uint32_t>> cells;
+  for(Partition const &candidates : m_classes){
+    //Sorted by cell, each landmark then only looks at its own and the neighbouring cells
+    cells.clear();
+    for(uint32_t slot = 0; slot < candidates.size; slot++){
+      cells.push_back(std::make_pair(cellKey(cellOf(candidates.x(slot), radius), cellOf(candidates.y(slot), radius)), slot));
+    }
+    std::sort(cells.begin(), cells.end());
+    for(uint32_t slot = 0; slot < candidates.size; slot++){
+      int64_t cellX = cellOf(candidates.x(slot), radius);
+      int64_t cellY = cellOf(candidates.y(slot), radius);
+      for(int64_t dx = -1; dx <= 1; dx++){
+        for(int64_t dy = -1; dy <= 1; dy++){
+          int64_t cell = cellKey(cellX+dx, cellY+dy);
+          auto neighbour = std::lower_bound(cells.begin(), cells.end(), std::make_pair(cell, static_cast<uint32_t>(0)));
+          for(; neighbour != cells.end() && neighbour->first == cell; neighbour++){
+            uint32_t other = neighbour->second;
+            double distance = (candidates.x(other)-candidates.x(slot))*(candidates.x(other)-candidates.x(slot))+(candidates.y(other)-candidates.y(slot))*(candidates.y(other)-candidates.y(slot));
+            if(other > slot && distance < squaredRadius){
+              pairs.push_back(std::make_pair(static_cast<uint32_t>(candidates.index(slot)), static_cast<uint32_t>(candidates.index(other))));
+            }
+          }
+        }
+      }
+    }
+  }
+  return static_cast<uint32_t>(pairs.size());
+}
+
+void LandmarkStore::merge(uint32_t into, uint32_t from)
+{
+  double weightInto = static_cast<double>(m_observations(into));
+  double weightFrom = static_cast<double>(m_observations(from));
+  setPosition(into, (x(into)*weightInto+x(from)*weightFrom)/(weightInto+weightFrom), (y(into)*weightInto+y(from)*weightFrom)/(weightInto+weightFrom));
+  m_observations(into) += m_observations(from);
+}
+
+void LandmarkStore::compact(std::vector<bool> const &keep)
+{
+  //Indices change, so every landmark counts as changed
+  LandmarkStore compacted;
+  compacted.m_version = m_version;
+  for(uint32_t i = 0; i < m_size; i++){
+    if(keep[i]){
+      uint32_t index = compacted.add(x(i), y(i), m_type(i), m_id(i));
+      compacted.m_observations(index) = m_observations(i);
+    }
+  }
+  *this = compacted;
+}
+
+ConeClass LandmarkStore::coneClass(int type)
+{
+  return (type > CONE_UNKNOWN && type < NUMBER_OF_CONE_CLASSES)?(static_cast<ConeClass>(type)):(CONE_UNKNOWN);
+}
+
+LandmarkStore::Partition const &LandmarkStore::partition(int type) const
+{
+  return (type < 0)?(m_all):(m_classes[coneClass(type)]);
+}
+
+void LandmarkStore::reserve(uint32_t capacity)
+{
+  m_type.conservativeResize(capacity);
+  m_id.conservativeResize(capacity);
+  m_observations.conservativeResize(capacity);
+  m_slot.conservativeResize(capacity);
+  m_changed.conservativeResize(capacity);
+}
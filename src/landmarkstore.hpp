@@ -0,0 +1,111 @@
+/**
+ * Copyright (C) 2018 Chalmers Revere
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+
+#ifndef LANDMARKSTORE_HPP
+#define LANDMARKSTORE_HPP
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include <Eigen/Dense>
+
+#include "cone.hpp"
+
+//Cone classes as reported in ObjectType, any other type is unknown
+enum ConeClass {
+  CONE_UNKNOWN = 0,
+  CONE_YELLOW = 1,
+  CONE_BLUE = 2,
+  CONE_SMALL_ORANGE = 3,
+  CONE_BIG_ORANGE = 4,
+  NUMBER_OF_CONE_CLASSES = 5
+};
+
+/*
+ * The cone map as a struct of arrays: x, y, type, vertex id and number of
+ * observations each in their own contiguous Eigen array, so that the queries
+ * below run as vectorized expressions. Positions are also kept partitioned by
+ * cone class, a query for a type only scans the landmarks of its class. A
+ * type below zero matches any type. Every change bumps the version of the
+ * store and stamps the changed landmark with it, consumers compare versions
+ * to skip work on a map that did not change. Cone is a view of one entry and
+ * only valid while the store is neither grown nor destroyed.
+ */
+class LandmarkStore {
+ public:
+  LandmarkStore();
+
+  uint32_t size() const;
+  uint32_t add(double x, double y, int type, int id);
+  void setPosition(uint32_t index, double x, double y);
+  void addObservation(uint32_t index);
+
+  double x(uint32_t index) const;
+  double y(uint32_t index) const;
+  int type(uint32_t index) const;
+  int id(uint32_t index) const;
+  int observations(uint32_t index) const;
+  Cone cone(uint32_t index) const;
+  uint64_t version() const;
+  //Indices of all landmarks added or moved after version
+  uint32_t changedSince(uint64_t version, std::vector<uint32_t> &indices) const;
+
+  //Indices of all landmarks of the class of type closer than radius to (x, y), in map order
+  uint32_t withinRadius(double x, double y, double radius, int type, std::vector<uint32_t> &indices) const;
+  //Index of the closest landmark of the class of type closer than maxDistance to (x, y), -1 if there is none
+  int32_t nearest(double x, double y, int type, double maxDistance) const;
+
+  //All pairs (i < j) of landmarks of the same class closer than radius, found through a grid of cells of that size
+  uint32_t pairsWithin(double radius, std::vector<std::pair<uint32_t,uint32_t>> &pairs) const;
+  //Moves landmark from into landmark into, weighted by their observations
+  void merge(uint32_t into, uint32_t from);
+  //Keeps the landmarks marked in keep, in order. Indices change, vertex ids do not
+  void compact(std::vector<bool> const &keep);
+
+  static ConeClass coneClass(int type);
+
+ private:
+  //Positions of a subset of the map and their indices into it
+  struct Partition {
+    Partition();
+    uint32_t add(double x, double y, uint32_t index);
+    Eigen::ArrayXd x;
+    Eigen::ArrayXd y;
+    Eigen::ArrayXi index;
+    uint32_t size;
+  };
+
+  Partition const &partition(int type) const;
+  void reserve(uint32_t capacity);
+
+  Partition m_all;
+  Partition m_classes[NUMBER_OF_CONE_CLASSES];
+  Eigen::ArrayXi m_type;
+  Eigen::ArrayXi m_id;
+  Eigen::ArrayXi m_observations;
+  Eigen::ArrayXi m_slot;
+  Eigen::Array<uint64_t,Eigen::Dynamic,1> m_changed;
+  uint32_t m_size;
+  uint64_t m_version;
+
+  static const uint32_t INITIAL_CAPACITY = 1024;
+  static const int QUERY_BLOCK = 64;
+};
+
+#endif
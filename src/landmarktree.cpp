@@ -0,0 +1,143 @@
+/**
+ * Copyright (C) 2018 Chalmers Revere
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+
+#include <atomic>
+
+#include "landmarktree.hpp"
+
+LandmarkEstimate::LandmarkEstimate():
+  x(0)
+, y(0)
+, xx(0)
+, xy(0)
+, yy(0)
+{
+}
+
+LandmarkEstimate::LandmarkEstimate(double a_x, double a_y, double a_xx, double a_xy, double a_yy):
+  x(a_x)
+, y(a_y)
+, xx(a_xx)
+, xy(a_xy)
+, yy(a_yy)
+{
+}
+
+LandmarkTree::Node::Node(uint64_t a_owner):
+  owner(a_owner)
+, children()
+, landmarks()
+{
+}
+
+LandmarkTree::LandmarkTree():
+  m_root()
+, m_depth(0)
+, m_size(0)
+, m_owner(nextOwner())
+{
+}
+
+LandmarkTree::LandmarkTree(LandmarkTree const &other):
+  m_root(other.m_root)
+, m_depth(other.m_depth)
+, m_size(other.m_size)
+, m_owner(nextOwner())
+{
+  //The nodes are shared from now on, neither tree may change them in place
+  other.m_owner = nextOwner();
+}
+
+LandmarkTree &LandmarkTree::operator=(LandmarkTree const &other)
+{
+  if(this != &other){
+    m_root = other.m_root;
+    m_depth = other.m_depth;
+    m_size = other.m_size;
+    m_owner = nextOwner();
+    other.m_owner = nextOwner();
+  }
+  return *this;
+}
+
+uint64_t LandmarkTree::nextOwner()
+{
+  static std::atomic<uint64_t> owners(0);
+  return ++owners;
+}
+
+uint32_t LandmarkTree::size() const
+{
+  return m_size;
+}
+
+bool LandmarkTree::sharesAll(LandmarkTree const &other) const
+{
+  return m_root == other.m_root && m_size == other.m_size;
+}
+
+LandmarkEstimate const &LandmarkTree::get(uint32_t index) const
+{
+  Node const *node = m_root.get();
+  uint32_t leafIndex = index/LEAF_SIZE;
+  for(uint32_t level = m_depth; level > 0; level--){
+    node = node->children[(leafIndex >> (level-1)) & 1].get();
+  }
+  return node->landmarks[index%LEAF_SIZE];
+}
+
+void LandmarkTree::set(uint32_t index, LandmarkEstimate const &landmark)
+{
+  leaf(index) = landmark;
+}
+
+void LandmarkTree::push(LandmarkEstimate const &landmark)
+{
+  //A full tree gets a new root with the old tree on the left
+  if(m_root == nullptr || m_size == (LEAF_SIZE << m_depth)){
+    std::shared_ptr<Node> root = std::make_shared<Node>(m_owner);
+    if(m_root != nullptr){
+      root->children[0] = m_root;
+      m_depth++;
+    }
+    m_root = root;
+  }
+  m_size++;
+  leaf(m_size-1) = landmark;
+}
+
+LandmarkEstimate &LandmarkTree::leaf(uint32_t index)
+{
+  std::shared_ptr<Node> *node = &m_root;
+  uint32_t leafIndex = index/LEAF_SIZE;
+  for(uint32_t level = m_depth; ; level--){
+    if(*node == nullptr){
+      *node = std::make_shared<Node>(m_owner);
+    }
+    else if((*node)->owner != m_owner){
+      *node = std::make_shared<Node>(**node);
+      (*node)->owner = m_owner;
+    }
+    if(level == 0){
+      break;
+    }
+    node = &(*node)->children[(leafIndex >> (level-1)) & 1];
+  }
+  return (*node)->landmarks[index%LEAF_SIZE];
+}
@@ -0,0 +1,85 @@
+/**
+ * Copyright (C) 2018 Chalmers Revere
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+
+#ifndef LANDMARKTREE_HPP
+#define LANDMARKTREE_HPP
+
+#include <array>
+#include <cstdint>
+#include <memory>
+
+//Mean and covariance of one landmark of a particle
+struct LandmarkEstimate {
+  LandmarkEstimate();
+  LandmarkEstimate(double a_x, double a_y, double a_xx, double a_xy, double a_yy);
+  double x;
+  double y;
+  double xx;
+  double xy;
+  double yy;
+};
+
+/*
+ * Landmarks of one particle in a binary tree with blocks of landmarks in the
+ * leaves, addressed by landmark index. Copying a tree only copies the root,
+ * copies share all nodes. Every node is stamped with the tree that created
+ * it, and a tree changes only nodes with its own stamp, all others are
+ * copied on write. Changing a landmark copies at most the path from the root
+ * to its leaf and a resampled particle does not copy its map. A copy gives
+ * both trees new stamps, so whether a node is shared is decided when trees
+ * are copied, not from reference counts while other threads use them. Trees
+ * sharing nodes may be used from different threads as long as each tree is
+ * used by one thread and copies are made on one thread.
+ */
+class LandmarkTree {
+ public:
+  LandmarkTree();
+  LandmarkTree(LandmarkTree const &other);
+  LandmarkTree(LandmarkTree &&other) = default;
+  LandmarkTree &operator=(LandmarkTree const &other);
+  LandmarkTree &operator=(LandmarkTree &&other) = default;
+  uint32_t size() const;
+  LandmarkEstimate const &get(uint32_t index) const;
+  void set(uint32_t index, LandmarkEstimate const &landmark);
+  void push(LandmarkEstimate const &landmark);
+  //Same root, everything is shared
+  bool sharesAll(LandmarkTree const &other) const;
+
+  static const uint32_t LEAF_SIZE = 8;
+
+ private:
+  struct Node {
+    explicit Node(uint64_t a_owner);
+    uint64_t owner;
+    std::array<std::shared_ptr<Node>,2> children;
+    std::array<LandmarkEstimate,LEAF_SIZE> landmarks;
+  };
+
+  LandmarkEstimate &leaf(uint32_t index);
+
+  static uint64_t nextOwner();
+
+  std::shared_ptr<Node> m_root;
+  uint32_t m_depth;
+  uint32_t m_size;
+  //Stamp of the nodes this tree may change in place, renewed by copies of the tree
+  mutable uint64_t m_owner;
+};
+
+#endif
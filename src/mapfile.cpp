@@ -0,0 +1,58 @@
+/**
+ * Copyright (C) 2018 Chalmers Revere
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+
+#include <fstream>
+#include <iomanip>
+#include <vector>
+
+#include "mapfile.hpp"
+
+bool saveMap(std::string const &path, LandmarkStore const &map)
+{
+  std::ofstream file(path, std::ios::out | std::ios::trunc);
+  if(!file.is_open()){
+    return false;
+  }
+  file << std::setprecision(10);
+  for(uint32_t i = 0; i < map.size(); i++){
+    file << map.x(i) << " " << map.y(i) << " " << map.type(i) << "\n";
+  }
+  return file.good();
+}
+
+bool loadMap(std::string const &path, LandmarkStore &map, VertexIds &ids)
+{
+  std::ifstream file(path, std::ios::in);
+  if(!file.is_open()){
+    return false;
+  }
+  //Nothing is added from a file that does not parse to the end
+  std::vector<Eigen::Vector3d> landmarks;
+  Eigen::Vector3d landmark;
+  while(file >> landmark(0) >> landmark(1) >> landmark(2)){
+    landmarks.push_back(landmark);
+  }
+  if(!file.eof() || landmarks.empty()){
+    return false;
+  }
+  for(auto const &l : landmarks){
+    map.add(l(0), l(1), static_cast<int>(l(2)), ids.nextLandmark());
+  }
+  return true;
+}
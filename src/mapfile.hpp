@@ -0,0 +1,36 @@
+/**
+ * Copyright (C) 2018 Chalmers Revere
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+
+#ifndef MAPFILE_HPP
+#define MAPFILE_HPP
+
+#include <string>
+
+#include "landmarkstore.hpp"
+#include "vertexids.hpp"
+
+/*
+ * A finished map on disk, one landmark per line: x, y and type in the frame
+ * of the GPS reference it was mapped in. Ids are not stored, loaded
+ * landmarks are given new ones.
+ */
+bool saveMap(std::string const &path, LandmarkStore const &map);
+bool loadMap(std::string const &path, LandmarkStore &map, VertexIds &ids);
+
+#endif
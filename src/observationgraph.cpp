@@ -0,0 +1,131 @@
+/**
+ * Copyright (C) 2018 Chalmers Revere
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+
+#include <algorithm>
+
+#include "observationgraph.hpp"
+
+ObservationGraph::ObservationGraph():
+  m_offsets(1,0)
+, m_landmarks()
+, m_reverseValid(false)
+, m_reverseOffsets()
+, m_reversePoses()
+{
+}
+
+void ObservationGraph::addPose()
+{
+  m_offsets.push_back(m_offsets.back());
+}
+
+void ObservationGraph::addObservation(uint32_t pose, int landmark)
+{
+  if(observes(pose, landmark)){
+    return;
+  }
+  m_landmarks.insert(m_landmarks.begin()+m_offsets[pose+1], landmark);
+  for(uint32_t i = pose+1; i < m_offsets.size(); i++){
+    m_offsets[i]++;
+  }
+  m_reverseValid = false;
+}
+
+void ObservationGraph::retarget(std::map<int,int> const &mergedLandmarks)
+{
+  //Compacted in place, rows only ever shrink
+  uint32_t write = 0;
+  for(uint32_t pose = 0; pose+1 < m_offsets.size(); pose++){
+    uint32_t rowStart = write;
+    for(uint32_t read = m_offsets[pose]; read < m_offsets[pose+1]; read++){
+      auto merged = mergedLandmarks.find(m_landmarks[read]);
+      int landmark = (merged != mergedLandmarks.end())?(merged->second):(m_landmarks[read]);
+      if(std::find(m_landmarks.begin()+rowStart, m_landmarks.begin()+write, landmark) == m_landmarks.begin()+write){
+        m_landmarks[write++] = landmark;
+      }
+    }
+    m_offsets[pose] = rowStart;
+  }
+  m_offsets.back() = write;
+  m_landmarks.resize(write);
+  m_reverseValid = false;
+}
+
+uint32_t ObservationGraph::poses() const
+{
+  return static_cast<uint32_t>(m_offsets.size()-1);
+}
+
+uint32_t ObservationGraph::observations() const
+{
+  return static_cast<uint32_t>(m_landmarks.size());
+}
+
+uint32_t ObservationGraph::observationsFrom(uint32_t pose) const
+{
+  return m_offsets[pose+1]-m_offsets[pose];
+}
+
+bool ObservationGraph::observes(uint32_t pose, int landmark) const
+{
+  auto rowEnd = m_landmarks.begin()+m_offsets[pose+1];
+  return std::find(m_landmarks.begin()+m_offsets[pose], rowEnd, landmark) != rowEnd;
+}
+
+int ObservationGraph::landmarkObservedFrom(uint32_t pose, uint32_t observation) const
+{
+  return m_landmarks[m_offsets[pose]+observation];
+}
+
+uint32_t ObservationGraph::posesObserving(int landmark, std::vector<uint32_t> &poses) const
+{
+  poses.clear();
+  if(!m_reverseValid){
+    buildReverseIndex();
+  }
+  if(landmark < 0 || static_cast<uint32_t>(landmark)+1 >= m_reverseOffsets.size()){
+    return 0;
+  }
+  poses.assign(m_reversePoses.begin()+m_reverseOffsets[landmark], m_reversePoses.begin()+m_reverseOffsets[landmark+1]);
+  return static_cast<uint32_t>(poses.size());
+}
+
+void ObservationGraph::buildReverseIndex() const
+{
+  //Counting sort by landmark id, poses come out in order
+  int maxLandmark = -1;
+  for(int landmark : m_landmarks){
+    maxLandmark = std::max(maxLandmark, landmark);
+  }
+  m_reverseOffsets.assign(static_cast<uint32_t>(maxLandmark+2), 0);
+  for(int landmark : m_landmarks){
+    m_reverseOffsets[landmark+1]++;
+  }
+  for(uint32_t i = 1; i < m_reverseOffsets.size(); i++){
+    m_reverseOffsets[i] += m_reverseOffsets[i-1];
+  }
+  m_reversePoses.resize(m_landmarks.size());
+  std::vector<uint32_t> next(m_reverseOffsets.begin(), m_reverseOffsets.end()-1);
+  for(uint32_t pose = 0; pose+1 < m_offsets.size(); pose++){
+    for(uint32_t i = m_offsets[pose]; i < m_offsets[pose+1]; i++){
+      m_reversePoses[next[m_landmarks[i]]++] = pose;
+    }
+  }
+  m_reverseValid = true;
+}
@@ -0,0 +1,62 @@
+/**
+ * Copyright (C) 2018 Chalmers Revere
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+
+#ifndef OBSERVATIONGRAPH_HPP
+#define OBSERVATIONGRAPH_HPP
+
+#include <cstdint>
+#include <map>
+#include <vector>
+
+/*
+ * Which landmarks were observed from which keyframe pose, in compressed
+ * sparse row form: the landmark ids of all poses in one array and per pose
+ * the offset of its first one. Observations are appended to the latest pose,
+ * the few that belong to a recent earlier pose (confirmed cone candidates)
+ * are inserted close to the end. The reverse index, from a landmark to the
+ * poses that observed it, is built on first use after a change.
+ */
+class ObservationGraph {
+ public:
+  ObservationGraph();
+
+  void addPose();
+  //A landmark is observed at most once from a pose, a second observation is ignored
+  void addObservation(uint32_t pose, int landmark);
+  //Replaces merged landmark ids, an id observed twice from one pose is kept once
+  void retarget(std::map<int,int> const &mergedLandmarks);
+  bool observes(uint32_t pose, int landmark) const;
+
+  uint32_t poses() const;
+  uint32_t observations() const;
+  uint32_t observationsFrom(uint32_t pose) const;
+  int landmarkObservedFrom(uint32_t pose, uint32_t observation) const;
+  uint32_t posesObserving(int landmark, std::vector<uint32_t> &poses) const;
+
+ private:
+  void buildReverseIndex() const;
+
+  std::vector<uint32_t> m_offsets;
+  std::vector<int> m_landmarks;
+  mutable bool m_reverseValid;
+  mutable std::vector<uint32_t> m_reverseOffsets;
+  mutable std::vector<uint32_t> m_reversePoses;
+};
+
+#endif
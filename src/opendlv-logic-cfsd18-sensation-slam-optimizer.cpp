@@ -0,0 +1,153 @@
+/**
+ * Copyright (C) 2018 Chalmers Revere
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "cluon-complete.hpp"
+#include "g2o/core/sparse_optimizer.h"
+#include "g2o/types/slam2d/vertex_se2.h"
+#include "graphfile.hpp"
+#include "solver.hpp"
+
+/*
+ * Optimizes a pose graph saved by Slam with --graphFile offline. Every run
+ * loads the graph from the file again, so all runs start from the same
+ * estimates and a solver gives the same result each time.
+ */
+namespace {
+struct Run {
+  Run() : loadTime(0), optimizeTime(0), initialChi2(0), finalChi2(0) {}
+  double loadTime;
+  double optimizeTime;
+  double initialChi2;
+  double finalChi2;
+};
+
+bool optimizeOnce(std::string const &graph, std::string const &solver, bool blockOrdering, uint32_t threads, int iterations, bool verbose, std::string const &output, Run &run)
+{
+  g2o::SparseOptimizer optimizer;
+  auto start = std::chrono::steady_clock::now();
+  if(!loadGraph(graph, optimizer)){
+    std::cerr << "Could not load " << graph << std::endl;
+    return false;
+  }
+  run.loadTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now()-start).count();
+  g2o::OptimizationAlgorithm *algorithm = makeOptimizationAlgorithm(solver, blockOrdering, threads);
+  if(algorithm == nullptr){
+    std::cerr << "Unknown solver " << solver << ", one of" << std::endl;
+    listOptimizationAlgorithms(std::cerr);
+    return false;
+  }
+  optimizer.setAlgorithm(algorithm);
+  optimizer.setVerbose(verbose);
+
+  //A graph saved before the first optimization has nothing fixed, the first pose holds it then
+  bool anyFixed = false;
+  g2o::VertexSE2 *firstPose = nullptr;
+  for(auto const &vertex : optimizer.vertices()){
+    g2o::OptimizableGraph::Vertex *optimizable = static_cast<g2o::OptimizableGraph::Vertex*>(vertex.second);
+    anyFixed = anyFixed || optimizable->fixed();
+    g2o::VertexSE2 *pose = dynamic_cast<g2o::VertexSE2*>(vertex.second);
+    if(pose != nullptr && (firstPose == nullptr || pose->id() < firstPose->id())){
+      firstPose = pose;
+    }
+  }
+  if(!anyFixed && firstPose != nullptr){
+    firstPose->setFixed(true);
+  }
+
+  start = std::chrono::steady_clock::now();
+  optimizer.initializeOptimization();
+  optimizer.computeActiveErrors();
+  run.initialChi2 = optimizer.activeChi2();
+  optimizer.optimize(iterations);
+  run.optimizeTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now()-start).count();
+  optimizer.computeActiveErrors();
+  run.finalChi2 = optimizer.activeChi2();
+  if(!output.empty() && !saveGraph(output, optimizer)){
+    std::cerr << "Could not save " << output << std::endl;
+    return false;
+  }
+  std::cout << "vertices " << optimizer.vertices().size() << ", edges " << optimizer.edges().size() << std::endl;
+  return true;
+}
+}
+
+int32_t main(int32_t argc, char **argv)
+{
+  auto commandlineArguments = cluon::getCommandlineArguments(argc, argv);
+  if(commandlineArguments.count("list") != 0){
+    listOptimizationAlgorithms(std::cout);
+    return 0;
+  }
+  if(commandlineArguments.count("graph") == 0){
+    std::cerr << argv[0] << " optimizes a pose graph saved with --graphFile." << std::endl;
+    std::cerr << "Usage:   " << argv[0] << " --graph=<file.g2o> [--solver=slam] [--blockOrdering=0] [--threads=1] [--iterations=10] [--runs=5] [--output=<file.g2o>] [--verbose] [--list]" << std::endl;
+    return 1;
+  }
+  std::string graph = commandlineArguments["graph"];
+  std::string solver = (commandlineArguments.count("solver") != 0)?(commandlineArguments["solver"]):("slam");
+  bool blockOrdering = (commandlineArguments.count("blockOrdering") != 0)?(std::stoi(commandlineArguments["blockOrdering"]) != 0):(false);
+  uint32_t threads = (commandlineArguments.count("threads") != 0)?(static_cast<uint32_t>(std::stoi(commandlineArguments["threads"]))):(1);
+  int iterations = (commandlineArguments.count("iterations") != 0)?(std::stoi(commandlineArguments["iterations"])):(10);
+  uint32_t runs = (commandlineArguments.count("runs") != 0)?(static_cast<uint32_t>(std::stoi(commandlineArguments["runs"]))):(5);
+  std::string output = (commandlineArguments.count("output") != 0)?(commandlineArguments["output"]):("");
+  bool verbose = commandlineArguments.count("verbose") != 0;
+
+  std::vector<Run> results;
+  for(uint32_t i = 0; i < runs; i++){
+    Run run;
+    //The optimized graph is written once, from the first run
+    if(!optimizeOnce(graph, solver, blockOrdering, threads, iterations, verbose, (i == 0)?(output):(""), run)){
+      return 1;
+    }
+    results.push_back(run);
+    std::cout << "run " << i << ": load " << std::fixed << std::setprecision(3) << run.loadTime << " ms, optimize " << run.optimizeTime
+              << " ms, chi2 " << std::setprecision(6) << run.initialChi2 << " -> " << run.finalChi2 << std::endl;
+  }
+  if(results.empty()){
+    return 0;
+  }
+
+  double mean = 0;
+  double fastest = results[0].optimizeTime;
+  double slowest = results[0].optimizeTime;
+  bool reproducible = true;
+  for(auto const &run : results){
+    mean += run.optimizeTime/static_cast<double>(results.size());
+    fastest = std::min(fastest, run.optimizeTime);
+    slowest = std::max(slowest, run.optimizeTime);
+    reproducible = reproducible && std::fabs(run.finalChi2-results[0].finalChi2) <= 1e-12*std::max(1.0, std::fabs(results[0].finalChi2));
+  }
+  std::cout << solver << ((blockOrdering)?(" with"):(" without")) << " block ordering, " << threads << " threads, " << iterations << " iterations: mean " << std::setprecision(3) << mean
+            << " ms, min " << fastest << " ms, max " << slowest << " ms" << std::endl;
+  if(!reproducible){
+    std::cerr << "The runs did not end with the same chi2" << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -21,14 +21,34 @@
 #include "g2o/solvers/eigen/linear_solver_eigen.h"
 #include "slam.hpp"
 #include "cone.hpp"
+#include "coneframereader.hpp"
 #include <Eigen/Dense>
 
+#include <csignal>
 #include <cstdint>
+#include <functional>
 #include <tuple>
 #include <utility>
 #include <iostream>
+#include <memory>
 #include <string>
 #include <thread>
+#include <vector>
+namespace {
+volatile std::sig_atomic_t g_stop = 0;
+volatile std::sig_atomic_t g_saveGraph = 0;
+}
+
+//SIGUSR1 saves the pose graph, SIGINT and SIGTERM stop so that it is saved on shutdown
+extern "C" void onSignal(int signal){
+  if(signal == SIGUSR1){
+    g_saveGraph = 1;
+  }
+  else{
+    g_stop = 1;
+  }
+}
+
 typedef std::tuple<opendlv::logic::perception::ObjectDirection,opendlv::logic::perception::ObjectDistance,opendlv::logic::perception::ObjectType> ConePackage;
 
 void sendCones(std::vector<ConePackage> cones,cluon::OD4Session &od4, uint32_t const senderStamp){
@@ -52,7 +72,7 @@ int32_t main(int32_t argc, char **argv) {
   if (commandlineArguments.size()<10) {
     std::cerr << argv[0] << " is a slam implementation for the CFSD18 project." << std::endl;
     std::cerr << "Usage:   " << argv[0] << " --cid=<OpenDaVINCI session> [--id=<Identifier in case of simulated units>] [--verbose] [Module specific parameters....]" << std::endl;
-    std::cerr << "Example: " << argv[0] << "--cid=111 --id=120 --detectConeId=118 --estimationId=114 --gatheringTimeMs=10 --sameConeThreshold=1.2 --refLatitude=48.123141 --refLongitude=12.34534 --timeBetweenKeyframes=0.5 --coneMappingThreshold=50 --conesPerPacket=20" <<  std::endl;
+    std::cerr << "Example: " << argv[0] << "--cid=111 --id=120 --detectConeId=118 --estimationId=114 --gatheringTimeMs=10 --sameConeThreshold=1.2 --refLatitude=48.123141 --refLongitude=12.34534 --coneMappingThreshold=50 --conesPerPacket=20 [--keyframeDistance=5] [--keyframeHeading=20] [--timeBetweenKeyframes=2] [--poseRate=50] [--replay] [--coneFrameSharedMemory=<name>] [--legacyConeOutput=1] [--batchReceive=1] [--coneConfirmations=3] [--coneCandidateKeyframes=5] [--mergeThreshold=0.5] [--mapUpdateEpsilon=0.01] [--placeRadius=6] [--loopMinKeyframes=30] [--loopStartKeyframes=20] [--loopMinInliers=4] [--loopMaxCorrection=5] [--mapFile=<path>] [--relocalizationKeyframes=30] [--relocalizationMinInliers=15] [--relocalizationCandidates=5] [--trackingLossKeyframes=5] [--backend=graph|ekf|fastslam] [--odometryNoise=0.1] [--headingNoise=0.05] [--measurementNoise=0.3] [--particles=50] [--particleThreads=<cores>] [--resampleThreshold=0.5] [--graphFile=<path>] [--lidarOffset=1.5] [--rangeNoise=0.1] [--bearingNoise=0.5] [--optimizerThreads=1]" <<  std::endl;
     retCode = 1;
   } else {
     //uint32_t const ID{(commandlineArguments["id"].size() != 0) ? static_cast<uint32_t>(std::stoi(commandlineArguments["id"])) : 0};
@@ -62,58 +82,89 @@ int32_t main(int32_t argc, char **argv) {
     // Interface to a running OpenDaVINCI session (ignoring any incoming Envelopes).
     cluon::data::Envelope data;
     //std::shared_ptr<Slam> slammer = std::shared_ptr<Slam>(new Slam(10));
-    cluon::OD4Session od4{static_cast<uint16_t>(std::stoi(commandlineArguments["cid"]))};
+    bool const batchReceive = (commandlineArguments.count("batchReceive") != 0)?(std::stoi(commandlineArguments["batchReceive"]) != 0):(false);
+    cluon::OD4Session od4{static_cast<uint16_t>(std::stoi(commandlineArguments["cid"])),nullptr,batchReceive};
     Slam slam(commandlineArguments,od4);
     uint32_t detectconeStamp = static_cast<uint32_t>(std::stoi(commandlineArguments["detectConeId"]));
     uint32_t estimationStamp = static_cast<uint32_t>(std::stoi(commandlineArguments["estimationId"]));
 
 
-    auto poseEnvelope{[&slammer = slam,senderStamp = estimationStamp](cluon::data::Envelope &&envelope)
+    auto poseEnvelope{[&slammer = slam](cluon::data::Envelope &&envelope)
       {
-        if(envelope.senderStamp() == senderStamp){
-          slammer.nextPose(envelope);
-        }
+        slammer.nextPose(envelope);
       } 
     };
 
-    auto coneEnvelope{[&slammer = slam, senderStamp = detectconeStamp](cluon::data::Envelope &&envelope)
+    auto coneEnvelope{[&slammer = slam](cluon::data::Envelope &&envelope)
       {
-        if(envelope.senderStamp() == senderStamp){
-          slammer.nextCone(envelope);
-        }
+        slammer.nextCone(envelope);
       }
     };
 
-    auto splitPoseEnvelope{[&slammer = slam, senderStamp = estimationStamp](cluon::data::Envelope &&envelope)
+    auto coneFrameEnvelope{[&slammer = slam](cluon::data::Envelope &&envelope)
       {
-        if(envelope.senderStamp() == senderStamp){
-          slammer.nextSplitPose(envelope);
-        }
+        slammer.nextConeFrame(envelope);
       }
     };
 
-    auto yawRateEnvelope{[&slammer = slam, senderStamp = estimationStamp](cluon::data::Envelope &&envelope)
+    auto splitPoseEnvelope{[&slammer = slam](cluon::data::Envelope &&envelope)
       {
-        if(envelope.senderStamp() == senderStamp){
-          slammer.nextYawRate(envelope);
-        }
+        slammer.nextSplitPose(envelope);
       }
     };
-    od4.dataTrigger(opendlv::proxy::GeodeticWgs84Reading::ID(),splitPoseEnvelope);
-    od4.dataTrigger(opendlv::proxy::GeodeticHeadingReading::ID(),splitPoseEnvelope);
-    od4.dataTrigger(opendlv::logic::sensation::Geolocation::ID(),poseEnvelope);
-    od4.dataTrigger(opendlv::proxy::AngularVelocityReading::ID(),yawRateEnvelope);
-    od4.dataTrigger(opendlv::logic::perception::ObjectDirection::ID(),coneEnvelope);
-    od4.dataTrigger(opendlv::logic::perception::ObjectDistance::ID(),coneEnvelope);
-    od4.dataTrigger(opendlv::logic::perception::ObjectType::ID(),coneEnvelope);
-    
+
+    auto yawRateEnvelope{[&slammer = slam](cluon::data::Envelope &&envelope)
+      {
+        slammer.nextYawRate(envelope);
+      }
+    };
+    //Envelopes from other senders are dropped by od4 before a trigger is called
+    std::vector<std::tuple<int32_t,uint32_t,std::function<void(cluon::data::Envelope &&)>>> const triggers = {
+      std::make_tuple(opendlv::proxy::GeodeticWgs84Reading::ID(),estimationStamp,splitPoseEnvelope),
+      std::make_tuple(opendlv::proxy::GeodeticHeadingReading::ID(),estimationStamp,splitPoseEnvelope),
+      std::make_tuple(opendlv::logic::sensation::Geolocation::ID(),estimationStamp,poseEnvelope),
+      std::make_tuple(opendlv::proxy::AngularVelocityReading::ID(),estimationStamp,yawRateEnvelope),
+      std::make_tuple(opendlv::logic::perception::ObjectDirection::ID(),detectconeStamp,coneEnvelope),
+      std::make_tuple(opendlv::logic::perception::ObjectDistance::ID(),detectconeStamp,coneEnvelope),
+      std::make_tuple(opendlv::logic::perception::ObjectType::ID(),detectconeStamp,coneEnvelope),
+      std::make_tuple(opendlv::logic::perception::ConeFrame::ID(),detectconeStamp,coneFrameEnvelope)};
+    for(auto const &trigger : triggers){
+      od4.dataTrigger(std::get<0>(trigger),std::get<1>(trigger),std::get<2>(trigger));
+    }
+
+    // Complete cone frames from a perception process on the same computer.
+    std::unique_ptr<ConeFrameReader> coneFrameReader;
+    if(commandlineArguments.count("coneFrameSharedMemory") != 0){
+      coneFrameReader = std::unique_ptr<ConeFrameReader>(new ConeFrameReader(commandlineArguments["coneFrameSharedMemory"],
+        [&slammer = slam](Eigen::Ref<Eigen::MatrixXd const> const &cones, cluon::data::TimeStamp const &sampleTime){
+          slammer.nextConeFrame(cones,sampleTime);
+        }));
+    }
+
 
     // Just sleep as this microservice is data driven.
+    if(commandlineArguments.count("graphFile") != 0){
+      std::signal(SIGUSR1,onSignal);
+      std::signal(SIGINT,onSignal);
+      std::signal(SIGTERM,onSignal);
+    }
     using namespace std::literals::chrono_literals;
-    while (od4.isRunning()) {
+    while (od4.isRunning() && g_stop == 0) {
       std::this_thread::sleep_for(1s);
       std::chrono::system_clock::time_point tp;
+      if(g_saveGraph != 0){
+        g_saveGraph = 0;
+        slam.saveGraph();
+      }
+    }
+    //Stop everything that calls into slam before it is destroyed. od4 outlives slam,
+    //and removing a trigger waits for a delegate that is running.
+    coneFrameReader.reset();
+    for(auto const &trigger : triggers){
+      od4.dataTrigger(std::get<0>(trigger),nullptr);
     }
+    //A replay ends with the frame it was gathering
+    slam.flush();
   }
   return retCode;
 }
@@ -0,0 +1,452 @@
+/**
+ * Copyright (C) 2018 Chalmers Revere
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "placerecognizer.hpp"
+#include "vertexids.hpp"
+
+namespace {
+//Least squares rigid transform between point pairs, to = R(heading)*from + t
+class Alignment {
+ public:
+  Alignment() : m_n(0), m_fromX(0), m_fromY(0), m_toX(0), m_toY(0), m_xx(0), m_yy(0), m_xy(0), m_yx(0) {}
+
+  void add(double fromX, double fromY, double toX, double toY)
+  {
+    m_n++;
+    m_fromX += fromX;
+    m_fromY += fromY;
+    m_toX += toX;
+    m_toY += toY;
+    m_xx += fromX*toX;
+    m_yy += fromY*toY;
+    m_xy += fromX*toY;
+    m_yx += fromY*toX;
+  }
+
+  //x, y and heading of the transform
+  Eigen::Vector3d solve() const
+  {
+    double fromX = m_fromX/m_n;
+    double fromY = m_fromY/m_n;
+    double toX = m_toX/m_n;
+    double toY = m_toY/m_n;
+    double xx = m_xx-m_n*fromX*toX;
+    double yy = m_yy-m_n*fromY*toY;
+    double xy = m_xy-m_n*fromX*toY;
+    double yx = m_yx-m_n*fromY*toX;
+    double heading = std::atan2(xy-yx, xx+yy);
+    double x = toX-(std::cos(heading)*fromX-std::sin(heading)*fromY);
+    double y = toY-(std::sin(heading)*fromX+std::cos(heading)*fromY);
+    return Eigen::Vector3d(x, y, heading);
+  }
+
+ private:
+  double m_n;
+  double m_fromX;
+  double m_fromY;
+  double m_toX;
+  double m_toY;
+  double m_xx;
+  double m_yy;
+  double m_xy;
+  double m_yx;
+};
+
+//Corners reordered by the length of the opposite side, shortest first
+void canonicalOrder(std::array<double,6> &corners, std::array<int,3> &types, std::array<double,3> &sides)
+{
+  for(uint32_t i = 0; i < 3; i++){
+    uint32_t a = (i+1)%3;
+    uint32_t b = (i+2)%3;
+    sides[i] = std::sqrt((corners[2*a]-corners[2*b])*(corners[2*a]-corners[2*b])+(corners[2*a+1]-corners[2*b+1])*(corners[2*a+1]-corners[2*b+1]));
+  }
+  for(uint32_t i = 0; i < 2; i++){
+    for(uint32_t j = 0; j < 2-i; j++){
+      if(sides[j] > sides[j+1]){
+        std::swap(sides[j], sides[j+1]);
+        std::swap(types[j], types[j+1]);
+        std::swap(corners[2*j], corners[2*j+2]);
+        std::swap(corners[2*j+1], corners[2*j+3]);
+      }
+    }
+  }
+}
+
+uint64_t triangleKey(std::array<int64_t,3> const &quantizedSides, std::array<int,3> const &types)
+{
+  uint64_t key = 0;
+  for(uint32_t i = 0; i < 3; i++){
+    key = key*256+static_cast<uint64_t>(std::min<int64_t>(std::max<int64_t>(quantizedSides[i], 0), 255));
+  }
+  for(uint32_t i = 0; i < 3; i++){
+    key = key*8+static_cast<uint64_t>(LandmarkStore::coneClass(types[i]));
+  }
+  return key;
+}
+}
+
+LoopClosure::LoopClosure():
+  correction(Eigen::Vector3d::Zero())
+, inliers(0)
+, reachesStart(false)
+, matches()
+{
+}
+
+PlaceRecognizer::PlaceRecognizer(std::map<std::string, std::string> commandlineArguments):
+  m_neighbourRadius(6.0)
+, m_sideResolution(0.5)
+, m_minLoopKeyframes(30)
+, m_startKeyframes(20)
+, m_minVotes(3)
+, m_minInliers(4)
+, m_maxCorrection(5.0)
+, m_maxRotation(0.5)
+, m_inlierDistance(1.0)
+, m_triangles()
+, m_buckets()
+, m_landmarkKeyframes()
+, m_neighbours()
+, m_candidates()
+, m_changed()
+, m_isChanged()
+, m_version(0)
+, m_votes()
+{
+  setUp(commandlineArguments);
+  rehash(1024);
+}
+
+void PlaceRecognizer::setUp(std::map<std::string, std::string> configuration)
+{
+  m_neighbourRadius = (configuration.count("placeRadius") != 0)?(static_cast<double>(std::stod(configuration["placeRadius"]))):(6.0);
+  m_minLoopKeyframes = (configuration.count("loopMinKeyframes") != 0)?(static_cast<uint32_t>(std::stoi(configuration["loopMinKeyframes"]))):(30);
+  m_startKeyframes = (configuration.count("loopStartKeyframes") != 0)?(static_cast<uint32_t>(std::stoi(configuration["loopStartKeyframes"]))):(20);
+  m_minInliers = (configuration.count("loopMinInliers") != 0)?(static_cast<uint32_t>(std::stoi(configuration["loopMinInliers"]))):(4);
+  m_maxCorrection = (configuration.count("loopMaxCorrection") != 0)?(static_cast<double>(std::stod(configuration["loopMaxCorrection"]))):(5.0);
+  m_inlierDistance = (configuration.count("sameConeThreshold") != 0)?(static_cast<double>(std::stod(configuration["sameConeThreshold"]))):(1.0);
+}
+
+void PlaceRecognizer::addLandmark(LandmarkStore const &map, uint32_t index, uint32_t keyframe)
+{
+  uint32_t landmark = VertexIds::index(map.id(index));
+  if(landmark >= m_landmarkKeyframes.size()){
+    m_landmarkKeyframes.resize(landmark+1, 0);
+  }
+  m_landmarkKeyframes[landmark] = keyframe;
+
+  //Every triangle is added once, together with its last corner
+  map.withinRadius(map.x(index), map.y(index), m_neighbourRadius, -1, m_neighbours);
+  for(uint32_t a = 0; a < m_neighbours.size(); a++){
+    for(uint32_t b = a+1; b < m_neighbours.size(); b++){
+      uint32_t i = m_neighbours[a];
+      uint32_t j = m_neighbours[b];
+      double distance = std::sqrt((map.x(i)-map.x(j))*(map.x(i)-map.x(j))+(map.y(i)-map.y(j))*(map.y(i)-map.y(j)));
+      if(i == index || j == index || distance >= m_neighbourRadius){
+        continue;
+      }
+      addTriangle(map, index, i, j, keyframe);
+    }
+  }
+  //Nothing else changed since the last update, the triangles of this landmark were all that was missing
+  if(m_version+1 == map.version()){
+    m_version = map.version();
+  }
+}
+
+void PlaceRecognizer::rebuild(LandmarkStore const &map)
+{
+  m_triangles.clear();
+  std::fill(m_buckets.begin(), m_buckets.end(), -1);
+  for(uint32_t index = 0; index < map.size(); index++){
+    map.withinRadius(map.x(index), map.y(index), m_neighbourRadius, -1, m_neighbours);
+    for(uint32_t a = 0; a < m_neighbours.size(); a++){
+      for(uint32_t b = a+1; b < m_neighbours.size(); b++){
+        uint32_t i = m_neighbours[a];
+        uint32_t j = m_neighbours[b];
+        double distance = std::sqrt((map.x(i)-map.x(j))*(map.x(i)-map.x(j))+(map.y(i)-map.y(j))*(map.y(i)-map.y(j)));
+        if(i <= index || j <= index || distance >= m_neighbourRadius){
+          continue;
+        }
+        uint32_t keyframe = std::max(keyframeOf(map.id(index)), std::max(keyframeOf(map.id(i)), keyframeOf(map.id(j))));
+        addTriangle(map, index, i, j, keyframe);
+      }
+    }
+  }
+  m_version = map.version();
+}
+
+void PlaceRecognizer::update(LandmarkStore const &map)
+{
+  if(map.changedSince(m_version, m_changed) == 0){
+    return;
+  }
+  if(m_changed.size() == map.size()){
+    //Compacting renumbers every landmark
+    rebuild(map);
+    return;
+  }
+  m_isChanged.assign(map.size(), false);
+  for(uint32_t index : m_changed){
+    m_isChanged[index] = true;
+  }
+
+  //Triangles with a changed corner are dropped and built again from their first changed corner
+  uint32_t kept = 0;
+  for(uint32_t t = 0; t < m_triangles.size(); t++){
+    std::array<uint32_t,3> const &landmarks = m_triangles[t].landmarks;
+    if(!m_isChanged[landmarks[0]] && !m_isChanged[landmarks[1]] && !m_isChanged[landmarks[2]]){
+      m_triangles[kept++] = m_triangles[t];
+    }
+  }
+  m_triangles.resize(kept);
+  rehash(static_cast<uint32_t>(m_buckets.size()));
+  for(uint32_t index : m_changed){
+    map.withinRadius(map.x(index), map.y(index), m_neighbourRadius, -1, m_neighbours);
+    for(uint32_t a = 0; a < m_neighbours.size(); a++){
+      for(uint32_t b = a+1; b < m_neighbours.size(); b++){
+        uint32_t i = m_neighbours[a];
+        uint32_t j = m_neighbours[b];
+        if(i == index || j == index || (m_isChanged[i] && i < index) || (m_isChanged[j] && j < index)){
+          continue;
+        }
+        double distance = std::sqrt((map.x(i)-map.x(j))*(map.x(i)-map.x(j))+(map.y(i)-map.y(j))*(map.y(i)-map.y(j)));
+        if(distance >= m_neighbourRadius){
+          continue;
+        }
+        uint32_t keyframe = std::max(keyframeOf(map.id(index)), std::max(keyframeOf(map.id(i)), keyframeOf(map.id(j))));
+        addTriangle(map, index, i, j, keyframe);
+      }
+    }
+  }
+  m_version = map.version();
+}
+
+bool PlaceRecognizer::recognize(LandmarkStore const &map, Eigen::Ref<Eigen::MatrixXd const> const &observed, Eigen::Vector3d const &pose, uint32_t keyframe, LoopClosure &closure)
+{
+  closure.matches.clear();
+  closure.inliers = 0;
+  closure.reachesStart = false;
+  if(keyframe < m_minLoopKeyframes || observed.cols() < 3){
+    return false;
+  }
+  vote(observed, pose, keyframe, true);
+
+  Vote const *best = nullptr;
+  for(Vote const &vote : m_votes){
+    if(vote.count >= m_minVotes && (best == nullptr || vote.count > best->count)){
+      best = &vote;
+    }
+  }
+  if(best == nullptr){
+    return false;
+  }
+  return verify(map, observed, best->transform, keyframe, closure);
+}
+
+uint32_t PlaceRecognizer::relocalize(LandmarkStore const &map, Eigen::Ref<Eigen::MatrixXd const> const &observed, uint32_t maxCandidates, std::vector<LoopClosure> &candidates)
+{
+  candidates.clear();
+  if(observed.cols() < 3){
+    return 0;
+  }
+  //The observed cones are in the car frame, the transform onto the map is the pose of the car
+  const uint32_t anyKeyframe = std::numeric_limits<uint32_t>::max();
+  vote(observed, Eigen::Vector3d::Zero(), anyKeyframe, false);
+
+  //The strongest bins are verified, each one at most once
+  for(uint32_t k = 0; k < maxCandidates; k++){
+    Vote *best = nullptr;
+    for(Vote &vote : m_votes){
+      if(vote.count >= m_minVotes && (best == nullptr || vote.count > best->count)){
+        best = &vote;
+      }
+    }
+    if(best == nullptr){
+      break;
+    }
+    //Verified again from the refined transform, a vote only gets the car roughly in place
+    LoopClosure candidate;
+    if(verify(map, observed, best->transform, anyKeyframe, candidate) && verify(map, observed, Eigen::Vector3d(candidate.correction), anyKeyframe, candidate)){
+      candidates.push_back(candidate);
+    }
+    best->count = 0;
+  }
+  std::stable_sort(candidates.begin(), candidates.end(), [](LoopClosure const &a, LoopClosure const &b){return a.inliers > b.inliers;});
+  return static_cast<uint32_t>(candidates.size());
+}
+
+void PlaceRecognizer::vote(Eigen::Ref<Eigen::MatrixXd const> const &observed, Eigen::Vector3d const &pose, uint32_t keyframe, bool bounded)
+{
+  for(Vote &vote : m_votes){
+    vote.count = 0;
+  }
+  //Every observed triangle looks up the bins of its sides and the closest neighbouring bins
+  const uint32_t n = static_cast<uint32_t>(observed.cols());
+  const double squaredRadius = m_neighbourRadius*m_neighbourRadius;
+  for(uint32_t a = 0; a < n; a++){
+    for(uint32_t b = a+1; b < n; b++){
+      if((observed.block<2,1>(0,a)-observed.block<2,1>(0,b)).squaredNorm() >= squaredRadius){
+        continue;
+      }
+      for(uint32_t c = b+1; c < n; c++){
+        if((observed.block<2,1>(0,a)-observed.block<2,1>(0,c)).squaredNorm() >= squaredRadius || (observed.block<2,1>(0,b)-observed.block<2,1>(0,c)).squaredNorm() >= squaredRadius){
+          continue;
+        }
+        std::array<double,6> corners = {{observed(0,a), observed(1,a), observed(0,b), observed(1,b), observed(0,c), observed(1,c)}};
+        std::array<int,3> types = {{static_cast<int>(observed(2,a)), static_cast<int>(observed(2,b)), static_cast<int>(observed(2,c))}};
+        std::array<double,3> sides;
+        canonicalOrder(corners, types, sides);
+        for(uint32_t variant = 0; variant < 8; variant++){
+          std::array<int64_t,3> quantizedSides;
+          for(uint32_t i = 0; i < 3; i++){
+            double scaled = sides[i]/m_sideResolution;
+            int64_t closestOther = (scaled-std::floor(scaled) < 0.5)?(-1):(1);
+            quantizedSides[i] = static_cast<int64_t>(std::floor(scaled))+(((variant >> i) & 1)?(closestOther):(0));
+          }
+          uint64_t key = triangleKey(quantizedSides, types);
+          for(int32_t t = m_buckets[bucket(key)]; t >= 0; t = m_triangles[t].next){
+            Triangle const &triangle = m_triangles[t];
+            if(triangle.key != key || triangle.keyframe+m_minLoopKeyframes > keyframe){
+              continue;
+            }
+            Alignment alignment;
+            for(uint32_t i = 0; i < 3; i++){
+              alignment.add(corners[2*i], corners[2*i+1], triangle.corners[2*i], triangle.corners[2*i+1]);
+            }
+            Eigen::Vector3d transform = alignment.solve();
+            //Vote for where the transform moves the car, with drift the correction is bounded
+            double dx = std::cos(transform(2))*pose(0)-std::sin(transform(2))*pose(1)+transform(0)-pose(0);
+            double dy = std::sin(transform(2))*pose(0)+std::cos(transform(2))*pose(1)+transform(1)-pose(1);
+            if(bounded && (dx*dx+dy*dy > m_maxCorrection*m_maxCorrection || std::fabs(transform(2)) > m_maxRotation)){
+              continue;
+            }
+            int64_t bin = ((static_cast<int64_t>(std::lround(dx))+1024)*2048+(static_cast<int64_t>(std::lround(dy))+1024))*2048+(static_cast<int64_t>(std::lround(transform(2)/0.1))+1024);
+            for(uint32_t probe = 0; probe < m_votes.size(); probe++){
+              Vote &vote = m_votes[(static_cast<uint64_t>(bin)*2654435761u+probe)%m_votes.size()];
+              if(vote.count == 0){
+                vote.bin = bin;
+                vote.transform = transform;
+              }
+              if(vote.bin == bin){
+                vote.count++;
+                break;
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+bool PlaceRecognizer::verify(LandmarkStore const &map, Eigen::Ref<Eigen::MatrixXd const> const &observed, Eigen::Vector3d const &transform, uint32_t keyframe, LoopClosure &closure)
+{
+  closure.matches.clear();
+  closure.reachesStart = false;
+  //Verification, each observed cone is matched to the closest old landmark of its class
+  double cosHeading = std::cos(transform(2));
+  double sinHeading = std::sin(transform(2));
+  Alignment alignment;
+  const uint32_t n = static_cast<uint32_t>(observed.cols());
+  for(uint32_t i = 0; i < n; i++){
+    double x = cosHeading*observed(0,i)-sinHeading*observed(1,i)+transform(0);
+    double y = sinHeading*observed(0,i)+cosHeading*observed(1,i)+transform(1);
+    map.withinRadius(x, y, m_inlierDistance, static_cast<int>(observed(2,i)), m_candidates);
+    int32_t match = -1;
+    double minDistance = m_inlierDistance*m_inlierDistance;
+    for(uint32_t j : m_candidates){
+      double distance = (map.x(j)-x)*(map.x(j)-x)+(map.y(j)-y)*(map.y(j)-y);
+      if(distance < minDistance && isOld(map.id(j), keyframe)){
+        match = static_cast<int32_t>(j);
+        minDistance = distance;
+      }
+    }
+    if(match >= 0){
+      closure.matches.push_back(std::make_pair(i, static_cast<uint32_t>(match)));
+      alignment.add(observed(0,i), observed(1,i), map.x(match), map.y(match));
+      closure.reachesStart = closure.reachesStart || keyframeOf(map.id(match)) < m_startKeyframes;
+    }
+  }
+  closure.inliers = static_cast<uint32_t>(closure.matches.size());
+  if(closure.inliers < m_minInliers){
+    return false;
+  }
+  closure.correction = alignment.solve();
+  return true;
+}
+
+uint32_t PlaceRecognizer::triangles() const
+{
+  return static_cast<uint32_t>(m_triangles.size());
+}
+
+void PlaceRecognizer::addTriangle(LandmarkStore const &map, uint32_t first, uint32_t second, uint32_t third, uint32_t keyframe)
+{
+  Triangle triangle;
+  triangle.corners = {{map.x(first), map.y(first), map.x(second), map.y(second), map.x(third), map.y(third)}};
+  triangle.landmarks = {{first, second, third}};
+  std::array<int,3> orderedTypes = {{map.type(first), map.type(second), map.type(third)}};
+  std::array<double,3> sides;
+  canonicalOrder(triangle.corners, orderedTypes, sides);
+  std::array<int64_t,3> quantizedSides;
+  for(uint32_t i = 0; i < 3; i++){
+    quantizedSides[i] = static_cast<int64_t>(std::floor(sides[i]/m_sideResolution));
+  }
+  triangle.key = triangleKey(quantizedSides, orderedTypes);
+  triangle.keyframe = keyframe;
+  if(m_triangles.size() >= m_buckets.size()){
+    rehash(static_cast<uint32_t>(2*m_buckets.size()));
+  }
+  uint32_t b = bucket(triangle.key);
+  triangle.next = m_buckets[b];
+  m_buckets[b] = static_cast<int32_t>(m_triangles.size());
+  m_triangles.push_back(triangle);
+}
+
+void PlaceRecognizer::rehash(uint32_t buckets)
+{
+  m_buckets.assign(buckets, -1);
+  for(uint32_t t = 0; t < m_triangles.size(); t++){
+    uint32_t b = bucket(m_triangles[t].key);
+    m_triangles[t].next = m_buckets[b];
+    m_buckets[b] = static_cast<int32_t>(t);
+  }
+}
+
+uint32_t PlaceRecognizer::bucket(uint64_t key) const
+{
+  return static_cast<uint32_t>((key*11400714819323198485ull) >> 32) & static_cast<uint32_t>(m_buckets.size()-1);
+}
+
+bool PlaceRecognizer::isOld(int landmarkId, uint32_t keyframe) const
+{
+  return keyframeOf(landmarkId) <= keyframe-std::min(keyframe, m_minLoopKeyframes);
+}
+
+uint32_t PlaceRecognizer::keyframeOf(int landmarkId) const
+{
+  //Landmarks of a loaded map were never added and count as the oldest
+  uint32_t landmark = VertexIds::index(landmarkId);
+  return (landmark < m_landmarkKeyframes.size())?(m_landmarkKeyframes[landmark]):(0);
+}
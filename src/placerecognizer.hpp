@@ -0,0 +1,112 @@
+/**
+ * Copyright (C) 2018 Chalmers Revere
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+
+#ifndef PLACERECOGNIZER_HPP
+#define PLACERECOGNIZER_HPP
+
+#include <array>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+#include <Eigen/Dense>
+
+#include "landmarkstore.hpp"
+
+//A verified revisit: correction maps the observed cones onto the map
+struct LoopClosure {
+  LoopClosure();
+  Eigen::Vector3d correction;
+  uint32_t inliers;
+  bool reachesStart;
+  //Column of the observed cone and index of the landmark in the map
+  std::vector<std::pair<uint32_t,uint32_t>> matches;
+};
+
+/*
+ * Loop closure detection from cone constellations. Every landmark forms
+ * triangles with the landmarks around it; a triangle is hashed by its side
+ * lengths, sorted and quantized, and the classes of the opposite corners.
+ * Triangles among the cones of a keyframe are looked up in constant time,
+ * each hit on an old part of the map votes for the rigid transform that
+ * aligns the two. The best transform is then verified against all observed
+ * cones and accepted with enough inliers. Only amortized growth allocates.
+ */
+class PlaceRecognizer {
+ public:
+  PlaceRecognizer(std::map<std::string, std::string> commandlineArguments);
+
+  void addLandmark(LandmarkStore const &map, uint32_t index, uint32_t keyframe);
+  //All triangles built again from the map
+  void rebuild(LandmarkStore const &map);
+  //After optimization or merging, only the triangles of landmarks changed since the last update are built again
+  void update(LandmarkStore const &map);
+  //observed holds global x, y and type of the cones of the keyframe taken at pose
+  bool recognize(LandmarkStore const &map, Eigen::Ref<Eigen::MatrixXd const> const &observed, Eigen::Vector3d const &pose, uint32_t keyframe, LoopClosure &closure);
+  //Candidate poses of the car for cones observed in its own frame, ranked by inliers
+  uint32_t relocalize(LandmarkStore const &map, Eigen::Ref<Eigen::MatrixXd const> const &observed, uint32_t maxCandidates, std::vector<LoopClosure> &candidates);
+  uint32_t triangles() const;
+
+ private:
+  struct Triangle {
+    Triangle() : key(0), keyframe(0), next(-1), corners(), landmarks() {}
+    uint64_t key;
+    uint32_t keyframe;
+    int32_t next;
+    std::array<double,6> corners;
+    std::array<uint32_t,3> landmarks;
+  };
+  struct Vote {
+    Vote() : bin(0), count(0), transform(Eigen::Vector3d::Zero()) {}
+    int64_t bin;
+    uint32_t count;
+    Eigen::Vector3d transform;
+  };
+
+  void setUp(std::map<std::string, std::string> configuration);
+  void addTriangle(LandmarkStore const &map, uint32_t first, uint32_t second, uint32_t third, uint32_t keyframe);
+  void vote(Eigen::Ref<Eigen::MatrixXd const> const &observed, Eigen::Vector3d const &pose, uint32_t keyframe, bool bounded);
+  bool verify(LandmarkStore const &map, Eigen::Ref<Eigen::MatrixXd const> const &observed, Eigen::Vector3d const &transform, uint32_t keyframe, LoopClosure &closure);
+  void rehash(uint32_t buckets);
+  uint32_t bucket(uint64_t key) const;
+  bool isOld(int landmarkId, uint32_t keyframe) const;
+  uint32_t keyframeOf(int landmarkId) const;
+
+  double m_neighbourRadius;
+  double m_sideResolution;
+  uint32_t m_minLoopKeyframes;
+  uint32_t m_startKeyframes;
+  uint32_t m_minVotes;
+  uint32_t m_minInliers;
+  double m_maxCorrection;
+  double m_maxRotation;
+  double m_inlierDistance;
+  std::vector<Triangle> m_triangles;
+  std::vector<int32_t> m_buckets;
+  std::vector<uint32_t> m_landmarkKeyframes;
+  std::vector<uint32_t> m_neighbours;
+  std::vector<uint32_t> m_candidates;
+  std::vector<uint32_t> m_changed;
+  std::vector<bool> m_isChanged;
+  uint64_t m_version;
+  std::array<Vote,512> m_votes;
+};
+
+#endif
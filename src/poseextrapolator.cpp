@@ -0,0 +1,239 @@
+/**
+* Copyright (C) 2018 Chalmers Revere
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+* USA.
+*/
+
+#include <cmath>
+#include <iostream>
+
+#include "poseextrapolator.hpp"
+#include "WGS84toCartesian.hpp"
+
+PoseExtrapolator::PoseExtrapolator(std::map<std::string, std::string> commandlineArguments, cluon::OD4Session &a_od4, Clock &a_clock) :
+  od4(a_od4)
+, m_clock(a_clock)
+, m_stateMutex()
+, m_publisher()
+, m_running()
+, m_gpsReference()
+, m_correction()
+, m_lastOdometry()
+, m_previousOdometry()
+, m_lastOdometryTime()
+, m_previousOdometryTime()
+, m_yawRateTime()
+, m_sentPoses(0)
+{
+  setUp(commandlineArguments);
+  m_correction << 0,0,0;
+  m_lastOdometry << 0,0,0;
+  m_previousOdometry << 0,0,0;
+  m_running = m_frequency > 0 && !m_clock.isReplay();
+  if(m_running){
+    m_publisher = std::thread(&PoseExtrapolator::run,this);
+  }
+  else if(m_frequency > 0){
+    m_clock.setListener([this](cluon::data::TimeStamp const &time){publishUntil(time);});
+  }
+}
+
+PoseExtrapolator::~PoseExtrapolator()
+{
+  if(m_clock.isReplay()){
+    m_clock.setListener(nullptr);
+  }
+  m_running = false;
+  if(m_publisher.joinable()){
+    m_publisher.join();
+  }
+}
+
+void PoseExtrapolator::setUp(std::map<std::string, std::string> configuration)
+{
+  m_frequency = (configuration.count("poseRate") != 0)?(static_cast<double>(std::stod(configuration["poseRate"]))):(0.0);
+  m_maxExtrapolationTime = (configuration.count("maxPoseExtrapolationMs") != 0)?(static_cast<double>(std::stod(configuration["maxPoseExtrapolationMs"]))/1000):(0.2);
+  m_gpsReference[0] = static_cast<double>(std::stod(configuration["refLatitude"]));
+  m_gpsReference[1] = static_cast<double>(std::stod(configuration["refLongitude"]));
+  m_senderStamp = static_cast<int>(std::stoi(configuration["id"]));
+  if(m_frequency > 0){
+    std::cout << "Sending the pose at " << m_frequency << " Hz" << std::endl;
+  }
+}
+
+void PoseExtrapolator::nextOdometry(Eigen::Vector3d const &pose, cluon::data::TimeStamp const &sampleTime)
+{
+  std::lock_guard<std::mutex> lockState(m_stateMutex);
+  //Samples that do not move forward in time are dropped, the pose and its time belong together
+  if(m_odometrySamples > 0 && cluon::time::deltaInMicroseconds(sampleTime,m_lastOdometryTime) <= 0){
+    return;
+  }
+  m_previousOdometry = m_lastOdometry;
+  m_previousOdometryTime = m_lastOdometryTime;
+  m_lastOdometry = pose;
+  m_lastOdometryTime = sampleTime;
+  m_odometrySamples = (m_odometrySamples < 2)?(m_odometrySamples+1):(m_odometrySamples);
+}
+
+void PoseExtrapolator::nextYawRate(double yawRate, cluon::data::TimeStamp const &sampleTime)
+{
+  std::lock_guard<std::mutex> lockState(m_stateMutex);
+  if(m_hasYawRate && cluon::time::deltaInMicroseconds(sampleTime,m_yawRateTime) <= 0){
+    return;
+  }
+  m_yawRate = yawRate;
+  m_yawRateTime = sampleTime;
+  m_hasYawRate = true;
+}
+
+void PoseExtrapolator::nextCorrection(Eigen::Vector3d const &odometryPose, Eigen::Vector3d const &correctedPose)
+{
+  //Offset that takes an odometry pose into the SLAM corrected frame
+  Eigen::Vector3d correction = compose(correctedPose, inverse(odometryPose));
+  std::lock_guard<std::mutex> lockState(m_stateMutex);
+  m_correction = correction;
+}
+
+Eigen::Vector3d PoseExtrapolator::extrapolate(cluon::data::TimeStamp const &time)
+{
+  std::lock_guard<std::mutex> lockState(m_stateMutex);
+  Eigen::Vector3d pose = compose(m_correction, m_lastOdometry);
+  if(m_odometrySamples < 2){
+    return pose;
+  }
+
+  double sampleTime = static_cast<double>(cluon::time::deltaInMicroseconds(m_lastOdometryTime, m_previousOdometryTime))/1000000;
+  double latency = static_cast<double>(cluon::time::deltaInMicroseconds(time, m_lastOdometryTime))/1000000;
+  latency = (latency > m_maxExtrapolationTime)?(m_maxExtrapolationTime):(latency);
+  if(sampleTime <= 0 || latency <= 0){
+    return pose;
+  }
+
+  //Velocity in the car frame from the two latest odometry samples
+  double heading = m_lastOdometry(2);
+  double dx = (m_lastOdometry(0)-m_previousOdometry(0))/sampleTime;
+  double dy = (m_lastOdometry(1)-m_previousOdometry(1))/sampleTime;
+  //The measured yaw rate when it is recent, as for the yaw compensation in Slam
+  double yawAge = (m_hasYawRate)?(std::fabs(static_cast<double>(cluon::time::deltaInMicroseconds(m_lastOdometryTime, m_yawRateTime)))/1000000):(1.0);
+  double yawRate = (yawAge < 1)?(m_yawRate):(wrapAngle(m_lastOdometry(2)-m_previousOdometry(2))/sampleTime);
+  double vx = dx*cos(heading)+dy*sin(heading);
+  double vy = -dx*sin(heading)+dy*cos(heading);
+
+  //Propagate with midpoint heading, then move into the corrected frame
+  double midHeading = heading+yawRate*latency/2;
+  Eigen::Vector3d propagated;
+  propagated << m_lastOdometry(0)+(vx*cos(midHeading)-vy*sin(midHeading))*latency,
+                m_lastOdometry(1)+(vx*sin(midHeading)+vy*cos(midHeading))*latency,
+                wrapAngle(heading+yawRate*latency);
+  return compose(m_correction, propagated);
+}
+
+bool PoseExtrapolator::isPublishing() const
+{
+  return m_frequency > 0;
+}
+
+uint64_t PoseExtrapolator::sentPoses() const
+{
+  return m_sentPoses;
+}
+
+void PoseExtrapolator::run()
+{
+  //Live only, replayed time drives publishUntil
+  const int64_t period = static_cast<int64_t>(1000000/m_frequency);
+  int64_t nextTick = cluon::time::toMicroseconds(m_clock.now());
+  while(m_running){
+    int64_t now = cluon::time::toMicroseconds(m_clock.now());
+    //Skip ticks that were missed
+    nextTick = (now > nextTick+period)?(now+period):(nextTick+period);
+    if(!m_clock.waitUntil(cluon::time::fromMicroseconds(nextTick))){
+      nextTick -= period;
+      continue;
+    }
+    bool hasOdometry = false;
+    {
+      std::lock_guard<std::mutex> lockState(m_stateMutex);
+      hasOdometry = m_odometrySamples > 0;
+    }
+    if(hasOdometry){
+      cluon::data::TimeStamp publishTime = m_clock.now();
+      sendPose(extrapolate(publishTime),publishTime);
+    }
+  }
+}
+
+void PoseExtrapolator::publishUntil(cluon::data::TimeStamp const &time)
+{
+  //Every tick up to the replayed time, before the sample that moved it is applied
+  const int64_t period = static_cast<int64_t>(1000000/m_frequency);
+  int64_t now = cluon::time::toMicroseconds(time);
+  if(m_nextTick == 0 || now-m_nextTick > 1000000){
+    //The first sample or a pause in the recording, start again from the next tick
+    m_nextTick = (now/period+1)*period;
+    return;
+  }
+  while(m_nextTick <= now){
+    cluon::data::TimeStamp publishTime = cluon::time::fromMicroseconds(m_nextTick);
+    m_nextTick += period;
+    bool hasOdometry = false;
+    {
+      std::lock_guard<std::mutex> lockState(m_stateMutex);
+      hasOdometry = m_odometrySamples > 0;
+    }
+    if(hasOdometry){
+      sendPose(extrapolate(publishTime),publishTime);
+    }
+  }
+}
+
+void PoseExtrapolator::sendPose(Eigen::Vector3d const &pose, cluon::data::TimeStamp const &sampleTime)
+{
+  //Same message layout as Slam::sendPose so consumers see one pose stream
+  opendlv::logic::sensation::Geolocation poseMessage;
+  std::array<double,2> cartesianPos;
+  cartesianPos[0] = pose(0);
+  cartesianPos[1] = pose(1);
+  std::array<double,2> sendGPS = wgs84::fromCartesian(m_gpsReference, cartesianPos);
+  poseMessage.longitude(static_cast<float>(sendGPS[0]));
+  poseMessage.latitude(static_cast<float>(sendGPS[1]));
+  poseMessage.heading(static_cast<float>(pose(2)));
+  od4.send(poseMessage, sampleTime, m_senderStamp);
+  m_sentPoses++;
+}
+
+Eigen::Vector3d PoseExtrapolator::compose(Eigen::Vector3d const &a, Eigen::Vector3d const &b)
+{
+  Eigen::Vector3d result;
+  result << a(0)+b(0)*cos(a(2))-b(1)*sin(a(2)),
+            a(1)+b(0)*sin(a(2))+b(1)*cos(a(2)),
+            wrapAngle(a(2)+b(2));
+  return result;
+}
+
+Eigen::Vector3d PoseExtrapolator::inverse(Eigen::Vector3d const &a)
+{
+  Eigen::Vector3d result;
+  result << -a(0)*cos(a(2))-a(1)*sin(a(2)),
+            a(0)*sin(a(2))-a(1)*cos(a(2)),
+            wrapAngle(-a(2));
+  return result;
+}
+
+double PoseExtrapolator::wrapAngle(double angle)
+{
+  return std::atan2(std::sin(angle),std::cos(angle));
+}
@@ -0,0 +1,95 @@
+/**
+ * Copyright (C) 2018 Chalmers Revere
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+
+#ifndef POSEEXTRAPOLATOR_HPP
+#define POSEEXTRAPOLATOR_HPP
+
+#include <array>
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <Eigen/Dense>
+#include "cluon-complete.hpp"
+#include "opendlv-standard-message-set.hpp"
+
+#include "clock.hpp"
+
+/*
+ * Publishes the pose at a fixed rate on its own thread. The last SLAM
+ * corrected pose is kept as an SE2 offset to odometry, applied to the latest
+ * odometry sample and then propagated to the publish time. The velocity is
+ * estimated from the last two odometry samples and the heading follows the
+ * measured yaw rate, or the last two headings while no yaw rate has been
+ * received for a second. Only odometry, yaw rate and corrections are fed in,
+ * the graph is never accessed from here. In
+ * replay the poses are sent from Clock::update at multiples of the period,
+ * so they depend on the sample timestamps only.
+ */
+class PoseExtrapolator {
+ private:
+  PoseExtrapolator(const PoseExtrapolator &) = delete;
+  PoseExtrapolator(PoseExtrapolator &&)      = delete;
+  PoseExtrapolator &operator=(const PoseExtrapolator &) = delete;
+  PoseExtrapolator &operator=(PoseExtrapolator &&) = delete;
+ public:
+  PoseExtrapolator(std::map<std::string, std::string> commandlineArguments, cluon::OD4Session &a_od4, Clock &a_clock);
+  ~PoseExtrapolator();
+  void nextOdometry(Eigen::Vector3d const &pose, cluon::data::TimeStamp const &sampleTime);
+  //Radians per second, counter clockwise
+  void nextYawRate(double yawRate, cluon::data::TimeStamp const &sampleTime);
+  void nextCorrection(Eigen::Vector3d const &odometryPose, Eigen::Vector3d const &correctedPose);
+  Eigen::Vector3d extrapolate(cluon::data::TimeStamp const &time);
+  //True with --poseRate, the fixed rate stream then is the only pose output
+  bool isPublishing() const;
+  uint64_t sentPoses() const;
+
+ private:
+  void setUp(std::map<std::string, std::string> configuration);
+  void run();
+  void publishUntil(cluon::data::TimeStamp const &time);
+  void sendPose(Eigen::Vector3d const &pose, cluon::data::TimeStamp const &sampleTime);
+  Eigen::Vector3d compose(Eigen::Vector3d const &a, Eigen::Vector3d const &b);
+  Eigen::Vector3d inverse(Eigen::Vector3d const &a);
+  double wrapAngle(double angle);
+
+  cluon::OD4Session &od4;
+  Clock &m_clock;
+  std::mutex m_stateMutex;
+  std::thread m_publisher;
+  std::atomic<bool> m_running;
+  double m_frequency = 0;
+  double m_maxExtrapolationTime = 0.2;
+  uint32_t m_senderStamp = 0;
+  std::array<double,2> m_gpsReference;
+  Eigen::Vector3d m_correction;
+  Eigen::Vector3d m_lastOdometry;
+  Eigen::Vector3d m_previousOdometry;
+  cluon::data::TimeStamp m_lastOdometryTime;
+  cluon::data::TimeStamp m_previousOdometryTime;
+  uint32_t m_odometrySamples = 0;
+  double m_yawRate = 0;
+  cluon::data::TimeStamp m_yawRateTime;
+  bool m_hasYawRate = false;
+  int64_t m_nextTick = 0;
+  std::atomic<uint64_t> m_sentPoses;
+};
+
+#endif
@@ -0,0 +1,198 @@
+/**
+* Copyright (C) 2018 Chalmers Revere
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+* USA.
+*/
+
+#include <pthread.h>
+#include <iostream>
+
+#include "publisher.hpp"
+#include "WGS84toCartesian.hpp"
+
+namespace {
+//Largest message is a full ConeFrame, the envelope adds less than this
+const std::size_t ENVELOPE_OVERHEAD = 128;
+const std::size_t MAX_ENVELOPE_SIZE = PACKED_CONE_SIZE*MAX_CONES_PER_FRAME+2*ENVELOPE_OVERHEAD;
+
+void appendTimeStamp(std::string &out, uint32_t id, cluon::data::TimeStamp const &timeStamp){
+  uint32_t seconds = zigZag32(timeStamp.seconds());
+  uint32_t microseconds = zigZag32(timeStamp.microseconds());
+  appendProtoLength(out, id, 2+varIntSize(seconds)+varIntSize(microseconds));
+  appendProtoVarInt(out, 1, seconds);
+  appendProtoVarInt(out, 2, microseconds);
+}
+}
+
+PublishBatch::PublishBatch() :
+  sampleTime()
+, hasPose(false)
+, pose(Eigen::Vector3d::Zero())
+, numberOfCones(0)
+, cones()
+{
+}
+
+Publisher::Publisher(std::map<std::string, std::string> commandlineArguments, cluon::OD4Session &a_od4) :
+  od4(a_od4)
+, m_batches(8)
+, m_queueMutex()
+, m_queueCondition()
+, m_publisher()
+, m_gpsReference()
+, m_envelopes()
+, m_message()
+, m_payload()
+{
+  setUp(commandlineArguments);
+  m_publisher = std::thread(&Publisher::run,this);
+}
+
+Publisher::~Publisher()
+{
+  {
+    std::lock_guard<std::mutex> lockQueue(m_queueMutex);
+    m_running = false;
+  }
+  m_queueCondition.notify_all();
+  m_publisher.join();
+}
+
+void Publisher::setUp(std::map<std::string, std::string> configuration)
+{
+  m_gpsReference[0] = static_cast<double>(std::stod(configuration["refLatitude"]));
+  m_gpsReference[1] = static_cast<double>(std::stod(configuration["refLongitude"]));
+  m_senderStamp = static_cast<int>(std::stoi(configuration["id"]));
+  //Pose and ConeFrame come first in a batch, so only the first two can be large
+  m_envelopes.resize(3*MAX_CONES_PER_FRAME+2);
+  for(uint32_t i = 0; i < m_envelopes.size(); i++){
+    m_envelopes[i].reserve((i < 2)?(MAX_ENVELOPE_SIZE):(ENVELOPE_OVERHEAD));
+  }
+  m_message.reserve(MAX_ENVELOPE_SIZE);
+  m_payload.reserve(MAX_ENVELOPE_SIZE);
+  m_sendLegacyCones = (configuration.count("legacyConeOutput") != 0)?(std::stoi(configuration["legacyConeOutput"]) != 0):(true);
+}
+
+void Publisher::publish(PublishBatch const &batch)
+{
+  {
+    std::lock_guard<std::mutex> lockQueue(m_queueMutex);
+    if(m_count == m_batches.size()){ //Network is behind, newer data is worth more
+      m_head = (m_head+1)%m_batches.size();
+      m_count--;
+    }
+    m_batches[(m_head+m_count)%m_batches.size()] = batch;
+    m_count++;
+  }
+  m_queueCondition.notify_one();
+}
+
+void Publisher::run()
+{
+  pthread_setname_np(pthread_self(), "slam-publisher");
+  PublishBatch batch;
+  while(true){
+    {
+      std::unique_lock<std::mutex> lockQueue(m_queueMutex);
+      m_queueCondition.wait(lockQueue, [this]{return !m_running || m_count > 0;});
+      if(m_count == 0){
+        return;
+      }
+      batch = m_batches[m_head];
+      m_head = (m_head+1)%m_batches.size();
+      m_count--;
+    }
+    if(batch.hasPose){
+      sendPose(batch);
+    }
+    if(batch.numberOfCones > 0){
+      sendCones(batch);
+    }
+    od4.sendBatch(m_envelopes.data(), m_numberOfEnvelopes);
+    m_numberOfEnvelopes = 0;
+  }
+}
+
+void Publisher::sendPose(PublishBatch const &batch)
+{
+  std::array<double,2> cartesianPos;
+  cartesianPos[0] = batch.pose(0);
+  cartesianPos[1] = batch.pose(1);
+  std::array<double,2> sendGPS = wgs84::fromCartesian(m_gpsReference, cartesianPos);
+  m_message.clear();
+  appendProtoDouble(m_message, 1, static_cast<float>(sendGPS[1]));
+  appendProtoDouble(m_message, 2, static_cast<float>(sendGPS[0]));
+  appendProtoFloat(m_message, 3, 0.0f);
+  appendProtoFloat(m_message, 4, static_cast<float>(batch.pose(2)));
+  appendEnvelope(opendlv::logic::sensation::Geolocation::ID(), batch.sampleTime);
+}
+
+void Publisher::sendCones(PublishBatch const &batch)
+{
+  //Whole frame in one message with one shared sample time
+  m_message.clear();
+  appendProtoVarInt(m_message, 1, m_coneFrameId++);
+  appendProtoVarInt(m_message, 2, batch.numberOfCones);
+  appendProtoLength(m_message, 3, batch.numberOfCones*PACKED_CONE_SIZE);
+  appendPackedCones(m_message, batch.cones, batch.numberOfCones);
+  appendEnvelope(opendlv::logic::perception::ConeFrame::ID(), batch.sampleTime);
+  if(m_sendLegacyCones){
+    for(uint32_t i = 0; i < batch.numberOfCones; i++){
+      m_message.clear();
+      appendProtoVarInt(m_message, 1, batch.cones[i].objectId);
+      appendProtoFloat(m_message, 2, batch.cones[i].azimuthAngle);
+      appendProtoFloat(m_message, 3, batch.cones[i].zenithAngle);
+      appendEnvelope(opendlv::logic::perception::ObjectDirection::ID(), batch.sampleTime);
+      m_message.clear();
+      appendProtoVarInt(m_message, 1, batch.cones[i].objectId);
+      appendProtoFloat(m_message, 2, batch.cones[i].distance);
+      appendEnvelope(opendlv::logic::perception::ObjectDistance::ID(), batch.sampleTime);
+      m_message.clear();
+      appendProtoVarInt(m_message, 1, batch.cones[i].objectId);
+      appendProtoVarInt(m_message, 2, batch.cones[i].type);
+      appendEnvelope(opendlv::logic::perception::ObjectType::ID(), batch.sampleTime);
+    }
+  }
+}
+
+void Publisher::appendEnvelope(int32_t dataType, cluon::data::TimeStamp const &sampleTime)
+{
+  cluon::data::TimeStamp sent = cluon::time::now();
+  encodeEnvelope(m_envelopes[m_numberOfEnvelopes++], m_payload, dataType, m_message, sent,
+      (sampleTime.seconds()+sampleTime.microseconds() == 0)?(sent):(sampleTime), m_senderStamp);
+}
+
+void encodeEnvelope(std::string &envelope, std::string &payload, int32_t dataType, std::string const &message,
+    cluon::data::TimeStamp const &sent, cluon::data::TimeStamp const &sampleTime, uint32_t senderStamp)
+{
+  payload.clear();
+  appendProtoInt32(payload, 1, dataType);
+  appendProtoLength(payload, 2, message.size());
+  payload.append(message);
+  appendTimeStamp(payload, 3, sent);
+  appendTimeStamp(payload, 4, cluon::data::TimeStamp());
+  appendTimeStamp(payload, 5, sampleTime);
+  appendProtoVarInt(payload, 6, senderStamp);
+
+  uint32_t length = static_cast<uint32_t>(payload.size());
+  envelope.clear();
+  envelope.push_back(static_cast<char>(0x0D));
+  envelope.push_back(static_cast<char>(0xA4));
+  envelope.push_back(static_cast<char>(length & 0xff));
+  envelope.push_back(static_cast<char>((length >> 8) & 0xff));
+  envelope.push_back(static_cast<char>((length >> 16) & 0xff));
+  envelope.append(payload);
+}
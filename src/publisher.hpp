@@ -0,0 +1,94 @@
+/**
+ * Copyright (C) 2018 Chalmers Revere
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+
+#ifndef PUBLISHER_HPP
+#define PUBLISHER_HPP
+
+#include <array>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <Eigen/Dense>
+#include "cluon-complete.hpp"
+#include "opendlv-standard-message-set.hpp"
+
+#include "coneframe.hpp"
+
+/*
+ * Output stage for Slam. The SLAM thread hands over a finished batch (pose
+ * and/or cones already relative to the pose) and returns, the publisher
+ * thread does the encoding and the sends. Batches are kept in a fixed ring,
+ * when the network falls behind the oldest batch is dropped. All envelopes of
+ * a batch go out in one burst with as few syscalls as possible. Envelopes are
+ * encoded byte for byte as cluon would into buffers reserved at start, so
+ * publishing does not allocate.
+ */
+struct PublishBatch {
+  PublishBatch();
+  cluon::data::TimeStamp sampleTime;
+  bool hasPose;
+  Eigen::Vector3d pose;
+  uint32_t numberOfCones;
+  ConeFrameCone cones[MAX_CONES_PER_FRAME];
+};
+
+//Envelope and OD4 header as cluon::serializeEnvelope writes them, payload is scratch space
+void encodeEnvelope(std::string &envelope, std::string &payload, int32_t dataType, std::string const &message,
+    cluon::data::TimeStamp const &sent, cluon::data::TimeStamp const &sampleTime, uint32_t senderStamp);
+
+class Publisher {
+ private:
+  Publisher(const Publisher &) = delete;
+  Publisher(Publisher &&)      = delete;
+  Publisher &operator=(const Publisher &) = delete;
+  Publisher &operator=(Publisher &&) = delete;
+ public:
+  Publisher(std::map<std::string, std::string> commandlineArguments, cluon::OD4Session &a_od4);
+  ~Publisher();
+  void publish(PublishBatch const &batch);
+
+ private:
+  void setUp(std::map<std::string, std::string> configuration);
+  void run();
+  void sendPose(PublishBatch const &batch);
+  void sendCones(PublishBatch const &batch);
+  void appendEnvelope(int32_t dataType, cluon::data::TimeStamp const &sampleTime);
+
+  cluon::OD4Session &od4;
+  std::vector<PublishBatch> m_batches;
+  std::mutex m_queueMutex;
+  std::condition_variable m_queueCondition;
+  std::thread m_publisher;
+  bool m_running = true;
+  uint32_t m_head = 0;
+  uint32_t m_count = 0;
+  uint32_t m_senderStamp = 0;
+  std::array<double,2> m_gpsReference;
+  bool m_sendLegacyCones = true;
+  uint32_t m_coneFrameId = 0;
+  std::vector<std::string> m_envelopes;
+  std::size_t m_numberOfEnvelopes = 0;
+  std::string m_message;
+  std::string m_payload;
+};
+
+#endif
@@ -0,0 +1,137 @@
+/**
+ * Copyright (C) 2018 Chalmers Revere
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+
+#include <iostream>
+
+#include "relocalizer.hpp"
+
+Relocalization::Relocalization():
+  odometryPose(Eigen::Vector3d::Zero())
+, candidates()
+{
+}
+
+Relocalizer::Relocalizer(std::map<std::string, std::string> commandlineArguments, bool background):
+  m_recognizer(commandlineArguments)
+, m_map()
+, m_maxCandidates(5)
+, m_observed(Eigen::MatrixXd::Zero(3,MAX_CONES_PER_FRAME))
+, m_numberOfObserved(0)
+, m_odometryPose(Eigen::Vector3d::Zero())
+, m_result()
+, m_mutex()
+, m_condition()
+, m_worker()
+, m_background(background)
+{
+  setUp(commandlineArguments);
+  if(m_background){
+    m_worker = std::thread(&Relocalizer::run,this);
+  }
+}
+
+Relocalizer::~Relocalizer()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_running = false;
+  }
+  m_condition.notify_all();
+  if(m_worker.joinable()){
+    m_worker.join();
+  }
+}
+
+void Relocalizer::setUp(std::map<std::string, std::string> configuration)
+{
+  m_maxCandidates = (configuration.count("relocalizationCandidates") != 0)?(static_cast<uint32_t>(std::stoi(configuration["relocalizationCandidates"]))):(5);
+}
+
+void Relocalizer::setMap(LandmarkStore const &map)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_map = map;
+  m_recognizer.rebuild(m_map);
+  std::cout << "Relocalization index of " << m_recognizer.triangles() << " triangles" << std::endl;
+}
+
+bool Relocalizer::request(Eigen::Ref<Eigen::MatrixXd const> const &observed, Eigen::Vector3d const &odometryPose)
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if(m_pending || m_busy){
+      return false;
+    }
+    m_numberOfObserved = (observed.cols() < static_cast<int>(MAX_CONES_PER_FRAME))?(static_cast<uint32_t>(observed.cols())):(MAX_CONES_PER_FRAME);
+    m_observed.leftCols(m_numberOfObserved) = observed.leftCols(m_numberOfObserved);
+    m_odometryPose = odometryPose;
+    m_pending = true;
+  }
+  if(m_background){
+    m_condition.notify_one();
+  }
+  else{
+    relocalize();
+  }
+  return true;
+}
+
+bool Relocalizer::result(Relocalization &relocalization)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if(!m_hasResult){
+    return false;
+  }
+  relocalization = m_result;
+  m_hasResult = false;
+  return true;
+}
+
+void Relocalizer::run()
+{
+  while(true){
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_condition.wait(lock, [this]{return !m_running || m_pending;});
+      if(!m_running){
+        return;
+      }
+    }
+    relocalize();
+  }
+}
+
+void Relocalizer::relocalize()
+{
+  //The map, the index and the request are not touched by others while busy
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_pending = false;
+    m_busy = true;
+  }
+  Relocalization relocalization;
+  relocalization.odometryPose = m_odometryPose;
+  m_recognizer.relocalize(m_map, m_observed.leftCols(m_numberOfObserved), m_maxCandidates, relocalization.candidates);
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_result = relocalization;
+    m_hasResult = true;
+    m_busy = false;
+  }
+}
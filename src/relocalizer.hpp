@@ -0,0 +1,87 @@
+/**
+ * Copyright (C) 2018 Chalmers Revere
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+
+#ifndef RELOCALIZER_HPP
+#define RELOCALIZER_HPP
+
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <Eigen/Dense>
+
+#include "coneframe.hpp"
+#include "landmarkstore.hpp"
+#include "placerecognizer.hpp"
+
+//Candidate poses on the stored map for the odometry pose the cones were observed at
+struct Relocalization {
+  Relocalization();
+  Eigen::Vector3d odometryPose;
+  std::vector<LoopClosure> candidates;
+};
+
+/*
+ * Finds the car on a stored map without any prior on its pose. The triangle
+ * index of the whole map is built once, a request with the cones of one
+ * keyframe in the car frame is answered with candidate poses ranked by
+ * inliers. In live mode requests run on a worker thread and a request made
+ * while one is running is dropped; in replay they are answered right away.
+ */
+class Relocalizer {
+ private:
+  Relocalizer(const Relocalizer &) = delete;
+  Relocalizer(Relocalizer &&)      = delete;
+  Relocalizer &operator=(const Relocalizer &) = delete;
+  Relocalizer &operator=(Relocalizer &&) = delete;
+ public:
+  Relocalizer(std::map<std::string, std::string> commandlineArguments, bool background);
+  ~Relocalizer();
+  //Before the first request, the index is built here
+  void setMap(LandmarkStore const &map);
+  //observed holds x, y and type in the car frame, false if the request was dropped
+  bool request(Eigen::Ref<Eigen::MatrixXd const> const &observed, Eigen::Vector3d const &odometryPose);
+  //Takes the answer to the last request, once
+  bool result(Relocalization &relocalization);
+
+ private:
+  void setUp(std::map<std::string, std::string> configuration);
+  void run();
+  void relocalize();
+
+  PlaceRecognizer m_recognizer;
+  LandmarkStore m_map;
+  uint32_t m_maxCandidates;
+  Eigen::MatrixXd m_observed;
+  uint32_t m_numberOfObserved;
+  Eigen::Vector3d m_odometryPose;
+  Relocalization m_result;
+  std::mutex m_mutex;
+  std::condition_variable m_condition;
+  std::thread m_worker;
+  bool m_background;
+  bool m_running = true;
+  bool m_pending = false;
+  bool m_busy = false;
+  bool m_hasResult = false;
+};
+
+#endif
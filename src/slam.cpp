@@ -17,6 +17,7 @@
 * USA.
 */
 
+#include <algorithm>
 #include <iostream>
 
 #include "slam.hpp"
@@ -24,140 +25,244 @@
 
 Slam::Slam(std::map<std::string, std::string> commandlineArguments,cluon::OD4Session &a_od4) :
   od4(a_od4)
+, m_clock(commandlineArguments.count("replay") != 0)
+, m_poseExtrapolator(commandlineArguments,a_od4,m_clock)
+, m_publisher(commandlineArguments,a_od4)
 , m_optimizer()
 , m_lastTimeStamp()
+, m_frameDeadline()
 , m_coneCollector()
+, m_frameCones()
 , m_lastObjectId()
 , m_coneMutex()
 , m_sensorMutex()
 , m_mapMutex()
 , m_optimizerMutex()
 , m_yawMutex()
+, m_frameMutex()
 , m_odometryData()
 , m_gpsReference()
 , m_map()
-, m_keyframeTimeStamp()
+, m_coneTracker(3,5,1.0)
+, m_recentCones(1,30,1.0)
+, m_connectivityGraph()
+, m_placeRecognizer(commandlineArguments)
+, m_loopClosure()
+, m_mapOffset()
+, m_relocalizer(commandlineArguments,!m_clock.isReplay() && commandlineArguments.count("mapFile") != 0)
+, m_relocalization()
+, m_keyframeSelector()
+, m_vertexIds()
+, m_poseVertices()
+, m_coneVertices()
+, m_filter(makeFilterBackend(commandlineArguments))
+, m_filterObservations()
 , m_newFrame()
 , m_sendPose()
 , m_sendMutex()
+, m_collector()
+, m_collectorCondition()
 {
-  setupOptimizer();
   setUp(commandlineArguments);
-  m_coneCollector = Eigen::MatrixXd::Zero(4,100);
+  setupOptimizer();
+  //Sized once, the frame path only works in these buffers
+  m_coneCollector = Eigen::MatrixXd::Zero(4,MAX_COLLECTED_CONES);
+  m_frameCones = Eigen::MatrixXd::Zero(4,MAX_COLLECTED_CONES);
+  m_loopClosure.matches.reserve(MAX_CONES_PER_FRAME);
+  m_filterObservations.reserve(MAX_COLLECTED_CONES+MAX_CONES_PER_FRAME);
   m_lastObjectId = 0;
   m_odometryData << 0,0,0;
   m_sendPose << 0,0,0;
   m_newFrame = true;
+  if(!m_mapFile.empty()){
+    loadStoredMap();
+  }
+  if(!m_clock.isReplay()){
+    m_collector = std::thread(&Slam::runCollector,this);
+  }
 }
 
-void Slam::setupOptimizer(){
+Slam::~Slam()
+{
+  {
+    std::lock_guard<std::mutex> lockCone(m_coneMutex);
+    m_collectorRunning = false;
+  }
+  m_collectorCondition.notify_all();
+  if(m_collector.joinable()){
+    m_collector.join();
+  }
+  if(!m_graphFile.empty()){
+    saveGraph();
+  }
+}
 
-  typedef g2o::BlockSolver<g2o::BlockSolverTraits<-1, -1> > slamBlockSolver;
-  typedef g2o::LinearSolverEigen<slamBlockSolver::PoseMatrixType> slamLinearSolver;
-  
-  auto linearSolver = g2o::make_unique<slamLinearSolver>();
-  linearSolver->setBlockOrdering(false);
-  
-  g2o::OptimizationAlgorithmGaussNewton* algorithmType = new g2o::OptimizationAlgorithmGaussNewton(g2o::make_unique<slamBlockSolver>(std::move(linearSolver)));
-  m_optimizer.setAlgorithm(algorithmType); //Set optimizing method to Gauss Newton
+void Slam::setupOptimizer(){
+  m_optimizer.setAlgorithm(makeOptimizationAlgorithm("slam",false,m_optimizerThreads)); //Set optimizing method to Gauss Newton
   m_optimizer.setVerbose(true);
-  std::cout << "test test" << std::endl;
 }
 
-void Slam::nextCone(cluon::data::Envelope data)
+bool Slam::saveGraph(){
+  if(m_graphFile.empty() || m_filter){
+    std::cout << "No pose graph to save, set --graphFile and use the graph backend" << std::endl;
+    return false;
+  }
+  std::lock_guard<std::mutex> lockOptimizer(m_optimizerMutex);
+  bool saved = ::saveGraph(m_graphFile,m_optimizer);
+  std::cout << ((saved)?("Saved the pose graph to "):("Could not save the pose graph to ")) << m_graphFile << std::endl;
+  return saved;
+}
+
+void Slam::nextCone(cluon::data::Envelope const &data)
 {
-  //#####################Recieve Landmarks###########################
-  if (data.dataType() == opendlv::logic::perception::ObjectDirection::ID()) {
-    //std::cout << "Recieved Direction" << std::endl;
-    //Retrive data and timestamp
-    m_lastTimeStamp = data.sampleTimeStamp();
-    auto coneDirection = cluon::extractMessage<opendlv::logic::perception::ObjectDirection>(std::move(data));
-    uint32_t objectId = coneDirection.objectId();
-    bool newFrameDir = false;
+  cluon::data::TimeStamp sampleTime = data.sampleTimeStamp();
+  m_clock.update(sampleTime);
+  if(m_clock.isReplay()){
+    //Replayed frames are closed by the data itself so every run sees the same frames
+    bool frameComplete = false;
     {
       std::lock_guard<std::mutex> lockCone(m_coneMutex);
-      //Check last timestamp if they are from same message
-      //std::cout << "Message Recieved " << std::endl;
-      m_lastObjectId = (m_lastObjectId<objectId)?(objectId):(m_lastObjectId);
-
-      m_coneCollector(0,objectId) = coneDirection.azimuthAngle();
-      m_coneCollector(1,objectId) = coneDirection.zenithAngle();
-
-//	std::cout << "FRAME BEFORE LOCAL: " << m_newFrame << std::endl;
-      newFrameDir = m_newFrame;
-      m_newFrame = false;
+      frameComplete = !m_newFrame && cluon::time::deltaInMicroseconds(m_clock.now(),m_frameDeadline) >= 0;
     }
-
-	//std::cout << "FRAME: " << m_newFrame << std::endl;
-    if (newFrameDir){
-      
-      std::thread coneCollector (&Slam::initializeCollection,this);
-      coneCollector.detach();
-      
+    if(frameComplete){
+      collectCones();
     }
   }
-
+  //#####################Recieve Landmarks###########################
+  //ObjectDirection fills rows 0-1, ObjectDistance row 2 and ObjectType row 3
+  uint32_t firstRow;
+  uint32_t numberOfValues = 1;
+  if(data.dataType() == opendlv::logic::perception::ObjectDirection::ID()){
+    firstRow = 0;
+    numberOfValues = 2;
+  }
   else if(data.dataType() == opendlv::logic::perception::ObjectDistance::ID()){
-    
-    m_lastTimeStamp = data.sampleTimeStamp();
-    auto coneDistance = cluon::extractMessage<opendlv::logic::perception::ObjectDistance>(std::move(data));
-    uint32_t objectId = coneDistance.objectId();
-    bool newFrameDist = false;
-    {
-      std::lock_guard<std::mutex> lockCone(m_coneMutex);
-      m_coneCollector(2,objectId) = coneDistance.distance();
-      m_lastObjectId = (m_lastObjectId<objectId)?(objectId):(m_lastObjectId);
-	
-	//std::cout << "FRAME BEFORE LOCAL: " << m_newFrame << std::endl;
-      newFrameDist = m_newFrame;
-      m_newFrame = false;
-    }
+    firstRow = 2;
+  }
+  else if(data.dataType() == opendlv::logic::perception::ObjectType::ID()){
+    firstRow = 3;
+  }
+  else{
+    return;
+  }
 
-    //std::cout << "FRAME: " << m_newFrame << std::endl;
-    //Check last timestamp if they are from same message
-    //std::cout << "Message Recieved " << std::endl;
-    if (newFrameDist){
-       std::thread coneCollector(&Slam::initializeCollection, this);
-       coneCollector.detach();
-       //initializeCollection();
+  //Read the fields in place, objectId is field 1 and the values follow
+  uint32_t objectId = 0;
+  double values[2] = {0,0};
+  std::string const &payload = data.serializedData();
+  std::size_t position = 0;
+  ProtoField field;
+  while(nextProtoField(payload,position,field)){
+    if(field.id == 1){
+      objectId = static_cast<uint32_t>(field.value);
+    }
+    else if(field.id >= 2 && field.id < 2+numberOfValues){
+      values[field.id-2] = (field.wireType == 5)?(static_cast<double>(protoFloat(field))):(static_cast<double>(field.value));
     }
   }
 
-  else if(data.dataType() == opendlv::logic::perception::ObjectType::ID()){
-    
-    //std::cout << "Recieved Type" << std::endl;
-    m_lastTimeStamp = data.sampleTimeStamp();
-    auto coneType = cluon::extractMessage<opendlv::logic::perception::ObjectType>(std::move(data));
-    uint32_t objectId = coneType.objectId();
-    bool newFrameType =false;
-    {          
-      std::lock_guard<std::mutex> lockCone(m_coneMutex);
-      m_lastObjectId = (m_lastObjectId<objectId)?(objectId):(m_lastObjectId);
-      m_coneCollector(3,objectId) = coneType.type();
-      newFrameType = m_newFrame;
-      m_newFrame = false;
+  bool newFrame = false;
+  {
+    std::lock_guard<std::mutex> lockCone(m_coneMutex);
+    if(m_coneFrameInput || static_cast<Eigen::Index>(objectId) >= m_coneCollector.cols()){
+      return;
     }
+    m_lastTimeStamp = sampleTime;
+    m_lastObjectId = (m_lastObjectId<objectId)?(objectId):(m_lastObjectId);
+    for(uint32_t i = 0; i < numberOfValues; i++){
+      m_coneCollector(firstRow+i,objectId) = values[i];
+    }
+    newFrame = m_newFrame;
+    m_newFrame = false;
+  }
 
-    std::cout << "FRAME: " << m_newFrame << std::endl;
-    //Check last timestamp if they are from same message
-    //std::cout << "Message Recieved " << std::endl;
-    if (newFrameType){
-      std::thread coneCollector (&Slam::initializeCollection,this); //just sleep instead maybe since this is unclear how it works
-      coneCollector.detach();
-      //initializeCollection();
+  if(newFrame){
+    startCollection();
+  }
+}
 
+void Slam::flush()
+{
+  //Live frames are closed by the collector once their gathering time has passed
+  if(!m_clock.isReplay()){
+    return;
+  }
+  bool framePending = false;
+  {
+    std::lock_guard<std::mutex> lockCone(m_coneMutex);
+    framePending = !m_newFrame;
+  }
+  if(framePending){
+    collectCones();
+  }
+}
+
+void Slam::nextConeFrame(Eigen::Ref<Eigen::MatrixXd const> const &cones, cluon::data::TimeStamp const &sampleTime){
+  //Complete frames need no gathering, go straight to keyframe selection
+  m_clock.update(sampleTime);
+  {
+    //From now on the same frames sent as per-cone messages are ignored
+    std::lock_guard<std::mutex> lockCone(m_coneMutex);
+    m_coneFrameInput = true;
+  }
+  if(cones.cols() > 0){
+    //Frames from shared memory, ConeFrame envelopes and the collector are processed one at a time
+    std::lock_guard<std::mutex> lockFrame(m_frameMutex);
+    Eigen::Vector3d framePose;
+    {
+      std::lock_guard<std::mutex> lockSensor(m_sensorMutex);
+      framePose = m_odometryData;
+    }
+    if(m_keyframeSelector.isKeyframe(framePose,sampleTime)){
+      performSLAM(cones,sampleTime);
     }
   }
+}
 
+void Slam::nextConeFrame(cluon::data::Envelope const &data){
+  uint32_t numberOfCones = 0;
+  uint32_t packedNumberOfCones = 0;
+  ConeFrameCone packedCones[MAX_CONES_PER_FRAME];
+  std::string const &payload = data.serializedData();
+  std::size_t position = 0;
+  ProtoField field;
+  while(nextProtoField(payload,position,field)){
+    if(field.id == 2){
+      numberOfCones = static_cast<uint32_t>(field.value);
+    }
+    else if(field.id == 3){
+      packedNumberOfCones = unpackCones(field.data,field.length,packedCones,MAX_CONES_PER_FRAME);
+    }
+  }
+  numberOfCones = (packedNumberOfCones < numberOfCones)?(packedNumberOfCones):(numberOfCones);
+  ConeFrameMatrix cones(4,numberOfCones);
+  for(uint32_t i = 0; i < numberOfCones; i++){
+    cones(0,i) = packedCones[i].azimuthAngle;
+    cones(1,i) = packedCones[i].zenithAngle;
+    cones(2,i) = packedCones[i].distance;
+    cones(3,i) = packedCones[i].type;
+  }
+  nextConeFrame(cones,data.sampleTimeStamp());
 }
 
-void Slam::nextSplitPose(cluon::data::Envelope data){
+void Slam::nextSplitPose(cluon::data::Envelope const &data){
   std::lock_guard<std::mutex> lockSensor(m_sensorMutex);
+  cluon::data::TimeStamp sampleTime = data.sampleTimeStamp();
+  m_clock.update(sampleTime);
+  std::string const &payload = data.serializedData();
+  std::size_t position = 0;
+  ProtoField field;
   if(data.dataType() == opendlv::proxy::GeodeticWgs84Reading::ID()){
-    auto position = cluon::extractMessage<opendlv::proxy::GeodeticWgs84Reading>(std::move(data));
-
-    double longitude = position.longitude();
-    double latitude = position.latitude();
+    double latitude = 0;
+    double longitude = 0;
+    while(nextProtoField(payload,position,field)){
+      if(field.id == 1){
+        latitude = protoDouble(field);
+      }
+      else if(field.id == 3){
+        longitude = protoDouble(field);
+      }
+    }
 
     //toCartesian(const std::array<double, 2> &WGS84Reference, const std::array<double, 2> &WGS84Position)
 
@@ -172,26 +277,52 @@ void Slam::nextSplitPose(cluon::data::Envelope data){
 
     m_odometryData(0) =  WGS84Reading[0];
     m_odometryData(1) =  WGS84Reading[1];
+    m_splitPositionUpdated = true;
   }
   else if(data.dataType() == opendlv::proxy::GeodeticHeadingReading::ID()){
-    auto message = cluon::extractMessage<opendlv::proxy::GeodeticHeadingReading>(std::move(data));
-    double heading = message.northHeading();
+    double heading = 0;
+    while(nextProtoField(payload,position,field)){
+      if(field.id == 1){
+        heading = protoFloat(field);
+      }
+    }
     heading = heading-PI;
     heading = (heading > PI)?(heading-2*PI):(heading);
     heading = (heading < -PI)?(heading+2*PI):(heading);
     m_odometryData(2) = heading;
+    m_splitHeadingUpdated = true;
+  }
+  //Position and heading arrive separately, a sample with only one of them new would skew the velocity
+  if(m_splitPositionUpdated && m_splitHeadingUpdated){
+    m_poseExtrapolator.nextOdometry(m_odometryData,sampleTime);
+    m_splitPositionUpdated = false;
+    m_splitHeadingUpdated = false;
   }
 }
 
-void Slam::nextPose(cluon::data::Envelope data){
+void Slam::nextPose(cluon::data::Envelope const &data){
     //#########################Recieve Odometry##################################
   
   std::lock_guard<std::mutex> lockSensor(m_sensorMutex);
   m_geolocationReceivedTime = data.sampleTimeStamp();
-  auto odometry = cluon::extractMessage<opendlv::logic::sensation::Geolocation>(std::move(data));
-
-  double longitude = odometry.longitude();
-  double latitude = odometry.latitude();
+  m_clock.update(m_geolocationReceivedTime);
+  double latitude = 0;
+  double longitude = 0;
+  double heading = 0;
+  std::string const &payload = data.serializedData();
+  std::size_t position = 0;
+  ProtoField field;
+  while(nextProtoField(payload,position,field)){
+    if(field.id == 1){
+      latitude = protoDouble(field);
+    }
+    else if(field.id == 2){
+      longitude = protoDouble(field);
+    }
+    else if(field.id == 4){
+      heading = protoFloat(field);
+    }
+  }
 
   //toCartesian(const std::array<double, 2> &WGS84Reference, const std::array<double, 2> &WGS84Position)
 
@@ -206,123 +337,138 @@ void Slam::nextPose(cluon::data::Envelope data){
 
   m_odometryData << WGS84Reading[0],
                     WGS84Reading[1],
-                    odometry.heading();
+                    heading;
+  m_poseExtrapolator.nextOdometry(m_odometryData,m_geolocationReceivedTime);
 }
 
-void Slam::nextYawRate(cluon::data::Envelope data){
+void Slam::nextYawRate(cluon::data::Envelope const &data){
 
   std::lock_guard<std::mutex> lockYaw(m_yawMutex);
-  auto yawRate = cluon::extractMessage<opendlv::proxy::AngularVelocityReading>(std::move(data));
-  m_yawRate = yawRate.angularVelocityZ()/4;
-   m_yawReceivedTime = data.sampleTimeStamp();
+  m_yawReceivedTime = data.sampleTimeStamp();
+  m_clock.update(m_yawReceivedTime);
+  float angularVelocityZ = 0.0f;
+  std::string const &payload = data.serializedData();
+  std::size_t position = 0;
+  ProtoField field;
+  while(nextProtoField(payload,position,field)){
+    if(field.id == 3){
+      angularVelocityZ = protoFloat(field);
+    }
+  }
+  m_yawRate = angularVelocityZ/4;
+  m_poseExtrapolator.nextYawRate(static_cast<double>(m_yawRate),m_yawReceivedTime);
    //std::cout << "Yaw in message: " << m_yawRate << std::endl;
 }
 
-void Slam::initializeCollection(){
-  //std::this_thread::sleep_for(std::chrono::duration 1s); //std::chrono::milliseconds(m_timeDiffMilliseconds)
-
-  bool sleep = true;
-  auto start = std::chrono::system_clock::now();
-
-  while(sleep)
+void Slam::startCollection(){
+  //Called on the first message of a new frame, the frame is closed after the gathering time
+  cluon::data::TimeStamp deadline = cluon::time::fromMicroseconds(cluon::time::toMicroseconds(m_clock.now()) + m_timeDiffMilliseconds*1000);
   {
-    auto now = std::chrono::system_clock::now();
-    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(now - start);
-    if ( elapsed.count() > m_timeDiffMilliseconds*1000 )
-        sleep = false;
+    std::lock_guard<std::mutex> lockCone(m_coneMutex);
+    m_frameDeadline = deadline;
+    m_collectionPending = true;
   }
+  m_collectorCondition.notify_one();
+}
 
+void Slam::runCollector(){
+  //Live mode only, closes each frame once its gathering time has passed
+  while(true){
+    cluon::data::TimeStamp deadline;
+    {
+      std::unique_lock<std::mutex> lockCone(m_coneMutex);
+      m_collectorCondition.wait(lockCone,[this]{return !m_collectorRunning || m_collectionPending;});
+      if(!m_collectorRunning){
+        return;
+      }
+      m_collectionPending = false;
+      deadline = m_frameDeadline;
+    }
+    while(!m_clock.waitUntil(deadline)){}
+    collectCones();
+  }
+}
 
-  Eigen::MatrixXd extractedCones;
+void Slam::collectCones(){
+  //Called by the collector in live mode and the receiver in replay, frames from all inputs are serialized by m_frameMutex
+  uint32_t numberOfCones = 0;
+  cluon::data::TimeStamp frameTimeStamp;
   {
     std::lock_guard<std::mutex> lockCone(m_coneMutex);
     
 	//std::cout << "FRAME IN LOCK: " << m_newFrame << std::endl;
-    extractedCones = m_coneCollector.leftCols(m_lastObjectId+1);
+    //A frame gathered while the first complete frame arrived would be processed twice
+    numberOfCones = (m_coneFrameInput)?(0):(m_lastObjectId+1);
+    m_frameCones.leftCols(numberOfCones) = m_coneCollector.leftCols(numberOfCones);
+    frameTimeStamp = m_lastTimeStamp;
     m_newFrame = true;
     m_lastObjectId = 0;
-    m_coneCollector = Eigen::MatrixXd::Zero(4,1000);
+    //Initialize for next collection
+    m_coneCollector.setZero();
   }
-  //Initialize for next collection
-  std::cout << "Collection done" << extractedCones.cols() << std::endl;
+  auto extractedCones = m_frameCones.leftCols(numberOfCones);
   if(extractedCones.cols() > 0){
     //std::cout << "Extracted Cones " << std::endl;
     //std::cout << extractedCones << std::endl;
-    if(isKeyframe()){//Can add check to make sure only one process is running at a time
+    std::lock_guard<std::mutex> lockFrame(m_frameMutex);
+    Eigen::Vector3d framePose;
+    {
+      std::lock_guard<std::mutex> lockSensor(m_sensorMutex);
+      framePose = m_odometryData;
+    }
+    if(m_keyframeSelector.isKeyframe(framePose,frameTimeStamp)){//Can add check to make sure only one process is running at a time
       //std::cout << "Extracted Cones " << std::endl;
       //std::cout << extractedCones << std::endl;
-      performSLAM(extractedCones);//Thread?
-    }
-  }
-}
-
-bool Slam::CheckContainer(uint32_t objectId, cluon::data::TimeStamp timeStamp){
-    if ((abs(timeStamp.microseconds() - m_lastTimeStamp.microseconds()) < m_timeDiffMilliseconds*1000)){
-      m_lastObjectId = (m_lastObjectId<objectId)?(objectId):(m_lastObjectId);
-      m_lastTimeStamp = timeStamp;
-
+      performSLAM(extractedCones,frameTimeStamp);//Thread?
     }
-    else {
-      //All object candidates collected, to sensor fusion
-      Eigen::MatrixXd extractedCones;
-      extractedCones = m_coneCollector.leftCols(m_lastObjectId+1);
-      if(extractedCones.cols() > 1){
-        //std::cout << "Extracted Cones " << std::endl;
-        //std::cout << extractedCones << std::endl;
-        if(isKeyframe()){
-          std::cout << "Extracted Cones " << std::endl;
-          std::cout << extractedCones << std::endl;
-          performSLAM(extractedCones);//Thread?
-        }
-      }
-      //Initialize for next collection
-      m_lastTimeStamp = timeStamp;
-      m_lastObjectId = 0;
-      m_coneCollector = Eigen::MatrixXd::Zero(4,20);
-    }
-  return true;
-}
-
-bool Slam::isKeyframe(){
-  cluon::data::TimeStamp startTime = cluon::time::now();
-  double timeElapsed = fabs(static_cast<double>(cluon::time::deltaInMicroseconds(m_keyframeTimeStamp,startTime)))/1000;
-  std::cout << "Time ellapsed is: " << timeElapsed << std::endl;
-  if(timeElapsed>m_timeBetweenKeyframes){//Keyframe candidate is based on time difference from last keyframe
-    m_keyframeTimeStamp = startTime;
-    return true;
   }
-  return false;
 }
 
-
-void Slam::performSLAM(Eigen::MatrixXd cones){
+void Slam::performSLAM(Eigen::Ref<Eigen::MatrixXd const> const &cones, cluon::data::TimeStamp const &frameTimeStamp){
 
   if(fabs(m_odometryData(0))>200 || fabs(m_odometryData(1))>200)
   {
     return;
   }
     Eigen::Vector3d pose;
+  //As the pose extrapolator gets it, before yaw compensation and the stored map offset
+  Eigen::Vector3d odometryPose;
   {
     std::lock_guard<std::mutex> lockSensor(m_sensorMutex);
     pose = m_odometryData;
+    odometryPose = m_odometryData;
     //cluon::data::TimeStamp currentTime = cluon::time::now();
-    double timeElapsed = fabs(static_cast<double>(cluon::time::deltaInMicroseconds(m_yawReceivedTime, m_lastTimeStamp)))/1000000;
+    double timeElapsed = fabs(static_cast<double>(cluon::time::deltaInMicroseconds(m_yawReceivedTime, frameTimeStamp)))/1000000;
 
     {
     std::lock_guard<std::mutex> lockYaw(m_yawMutex);
-
-      std::cout << "heading: " << pose(2) <<" YawRate: " << m_yawRate << std::endl;
       if(timeElapsed > 0 && timeElapsed < 1){
         pose(2) = pose(2) - static_cast<double>(m_yawRate)*(timeElapsed);
       }
     }  
-    m_poses.push_back(pose);
-    std::cout << "heading: " << pose(2) << " Time: " << timeElapsed << std::endl;
   }
-  std::cout << "Adding cones to map" << std::endl;
+  if(m_mapLoaded){
+    //The odometry frame only fits a stored map once the car has been found on it
+    if(!relocalize(cones,pose)){
+      return;
+    }
+    pose = (m_mapOffset*g2o::SE2(pose(0),pose(1),pose(2))).toVector();
+  }
   {
     std::lock_guard<std::mutex> lockOptimizer(m_optimizerMutex);
-    addPoseToGraph(pose);
+    if(m_filter){
+      //Association runs from the predicted pose
+      m_filter->predict(pose);
+      pose = m_filter->pose();
+    }
+    else{
+      addPoseToGraph(pose);
+    }
+    m_keyframes++;
+  }
+  {
+    std::lock_guard<std::mutex> lockSensor(m_sensorMutex);
+    m_poses.push_back(pose);
   }
   //Maybe add m_loopClosingComplete check here
   if(!m_loopClosingComplete){
@@ -330,14 +476,14 @@ void Slam::performSLAM(Eigen::MatrixXd cones){
     addConesToMap(cones,pose);
   }
   if(m_loopClosingComplete && cones.cols() > 1){ //Use minimum of two cones for robustness
-    localizer(pose, cones);
+    localizer(pose, odometryPose, cones);
   }
   //Tracker
   //Reobserver idea, when not adding cones to map, a new function can be used
   //To check current observed cones, and adding new current odometry to these
 }
 
-void Slam::localizer(Eigen::Vector3d pose, Eigen::MatrixXd cones){
+void Slam::localizer(Eigen::Vector3d const &pose, Eigen::Vector3d const &odometryPose, Eigen::Ref<Eigen::MatrixXd const> const &cones){
 
   //Use current pose to evaluate which cones you see
  Eigen::Vector2d errorDistance;
@@ -345,45 +491,41 @@ void Slam::localizer(Eigen::Vector3d pose, Eigen::MatrixXd cones){
  uint32_t amountOfConesReobserved = 0;
  //Find local cone ID by iterate through map
  double minDistance = 100;
- uint32_t currentConeIndex;
+ uint32_t currentConeIndex = m_currentConeIndex;
  
   for(uint32_t i = 0; i < cones.cols(); i++){
-  Eigen::Vector3d coneObservedGlobal = coneToGlobal(pose, cones.col(i));
-  double distanceToCar = cones(2,i);
-   uint32_t j = 0;
-   bool coneFound = false;
-   std::lock_guard<std::mutex> lockMap(m_mapMutex);
-    while(!coneFound && j < m_map.size()){ //if(fabs(m_map[j].getType() - cones(3,i))<0.0001)
-
-        Cone coneEvaluatedInMap = Cone(coneObservedGlobal(0),coneObservedGlobal(1),static_cast<int>(coneObservedGlobal(2)),2000);
-
-        if(distanceBetweenCones(m_map[j],coneEvaluatedInMap) < m_newConeThreshold && (m_map[j].getType() - coneEvaluatedInMap.getType())<0.0001){
-
-
-          //Non graph localizer
-          errorDistance(0) += m_map[j].getX()-coneEvaluatedInMap.getX();
-          errorDistance(1) += m_map[j].getY()-coneEvaluatedInMap.getY();
-          amountOfConesReobserved++;
-          coneFound = true;
-
-
-          //Graph based localizer
-
-          std::lock_guard<std::mutex> lockOptimizer(m_optimizerMutex);
-          addConeMeasurement(m_map[j], pose);
+    Eigen::Vector3d coneObservedGlobal = coneToGlobal(pose, cones.col(i));
+    double distanceToCar = cones(2,i);
+    std::lock_guard<std::mutex> lockMap(m_mapMutex);
+    int32_t j = m_map.nearest(coneObservedGlobal(0),coneObservedGlobal(1),static_cast<int>(coneObservedGlobal(2)),m_newConeThreshold);
+    if(j >= 0){
+      //Non graph localizer
+      errorDistance(0) += m_map.x(j)-coneObservedGlobal(0);
+      errorDistance(1) += m_map.y(j)-coneObservedGlobal(1);
+      amountOfConesReobserved++;
+
+      //Graph based localizer
+      std::lock_guard<std::mutex> lockOptimizer(m_optimizerMutex);
+      Eigen::Vector3d observation;
+      observation << cones(0,i),cones(1,i),cones(2,i);
+      addConeMeasurement(m_map.cone(j), observation);
 
-            if(distanceToCar<minDistance){//Update current cone to know where in the map we are
-              currentConeIndex = j;
-              minDistance = distanceToCar;
-            }
+      if(distanceToCar<minDistance){//Update current cone to know where in the map we are
+        currentConeIndex = j;
+        minDistance = distanceToCar;
       }
-
-    j++;
+    }
   }
-
- }
+    //Cones in view but none of them on the map, the pose no longer fits the stored map
+    if(m_mapLoaded){
+      m_lostKeyframes = (amountOfConesReobserved == 0 && cones.cols() >= 3)?(m_lostKeyframes+1):(0);
+      if(m_lostKeyframes >= m_trackingLossKeyframes){
+        std::cout << "Tracking lost, relocalizing" << std::endl;
+        m_relocalized = false;
+        m_lostKeyframes = 0;
+      }
+    }
     m_sendConeData = (currentConeIndex != m_currentConeIndex);
-    std::cout << "currentConeIndex: " << currentConeIndex << "m_currentConeIndex: " << m_currentConeIndex << std::endl;
     m_currentConeIndex = (amountOfConesReobserved>0)?(currentConeIndex):(m_currentConeIndex);
  
   /*Non grapher
@@ -402,6 +544,7 @@ void Slam::localizer(Eigen::Vector3d pose, Eigen::MatrixXd cones){
   std::lock_guard<std::mutex> lockOptimizer(m_optimizerMutex);
   //optimizeGraph();
   Eigen::Vector3d updatedPoseVectorGraph = updatePoseFromGraph();
+  m_poseExtrapolator.nextCorrection(odometryPose,updatedPoseVectorGraph);
   {
     std::lock_guard<std::mutex> lockSend(m_sendMutex);
     m_sendPose = updatedPoseVectorGraph;
@@ -414,9 +557,12 @@ void Slam::localizer(Eigen::Vector3d pose, Eigen::MatrixXd cones){
 }
 
 Eigen::Vector3d Slam::updatePoseFromGraph(){
+  if(m_filter){
+    updateFilter();
+    return m_filter->pose();
+  }
 
-  g2o::VertexSE2* updatedPoseVertex = static_cast<g2o::VertexSE2*>(m_optimizer.vertex(m_poseId-1));
-  g2o::SE2 updatedPoseSE2 = updatedPoseVertex->estimate();
+  g2o::SE2 updatedPoseSE2 = m_poseVertices.back()->estimate();
   Eigen::Vector3d updatedPose = updatedPoseSE2.toVector();
   return updatedPose;
 }
@@ -430,25 +576,24 @@ Eigen::Vector3d Slam::updatePose(Eigen::Vector3d pose, Eigen::Vector2d errorDist
   return pose;
 }
 
-void Slam::addPoseToGraph(Eigen::Vector3d pose){
+void Slam::addPoseToGraph(Eigen::Vector3d const &pose){
   g2o::VertexSE2* poseVertex = new g2o::VertexSE2;
-  poseVertex->setId(m_poseId);
+  poseVertex->setId(m_vertexIds.nextPose());
   poseVertex->setEstimate(pose);
 
   m_optimizer.addVertex(poseVertex);
+  m_poseVertices.push_back(poseVertex);
   addOdometryMeasurement(pose);
-  std::vector<int> poseVector;
-  m_connectivityGraph.push_back(poseVector);
-  m_poseId++;
+  m_connectivityGraph.addPose();
 }
 
-void Slam::addOdometryMeasurement(Eigen::Vector3d pose){
-  if(m_poseId>1000){
+void Slam::addOdometryMeasurement(Eigen::Vector3d const &pose){
+  if(m_poseVertices.size()>1){
     g2o::EdgeSE2* odometryEdge = new g2o::EdgeSE2;
 
-    odometryEdge->vertices()[0] = m_optimizer.vertex(m_poseId-1);
-    odometryEdge->vertices()[1] = m_optimizer.vertex(m_poseId);
-    g2o::VertexSE2* prevVertex = static_cast<g2o::VertexSE2*>(m_optimizer.vertex(m_poseId-1));
+    g2o::VertexSE2* prevVertex = m_poseVertices[m_poseVertices.size()-2];
+    odometryEdge->vertices()[0] = prevVertex;
+    odometryEdge->vertices()[1] = m_poseVertices.back();
     g2o::SE2 prevPose = prevVertex->estimate();
     g2o::SE2 currentPose = g2o::SE2(pose(0), pose(1), pose(2));
     g2o::SE2 measurement = prevPose.inverse()*currentPose;
@@ -459,20 +604,25 @@ void Slam::addOdometryMeasurement(Eigen::Vector3d pose){
 }
 
 void Slam::optimizeGraph(){
-
-
-  g2o::VertexSE2* firstRobotPose = dynamic_cast<g2o::VertexSE2*>(m_optimizer.vertex(1000));
-  firstRobotPose->setFixed(true);
-
-  g2o::VertexSE2* secondRobotPose = dynamic_cast<g2o::VertexSE2*>(m_optimizer.vertex(1001));
-  secondRobotPose->setFixed(true);
-
-  g2o::VertexPointXY* firstCone = dynamic_cast<g2o::VertexPointXY*>(m_optimizer.vertex(0));
-  firstCone->setFixed(true);
-
-  g2o::VertexPointXY* secondCone = dynamic_cast<g2o::VertexPointXY*>(m_optimizer.vertex(1));
-  secondCone->setFixed(true);
-
+  if(m_poseVertices.empty()){
+    return;
+  }
+  if(m_anchorIds.empty()){
+    //The first two poses and cones hold the graph in place. Chosen once by vertex id,
+    //a merge removes an anchor instead of fixing whichever cone moves up in the map.
+    for(uint32_t i = 0; i < 2 && i < m_poseVertices.size(); i++){
+      m_anchorIds.push_back(m_poseVertices[i]->id());
+    }
+    for(uint32_t i = 0; i < 2 && i < m_map.size(); i++){
+      m_anchorIds.push_back(m_map.id(i));
+    }
+  }
+  for(int id : m_anchorIds){
+    g2o::OptimizableGraph::Vertex *anchor = dynamic_cast<g2o::OptimizableGraph::Vertex*>(m_optimizer.vertex(id));
+    if(anchor != nullptr){
+      anchor->setFixed(true);
+    }
+  }
 
   //m_optimizer.setVerbose(true);
 
@@ -483,20 +633,7 @@ void Slam::optimizeGraph(){
 
 }
 
-Eigen::MatrixXd Slam::conesToGlobal(Eigen::Vector3d pose, Eigen::MatrixXd cones){
-  Eigen::MatrixXd xyCones = Eigen::MatrixXd::Zero(3,20);
-  for(int i = 0; i<cones.cols();i++){
-    Eigen::Vector3d cone = Spherical2Cartesian(cones(0,i)+pose(2), cones(1,i), cones(2,i));
-    cone(0) += pose(0);
-    cone(1) += pose(1);
-    xyCones(0,i) = cone(0);
-    xyCones(1,i) = cone(1);
-    xyCones(2,i) = cones(3,i);
-  }
-  return xyCones;
-}
-
-Eigen::Vector3d Slam::coneToGlobal(Eigen::Vector3d pose, Eigen::MatrixXd cones){
+Eigen::Vector3d Slam::coneToGlobal(Eigen::Vector3d const &pose, Eigen::Vector4d const &cones){
 
 
   Eigen::Vector3d cone = Spherical2Cartesian(cones(0), cones(1), cones(2));
@@ -511,8 +648,8 @@ Eigen::Vector3d Slam::coneToGlobal(Eigen::Vector3d pose, Eigen::MatrixXd cones){
 
 
 Eigen::Vector2d Slam::transformConeToCoG(double angle, double distance){
-  const double lidarDistToCoG = 1.5;
-  double sign = angle/std::fabs(angle);
+  const double lidarDistToCoG = m_lidarOffset;
+  double sign = (angle < 0)?(-1.0):(1.0);
   angle = PI - std::fabs(angle*DEG2RAD); 
   double distanceNew = std::sqrt(lidarDistToCoG*lidarDistToCoG + distance*distance - 2*lidarDistToCoG*distance*std::cos(angle));
   double angleNew = std::asin((std::sin(angle)*distance)/distanceNew )*RAD2DEG; 
@@ -522,116 +659,254 @@ Eigen::Vector2d Slam::transformConeToCoG(double angle, double distance){
   return transformed;
 }
 
-void Slam::addConeToGraph(Cone cone, Eigen::Vector3d measurement){
+void Slam::addConeToGraph(Cone const &cone, Eigen::Vector3d const &measurement){
+  addLandmarkVertex(cone);
+  addConeMeasurement(cone, measurement);
+}
+
+g2o::VertexPointXY *Slam::addLandmarkVertex(Cone const &cone){
   Eigen::Vector2d conePose(cone.getX(),cone.getY());
   g2o::VertexPointXY* coneVertex = new g2o::VertexPointXY;
   coneVertex->setId(cone.getId());
   coneVertex->setEstimate(conePose);
 
   m_optimizer.addVertex(coneVertex);
-
-
-  addConeMeasurement(cone, measurement);
+  uint32_t coneIndex = VertexIds::index(cone.getId());
+  if(coneIndex >= m_coneVertices.size()){
+    m_coneVertices.resize(coneIndex+1,nullptr);
+  }
+  m_coneVertices[coneIndex] = coneVertex;
+  return coneVertex;
 }
 
-void Slam::addConeMeasurement(Cone cone, Eigen::Vector3d measurement){
-  g2o::EdgeSE2PointXY* coneMeasurement = new g2o::EdgeSE2PointXY;
-  Eigen::Vector3d xyzMeasurement = Spherical2Cartesian(measurement(0),measurement(1),measurement(2));
-  Eigen::Vector2d xyMeasurement;
-  xyMeasurement << xyzMeasurement(0),xyzMeasurement(1);
+void Slam::loadStoredMap(){
+  if(!loadMap(m_mapFile,m_map,m_vertexIds)){
+    std::cout << "No map in " << m_mapFile << ", mapping from scratch" << std::endl;
+    return;
+  }
+  //The stored map is final, the car is only localized against it
+  for(uint32_t i = 0; i < m_map.size(); i++){
+    if(m_filter){
+      m_filter->addMappedLandmark(m_map.x(i),m_map.y(i));
+    }
+    else{
+      addLandmarkVertex(m_map.cone(i))->setFixed(true);
+    }
+  }
+  m_relocalizer.setMap(m_map);
+  m_mapLoaded = true;
+  m_relocalized = false;
+  m_loopClosing = true;
+  m_loopClosingComplete = true;
+  std::cout << "Loaded a map of " << m_map.size() << " cones from " << m_mapFile << std::endl;
+}
 
-  coneMeasurement->vertices()[0] = m_optimizer.vertex(m_poseId-1);
-  coneMeasurement->vertices()[1] = m_optimizer.vertex(cone.getId());
-  coneMeasurement->setMeasurement(xyMeasurement);
-  coneMeasurement->setInformation(Eigen::Matrix2d::Identity()*0.01); //Placeholder value
-  m_optimizer.addEdge(coneMeasurement);
+bool Slam::relocalize(Eigen::Ref<Eigen::MatrixXd const> const &cones, Eigen::Vector3d const &pose){
+  //One frame of a regular track fits many places, the cones of the last keyframes in the odometry frame are matched together
+  for(uint32_t i = 0; i < cones.cols(); i++){
+    Eigen::Vector3d odometryCone = coneToGlobal(pose,cones.col(i));
+    m_recentCones.observe(odometryCone(0),odometryCone(1),static_cast<int>(cones(3,i)),0,odometryCone);
+  }
+  m_recentCones.endKeyframe();
+  if(m_relocalized){
+    return true;
+  }
+  Eigen::Matrix<double,3,Eigen::Dynamic,Eigen::ColMajor,3,static_cast<int>(MAX_CONES_PER_FRAME)> observed(3,0);
+  double cosHeading = std::cos(pose(2));
+  double sinHeading = std::sin(pose(2));
+  for(uint32_t i = 0; i < m_recentCones.size() && observed.cols() < static_cast<int>(MAX_CONES_PER_FRAME); i++){
+    double dx = m_recentCones.x(i)-pose(0);
+    double dy = m_recentCones.y(i)-pose(1);
+    observed.conservativeResize(Eigen::NoChange,observed.cols()+1);
+    observed.col(observed.cols()-1) << cosHeading*dx+sinHeading*dy,-sinHeading*dx+cosHeading*dy,m_recentCones.type(i);
+  }
+  //Dropped while the previous request runs, in replay answered right away
+  m_relocalizer.request(observed,pose);
+  if(!m_relocalizer.result(m_relocalization) || m_relocalization.candidates.empty()){
+    return false;
+  }
+  //A runner up elsewhere on the map with as many inliers leaves it open where the car is
+  LoopClosure const &best = m_relocalization.candidates[0];
+  if(best.inliers < m_relocalizationMinInliers){
+    return false;
+  }
+  for(uint32_t k = 1; k < m_relocalization.candidates.size(); k++){
+    LoopClosure const &other = m_relocalization.candidates[k];
+    double heading = std::fabs(std::atan2(std::sin(other.correction(2)-best.correction(2)),std::cos(other.correction(2)-best.correction(2))));
+    if(other.inliers >= best.inliers && ((other.correction.head<2>()-best.correction.head<2>()).norm() > m_newConeThreshold || heading > 0.1)){
+      std::cout << "Relocalization is ambiguous, " << best.inliers << " inliers at more than one pose" << std::endl;
+      return false;
+    }
+  }
+  //The best pose on the map for the odometry pose of the request gives the offset between the frames
+  m_mapOffset = g2o::SE2(best.correction(0),best.correction(1),best.correction(2))*g2o::SE2(m_relocalization.odometryPose(0),m_relocalization.odometryPose(1),m_relocalization.odometryPose(2)).inverse();
+  m_relocalized = true;
+  m_lostKeyframes = 0;
+  if(m_filter){
+    std::lock_guard<std::mutex> lockOptimizer(m_optimizerMutex);
+    m_filter->reset((m_mapOffset*g2o::SE2(pose(0),pose(1),pose(2))).toVector());
+  }
+  std::cout << "Relocalized with " << best.inliers << " inliers out of " << m_relocalization.candidates.size() << " candidates, map offset " << m_mapOffset.toVector().transpose() << std::endl;
+  return true;
+}
 
-  m_connectivityGraph[m_poseId-1001].push_back(cone.getId());
+void Slam::addConeMeasurement(Cone const &cone, Eigen::Vector3d const &measurement){
+  if(m_filter){
+    //Applied together at the end of the keyframe
+    Eigen::Vector3d xyzMeasurement = Spherical2Cartesian(measurement(0),measurement(1),measurement(2));
+    m_filterObservations.push_back({cone.getIndex(),xyzMeasurement(0),xyzMeasurement(1),false});
+    m_map.addObservation(cone.getIndex());
+    return;
+  }
+  addConeMeasurement(cone,measurement,m_poseVertices.back()->id());
 }
 
-void Slam::addConesToMap(Eigen::MatrixXd cones, Eigen::Vector3d pose){//Matches cones with previous cones and adds newly found cones to map
-  std::lock_guard<std::mutex> lockMap(m_mapMutex);
-  if(m_map.size() == 0){
-    Eigen::Vector3d globalCone = coneToGlobal(pose, cones.col(0));
-    Cone cone = Cone(globalCone(0),globalCone(1),(int)globalCone(2),m_map.size()); //Temp id, think of system later
-    m_map.push_back(cone);
+void Slam::updateFilter(){
+  m_filter->update(m_filterObservations.data(),static_cast<uint32_t>(m_filterObservations.size()));
+  m_filterObservations.clear();
+  updateMap();
+}
 
+int Slam::currentPoseId(){
+  return (m_filter)?(static_cast<int>(m_keyframes-1)):(m_poseVertices.back()->id());
+}
 
-    std::lock_guard<std::mutex> lockOptimizer(m_optimizerMutex);
-    Eigen::Vector3d observation;
-    observation << cones(0,0),cones(1,0),cones(2,0);
-    std::cout << "Observation: " << observation << std::endl;
-    addConeToGraph(cone,observation);
-    
-    std::cout << "Added the first cone" << std::endl;
+void Slam::addConeMeasurement(Cone const &cone, Eigen::Vector3d const &measurement, int poseId){
+  //One edge per pose and landmark, as in the observation graph
+  if(m_connectivityGraph.observes(VertexIds::index(poseId),cone.getId())){
+    return;
   }
+  //Range and bearing from the lidar as perception measured them, no conversion to the CoG
+  EdgeRangeBearing* coneMeasurement = new EdgeRangeBearing;
+  coneMeasurement->vertices()[0] = m_poseVertices[VertexIds::index(poseId)];
+  coneMeasurement->vertices()[1] = m_coneVertices[VertexIds::index(cone.getId())];
+  coneMeasurement->setObservation(measurement(0),measurement(1),measurement(2));
+  coneMeasurement->setSensorOffset(Eigen::Vector2d(m_lidarOffset,0));
+  coneMeasurement->setInformation(Eigen::Vector2d(m_rangeInformation,m_bearingInformation).asDiagonal());
+  m_optimizer.addEdge(coneMeasurement);
 
+  m_connectivityGraph.addObservation(VertexIds::index(poseId),cone.getId());
+  m_map.addObservation(cone.getIndex());
+}
+
+void Slam::addConesToMap(Eigen::Ref<Eigen::MatrixXd const> const &cones, Eigen::Vector3d const &pose){//Matches cones with previous cones and adds newly found cones to map
+  std::lock_guard<std::mutex> lockMap(m_mapMutex);
   double minDistance = 100;
+  //Global position and type of the cones within mapping range, for place recognition
+  Eigen::Matrix<double,3,Eigen::Dynamic,Eigen::ColMajor,3,static_cast<int>(MAX_CONES_PER_FRAME)> observed(3,0);
+  std::array<uint32_t,MAX_CONES_PER_FRAME> observedColumns;
+  //Landmark each observed cone was associated with, -1 for none
+  std::array<int32_t,MAX_CONES_PER_FRAME> associated;
   for(uint32_t i = 0; i<cones.cols(); i++){//Iterate through local cone objects
     double distanceToCar = cones(2,i);
     Eigen::Vector3d globalCone = coneToGlobal(pose, cones.col(i)); //Make local cone into global coordinate frame
-    uint32_t j = 0;
-    bool coneFound = false;
-    while(!coneFound && j<m_map.size() && !m_loopClosing){
-      if(fabs(m_map[j].getType() - cones(3,i))<0.0001){ //Check is same classification
-    
-        Cone globalConeObject = Cone(globalCone(0), globalCone(1),0,2000);
-        double distance = distanceBetweenCones(m_map[j],globalConeObject);
-
-        //(m_map[j].getX()-globalConeObject.getX())*(m_map[j].getX()-globalConeObject.getX())+(m_map[j].getY()-globalCone(1))*(m_map[j].getY()-globalCone(1)); //Check distance between new global cone and current j global cone
-        //distance = std::sqrt(distance);
-        //std::cout << distance << std::endl;
-        if(distance<m_newConeThreshold){ //NewConeThreshold is the accepted distance for a new cone candidate
-          coneFound = true;
-          std::lock_guard<std::mutex> lockOptimizer(m_optimizerMutex);
-          Eigen::Vector3d observation;
-          observation << cones(0,i),cones(1,i),cones(2,i);
-
-          std::cout << "Observation: " << observation << std::endl;
-	        addConeMeasurement(m_map[j],observation); //Add measurement to graph
-
-          if(loopClosing(m_map[j],distanceToCar) && m_loopClosing == false){ //Check if the new cone is a loop closing candidate
-            //optimizeGraph(); //Do full bundle adjustment
-            m_loopClosing = true; //Only want one full loopclosing
-          }
-
-          if(distanceToCar<minDistance){//Update current cone to know where in the map we are
-            m_currentConeIndex = j;
-            minDistance = distanceToCar;
-
-            //Loopcloser
-          }
-        }
-      }
-      j++;
+    int32_t column = -1;
+    if(distanceToCar < m_coneMappingThreshold && observed.cols() < static_cast<int>(MAX_CONES_PER_FRAME)){
+      column = static_cast<int32_t>(observed.cols());
+      observed.conservativeResize(Eigen::NoChange,column+1);
+      observed.col(column) << globalCone(0),globalCone(1),cones(3,i);
+      observedColumns[column] = i;
+      associated[column] = -1;
     }
-    if(distanceToCar < m_coneMappingThreshold && !coneFound && !m_loopClosing){
-      std::cout << "Trying to add cone" << std::endl;
-      Cone cone = Cone(globalCone(0),globalCone(1),(int)globalCone(2),m_map.size()); //Temp id, think of system later
-      m_map.push_back(cone); //Add Cone
-      std::cout << "Added a new cone" << std::endl;
-      std::cout << "map size" << m_map.size() << std::endl;
+    bool coneFound = false;
+    int32_t j = (m_loopClosing)?(-1):(m_map.nearest(globalCone(0),globalCone(1),static_cast<int>(cones(3,i)),m_newConeThreshold)); //Closest cone of the same classification
+    if(j >= 0){ //NewConeThreshold is the accepted distance for a new cone candidate
+      coneFound = true;
       std::lock_guard<std::mutex> lockOptimizer(m_optimizerMutex);
       Eigen::Vector3d observation;
       observation << cones(0,i),cones(1,i),cones(2,i);
 
-       std::cout << "Observation: " << observation << std::endl;
-      addConeToGraph(cone,observation);
- //     optimizeGraph();
- //     updateMap();
-      //Add Threading??
-    }
+      addConeMeasurement(m_map.cone(j),observation); //Add measurement to graph
 
-    if(m_loopClosing){
+      if(column >= 0){
+        associated[column] = j;
+      }
 
-      std::lock_guard<std::mutex> lockOptimizer(m_optimizerMutex);
-      optimizeGraph();
-      updateMap();
+      if(distanceToCar<minDistance){//Update current cone to know where in the map we are
+        m_currentConeIndex = j;
+        minDistance = distanceToCar;
+      }
+    }
+    if(distanceToCar < m_coneMappingThreshold && !coneFound && !m_loopClosing){
+      //Unmatched cones are tracked as candidates until they are seen often enough
+      Eigen::Vector3d observation;
+      observation << cones(0,i),cones(1,i),cones(2,i);
+      int32_t candidate = m_coneTracker.observe(globalCone(0),globalCone(1),static_cast<int>(cones(3,i)),currentPoseId(),observation);
+      if(candidate >= 0 && m_coneTracker.isConfirmed(candidate)){
+        std::lock_guard<std::mutex> lockOptimizer(m_optimizerMutex);
+        promoteCandidate(candidate);
+      }
+    }
+  }
+  m_coneTracker.endKeyframe();
+  if(!m_loopClosing){
+    detectLoopClosure(cones,observed,observedColumns,associated,pose);
+  }
+  if(m_filter){
+    std::lock_guard<std::mutex> lockOptimizer(m_optimizerMutex);
+    updateFilter();
+  }
+}
 
-      m_loopClosingComplete = true;
+void Slam::detectLoopClosure(Eigen::Ref<Eigen::MatrixXd const> const &cones, Eigen::Ref<Eigen::MatrixXd const> const &observed, std::array<uint32_t,MAX_CONES_PER_FRAME> const &observedColumns, std::array<int32_t,MAX_CONES_PER_FRAME> const &associated, Eigen::Vector3d const &pose){
+  uint32_t keyframe = m_keyframes-1;
+  if(keyframe < m_lastLoopClosureKeyframe+m_loopClosureCooldown || !m_placeRecognizer.recognize(m_map,observed,pose,keyframe,m_loopClosure)){
+    return;
+  }
+  std::cout << "Loop closure with " << m_loopClosure.inliers << " inliers, correction " << m_loopClosure.correction.transpose() << std::endl;
+  std::lock_guard<std::mutex> lockOptimizer(m_optimizerMutex);
+  //The recognized landmarks are measured from the current pose, the optimization closes the loop
+  for(auto const &match : m_loopClosure.matches){
+    if(associated[match.first] == static_cast<int32_t>(match.second)){
+      continue;
+    }
+    uint32_t i = observedColumns[match.first];
+    Eigen::Vector3d measurement;
+    measurement << cones(0,i),cones(1,i),cones(2,i);
+    addConeMeasurement(m_map.cone(match.second),measurement);
+  }
+  if(m_filter){
+    //The filter closes the loop by its own update, landmarks stay where they are in the store
+    updateFilter();
+  }
+  else{
+    optimizeGraph();
+    updateMap();
+    mergeLandmarks();
+  }
+  m_placeRecognizer.update(m_map);
+  m_lastLoopClosureKeyframe = keyframe;
+  if(m_loopClosure.reachesStart){
+    //Back at the start, the map is complete
+    m_loopClosing = true;
+    m_loopClosingComplete = true;
+    if(!m_mapFile.empty()){
+      std::cout << ((saveMap(m_mapFile,m_map))?("Saved the map to "):("Could not save the map to ")) << m_mapFile << std::endl;
+    }
+  }
+}
 
+void Slam::promoteCandidate(uint32_t candidate){
+  //The candidate becomes a landmark with all of its observations as measurements
+  uint32_t index = m_map.add(m_coneTracker.x(candidate),m_coneTracker.y(candidate),m_coneTracker.type(candidate),m_vertexIds.nextLandmark());
+  Cone cone = m_map.cone(index);
+  uint32_t last = m_coneTracker.observations(candidate)-1;
+  if(m_filter){
+    //A filter has no past poses, the landmark is initialized from the current one
+    Eigen::Vector3d const &measurement = m_coneTracker.observationMeasurement(candidate,last);
+    Eigen::Vector3d xyzMeasurement = Spherical2Cartesian(measurement(0),measurement(1),measurement(2));
+    m_filterObservations.push_back({index,xyzMeasurement(0),xyzMeasurement(1),true});
+    m_map.addObservation(index);
+  }
+  else{
+    addConeToGraph(cone,m_coneTracker.observationMeasurement(candidate,last));
+    for(uint32_t i = 0; i < last; i++){
+      addConeMeasurement(cone,m_coneTracker.observationMeasurement(candidate,i),m_coneTracker.observationPoseId(candidate,i));
     }
   }
+  m_coneTracker.remove(candidate);
+  m_placeRecognizer.addLandmark(m_map,index,m_keyframes-1);
+  std::cout << "Added a new cone, map size" << m_map.size() << std::endl;
 }
     
 Eigen::Vector3d Slam::Spherical2Cartesian(double azimuth, double zenimuth, double distance)
@@ -646,101 +921,186 @@ Eigen::Vector3d Slam::Spherical2Cartesian(double azimuth, double zenimuth, doubl
   double xData = distance * cos(zenimuth * static_cast<double>(DEG2RAD))*cos(azimuth * static_cast<double>(DEG2RAD));
   double yData = distance * cos(zenimuth * static_cast<double>(DEG2RAD))*sin(azimuth * static_cast<double>(DEG2RAD));
   double zData = distance * sin(zenimuth * static_cast<double>(DEG2RAD));
-  Eigen::MatrixXd recievedPoint = Eigen::Vector3d::Zero();
-  recievedPoint << xData,
-                   yData,
-                   zData;
-  return recievedPoint;
+  return Eigen::Vector3d(xData,yData,zData);
 }
 
 void Slam::sendCones()
 {
-  Eigen::Vector3d pose;
+  //Only the batch is prepared here, encoding and sending happens on the publisher thread
+  PublishBatch batch;
   {
     std::lock_guard<std::mutex> lockSend(m_sendMutex); 
-    pose = m_sendPose;
-  }//mapmutex too
-  std::lock_guard<std::mutex> lockMap(m_mapMutex);
-  //std::chrono::system_clock::time_point tp = std::chrono::system_clock::now();
-  cluon::data::TimeStamp sampleTime = m_geolocationReceivedTime;
-  for(uint32_t i = 0; i<m_conesPerPacket;i++){ //Iterate through the cones ahead of time the path planning recieves
-    int index = (m_currentConeIndex+i<m_map.size())?(m_currentConeIndex+i):(m_currentConeIndex+i-m_map.size()); //Check if more cones is sent than there exists
-    opendlv::logic::perception::ObjectDirection directionMsg = m_map[index].getDirection(pose); //Extract cone direction
-    directionMsg.objectId(i);
-    od4.send(directionMsg,sampleTime,m_senderStamp);
-    opendlv::logic::perception::ObjectDistance distanceMsg = m_map[index].getDistance(pose); //Extract cone distance
-    distanceMsg.objectId(i);
-    od4.send(distanceMsg,sampleTime,m_senderStamp);
-    opendlv::logic::perception::ObjectType typeMsg;
-    typeMsg.type(m_map[index].getType()); //Extract cone type
-    typeMsg.objectId(i);
-    od4.send(typeMsg,sampleTime,m_senderStamp);
+    batch.pose = m_sendPose;
+  }
+  {
+    std::lock_guard<std::mutex> lockSensor(m_sensorMutex);
+    batch.sampleTime = m_geolocationReceivedTime;
   }
+  {
+    std::lock_guard<std::mutex> lockMap(m_mapMutex);
+    if(m_map.size() == 0){
+      return;
+    }
+    batch.numberOfCones = (m_conesPerPacket < MAX_CONES_PER_FRAME)?(m_conesPerPacket):(MAX_CONES_PER_FRAME);
+    batch.numberOfCones = (batch.numberOfCones < m_map.size())?(batch.numberOfCones):(m_map.size());
+    for(uint32_t i = 0; i<batch.numberOfCones;i++){ //Iterate through the cones ahead of time the path planning recieves
+      uint32_t index = (m_currentConeIndex+i)%m_map.size(); //Wrap around when more cones are sent than there exist
+      Cone cone = m_map.cone(index);
+      opendlv::logic::perception::ObjectDirection directionMsg = cone.getDirection(batch.pose); //Extract cone direction
+      opendlv::logic::perception::ObjectDistance distanceMsg = cone.getDistance(batch.pose); //Extract cone distance
+      batch.cones[i].azimuthAngle = directionMsg.azimuthAngle();
+      batch.cones[i].zenithAngle = directionMsg.zenithAngle();
+      batch.cones[i].distance = distanceMsg.distance();
+      batch.cones[i].type = cone.getType(); //Extract cone type
+      batch.cones[i].objectId = i;
+    }
+  }
+  m_publisher.publish(batch);
 }
 
 void Slam::sendPose(){
-  opendlv::logic::sensation::Geolocation poseMessage;
-  std::lock_guard<std::mutex> lockSend(m_sendMutex); 
-
-  std::array<double,2> cartesianPos;
-  cartesianPos[0] = m_sendPose(0);
-  cartesianPos[1] = m_sendPose(1);
-  std::array<double,2> sendGPS = wgs84::fromCartesian(m_gpsReference, cartesianPos);
-  poseMessage.longitude(static_cast<float>(sendGPS[0]));
-  poseMessage.latitude(static_cast<float>(sendGPS[1]));
-  poseMessage.heading(static_cast<float>(m_sendPose(2)));
-  //std::chrono::system_clock::time_point tp = std::chrono::system_clock::now();
-  cluon::data::TimeStamp sampleTime = m_geolocationReceivedTime;
-  od4.send(poseMessage, sampleTime ,m_senderStamp);
-}
-
-bool Slam::loopClosing(Cone cone,double distance2car){
-  //Eigen::Vector2d initialCone;
-  //initialCone << m_map[0].getX(),m_map[0].getY();
-  double loopClosingCandidateDistance = distanceBetweenCones(m_map[0], cone);
-  //std::sqrt( (initialCone(0)-cone.getX())*(initialCone(0)-cone.getX()) + (initialCone(1)-cone.getY())*(initialCone(1)-cone.getY()));
-  if(loopClosingCandidateDistance < 1 && m_currentConeIndex > 20 && distance2car < m_coneMappingThreshold){ //Set threshold in congig ??
-    return true;
-  } 
-  return false;
-}
-
-double Slam::distanceBetweenCones(Cone c1, Cone c2){
-  double distance = std::sqrt( (c1.getX()-c2.getX())*(c1.getX()-c2.getX()) + (c1.getY()-c2.getY())*(c1.getY()-c2.getY()) );
-  return distance;
+  //With --poseRate the extrapolator sends the pose, a keyframe pose would go out of order on the same id
+  if(m_poseExtrapolator.isPublishing()){
+    return;
+  }
+  PublishBatch batch;
+  batch.hasPose = true;
+  {
+    std::lock_guard<std::mutex> lockSend(m_sendMutex); 
+    batch.pose = m_sendPose;
+  }
+  {
+    std::lock_guard<std::mutex> lockSensor(m_sensorMutex);
+    batch.sampleTime = m_geolocationReceivedTime;
+  }
+  m_publisher.publish(batch);
 }
 
 void Slam::updateMap(){
+  //Only landmarks the optimization moved further than the epsilon are written back
+  const double squaredEpsilon = m_mapUpdateEpsilon*m_mapUpdateEpsilon;
+  uint32_t moved = 0;
+  for(uint32_t j = 0; j < m_map.size(); j++){
+    Eigen::Vector2d updatedConeXY = (m_filter)?(m_filter->landmark(j)):(m_coneVertices[VertexIds::index(m_map.id(j))]->estimate());
+    double dx = updatedConeXY(0)-m_map.x(j);
+    double dy = updatedConeXY(1)-m_map.y(j);
+    if(dx*dx+dy*dy > squaredEpsilon){
+      m_map.setPosition(j,updatedConeXY(0),updatedConeXY(1));
+      moved++;
+    }
+  }
+  std::cout << "Optimization moved " << moved << " of " << m_map.size() << " landmarks" << std::endl;
+}
 
-  Eigen::Vector2d updatedConeXY;
-  g2o::VertexPointXY* updatedConeVertex;
-
-  for(uint32_t j = 0; j < m_map.size(); j++){//Iterate and replace old map landmarks with new updated ones
-    updatedConeVertex = static_cast<g2o::VertexPointXY*>(m_optimizer.vertex(j));
-    updatedConeXY = updatedConeVertex->estimate();
-
-    std::cout << "old x: "<<m_map[j].getX() << " old y: " << m_map[j].getY() << std::endl;
-
-    m_map[j].setX(updatedConeXY(0));
-    m_map[j].setY(updatedConeXY(1));
+void Slam::mergeLandmarks(){
+  //Cones mapped twice while the pose drifted end up on top of each other after optimization
+  if(m_map.version() == m_mergedVersion){
+    return;
+  }
+  std::vector<std::pair<uint32_t,uint32_t>> pairs;
+  if(m_map.pairsWithin(m_mergeThreshold,pairs) == 0){
+    m_mergedVersion = m_map.version();
+    return;
+  }
 
-    std::cout << "optimized x: "<<m_map[j].getX() << " optimized y: " << m_map[j].getY() << std::endl;
+  //Every landmark is merged into the first landmark of its group
+  std::vector<uint32_t> survivor(m_map.size());
+  for(uint32_t i = 0; i < survivor.size(); i++){
+    survivor[i] = i;
+  }
+  auto root = [&survivor](uint32_t i){
+    while(survivor[i] != i){
+      i = survivor[i];
+    }
+    return i;
+  };
+  for(auto const &pair : pairs){
+    uint32_t first = root(pair.first);
+    uint32_t second = root(pair.second);
+    if(first != second){
+      survivor[std::max(first,second)] = std::min(first,second);
+    }
   }
 
+  std::vector<bool> keep(m_map.size(),true);
+  std::map<int,int> mergedIds;
+  for(uint32_t j = 0; j < m_map.size(); j++){
+    uint32_t into = root(j);
+    if(into == j){
+      continue;
+    }
+    //Measurements of the merged landmark now constrain the one that is kept
+    g2o::VertexPointXY* fromVertex = m_coneVertices[VertexIds::index(m_map.id(j))];
+    g2o::VertexPointXY* intoVertex = m_coneVertices[VertexIds::index(m_map.id(into))];
+    g2o::HyperGraph::EdgeSet edges = fromVertex->edges();
+    for(g2o::HyperGraph::Edge* edge : edges){
+      //A pose that measured both landmarks keeps one edge, as the observation graph keeps one entry
+      g2o::HyperGraph::Vertex* poseVertex = edge->vertices()[0];
+      bool measuresInto = std::any_of(intoVertex->edges().begin(),intoVertex->edges().end(),
+          [poseVertex](g2o::HyperGraph::Edge* intoEdge){return intoEdge->vertices()[0] == poseVertex;});
+      if(measuresInto){
+        m_optimizer.removeEdge(edge);
+        continue;
+      }
+      for(uint32_t k = 0; k < edge->vertices().size(); k++){
+        if(edge->vertices()[k] == fromVertex){
+          m_optimizer.setEdgeVertex(edge,static_cast<int>(k),intoVertex);
+        }
+      }
+    }
+    m_optimizer.removeVertex(fromVertex);
+    m_coneVertices[VertexIds::index(m_map.id(j))] = nullptr;
+    m_map.merge(into,j);
+    intoVertex->setEstimate(Eigen::Vector2d(m_map.x(into),m_map.y(into)));
+    mergedIds[m_map.id(j)] = m_map.id(into);
+    keep[j] = false;
+  }
 
+  m_connectivityGraph.retarget(mergedIds);
 
+  uint32_t currentConeIndex = 0;
+  for(uint32_t j = 0; j < root(m_currentConeIndex); j++){
+    currentConeIndex += (keep[j])?(1):(0);
+  }
+  m_currentConeIndex = currentConeIndex;
+  m_map.compact(keep);
+  m_mergedVersion = m_map.version();
+  std::cout << "Merged " << mergedIds.size() << " landmarks, map size " << m_map.size() << std::endl;
 }
-   
-  
 
 void Slam::setUp(std::map<std::string, std::string> configuration)
 {
 
   m_timeDiffMilliseconds = static_cast<uint32_t>(std::stoi(configuration["gatheringTimeMs"]));
   m_newConeThreshold = static_cast<double>(std::stod(configuration["sameConeThreshold"]));
+  m_mergeThreshold = (configuration.count("mergeThreshold") != 0)?(static_cast<double>(std::stod(configuration["mergeThreshold"]))):(0.5);
+  m_mapUpdateEpsilon = (configuration.count("mapUpdateEpsilon") != 0)?(static_cast<double>(std::stod(configuration["mapUpdateEpsilon"]))):(0.01);
+  m_mapFile = (configuration.count("mapFile") != 0)?(configuration["mapFile"]):("");
+  m_graphFile = (configuration.count("graphFile") != 0)?(configuration["graphFile"]):("");
+  m_optimizerThreads = (configuration.count("optimizerThreads") != 0)?(static_cast<uint32_t>(std::stoi(configuration["optimizerThreads"]))):(1);
+  m_lidarOffset = (configuration.count("lidarOffset") != 0)?(static_cast<double>(std::stod(configuration["lidarOffset"]))):(1.5);
+  double rangeNoise = (configuration.count("rangeNoise") != 0)?(static_cast<double>(std::stod(configuration["rangeNoise"]))):(0.1);
+  double bearingNoise = ((configuration.count("bearingNoise") != 0)?(static_cast<double>(std::stod(configuration["bearingNoise"]))):(0.5))*DEG2RAD;
+  m_rangeInformation = 1.0/(rangeNoise*rangeNoise);
+  m_bearingInformation = 1.0/(bearingNoise*bearingNoise);
+  m_recentCones.setSameConeThreshold(m_newConeThreshold);
+  m_recentCones.setMaxMissedKeyframes((configuration.count("relocalizationKeyframes") != 0)?(static_cast<uint32_t>(std::stoi(configuration["relocalizationKeyframes"]))):(30));
+  m_relocalizationMinInliers = (configuration.count("relocalizationMinInliers") != 0)?(static_cast<uint32_t>(std::stoi(configuration["relocalizationMinInliers"]))):(15);
+  m_trackingLossKeyframes = (configuration.count("trackingLossKeyframes") != 0)?(static_cast<uint32_t>(std::stoi(configuration["trackingLossKeyframes"]))):(5);
+  m_coneTracker.setSameConeThreshold(m_newConeThreshold);
+  m_coneTracker.setConfirmations((configuration.count("coneConfirmations") != 0)?(static_cast<uint32_t>(std::stoi(configuration["coneConfirmations"]))):(3));
+  m_coneTracker.setMaxMissedKeyframes((configuration.count("coneCandidateKeyframes") != 0)?(static_cast<uint32_t>(std::stoi(configuration["coneCandidateKeyframes"]))):(5));
   m_gpsReference[0] = static_cast<double>(std::stod(configuration["refLatitude"]));
   m_gpsReference[1] = static_cast<double>(std::stod(configuration["refLongitude"]));
-  m_timeBetweenKeyframes = static_cast<double>(std::stod(configuration["timeBetweenKeyframes"]));
+  if(configuration.count("timeBetweenKeyframes") != 0){
+    m_keyframeSelector.setInterval(static_cast<double>(std::stod(configuration["timeBetweenKeyframes"])));
+  }
+  if(configuration.count("keyframeDistance") != 0){
+    m_keyframeSelector.setDistance(static_cast<double>(std::stod(configuration["keyframeDistance"])));
+  }
+  if(configuration.count("keyframeHeading") != 0){
+    m_keyframeSelector.setHeading(static_cast<double>(std::stod(configuration["keyframeHeading"])));
+  }
   m_coneMappingThreshold = static_cast<double>(std::stod(configuration["coneMappingThreshold"]));
   m_conesPerPacket = static_cast<int>(std::stoi(configuration["conesPerPacket"]));
   std::cout << "Cones per packet" << m_conesPerPacket << std::endl;
@@ -760,11 +1120,15 @@ std::vector<Eigen::Vector3d> Slam::drawPoses(){
   return m_poses;
 }
 
-std::vector<Cone> Slam::drawCones(){
+LandmarkStore Slam::drawCones(){
   std::lock_guard<std::mutex> lock(m_mapMutex);
   return m_map;
 }
 
+Eigen::Vector3d Slam::drawExtrapolatedPose(cluon::data::TimeStamp const &time){
+  return m_poseExtrapolator.extrapolate(time);
+}
+
 Eigen::Vector3d Slam::drawCurrentPose(){
   if(m_loopClosingComplete){
     std::lock_guard<std::mutex> lock(m_sendMutex);
@@ -776,7 +1140,7 @@ Eigen::Vector3d Slam::drawCurrentPose(){
   }
 }
 
-std::vector<std::vector<int>> Slam::drawGraph(){
+ObservationGraph Slam::drawGraph(){
   std::lock_guard<std::mutex> lock1(m_mapMutex);
   std::lock_guard<std::mutex> lock2(m_sensorMutex);
   return m_connectivityGraph;
@@ -20,6 +20,7 @@
 #ifndef SLAM_HPP
 #define SLAM_HPP
 
+#include <condition_variable>
 #include <tuple>
 #include <utility>
 #include <thread>
@@ -37,8 +38,25 @@
 #include "cluon-complete.hpp"
 #include "opendlv-standard-message-set.hpp"
 
-#include "cone.hpp"
+#include "landmarkstore.hpp"
+#include "conetracker.hpp"
+#include "keyframeselector.hpp"
+#include "vertexids.hpp"
+#include "observationgraph.hpp"
+#include "edgerangebearing.hpp"
+#include "placerecognizer.hpp"
+#include "relocalizer.hpp"
+#include "mapfile.hpp"
+#include "graphfile.hpp"
+#include "solver.hpp"
+#include "filterbackend.hpp"
+#include "poseextrapolator.hpp"
+#include "clock.hpp"
+#include "coneframe.hpp"
+#include "publisher.hpp"
 
+//One cone frame, rows are azimuth, zenith, distance and type. Stored inline, never on the heap
+typedef Eigen::Matrix<double,4,Eigen::Dynamic,Eigen::ColMajor,4,static_cast<int>(MAX_CONES_PER_FRAME)> ConeFrameMatrix;
 
 class Slam {
 
@@ -51,42 +69,56 @@ private:
  typedef std::tuple<opendlv::logic::perception::ObjectDirection,opendlv::logic::perception::ObjectDistance,opendlv::logic::perception::ObjectType> ConePackage;
 public:
   Slam(std::map<std::string, std::string> commandlineArguments,cluon::OD4Session &a_od4);
-  ~Slam() = default;
-  void nextCone(cluon::data::Envelope data);
-  void nextPose(cluon::data::Envelope data);
-  void nextSplitPose(cluon::data::Envelope data);
-  void nextYawRate(cluon::data::Envelope data);
-  std::vector<Cone> drawCones();
+  ~Slam();
+  void nextCone(cluon::data::Envelope const &data);
+  void nextConeFrame(Eigen::Ref<Eigen::MatrixXd const> const &cones, cluon::data::TimeStamp const &sampleTime);
+  void nextConeFrame(cluon::data::Envelope const &data);
+  void nextPose(cluon::data::Envelope const &data);
+  void nextSplitPose(cluon::data::Envelope const &data);
+  void nextYawRate(cluon::data::Envelope const &data);
+  //At the end of replayed input, closes the cone frame still being gathered
+  void flush();
+  LandmarkStore drawCones();
   std::vector<Eigen::Vector3d> drawPoses();
   Eigen::Vector3d drawCurrentPose();
-  std::vector<std::vector<int>> drawGraph();
+  //The pose as the fixed rate output would send it at time
+  Eigen::Vector3d drawExtrapolatedPose(cluon::data::TimeStamp const &time);
+  ObservationGraph drawGraph();
+  //Writes the pose graph to --graphFile, also done on destruction
+  bool saveGraph();
   
 
  private:
   void setUp(std::map<std::string, std::string> commandlineArguments);
   void setupOptimizer();
   void tearDown();
-  bool CheckContainer(uint32_t objectId, cluon::data::TimeStamp timeStamp);
-  bool isKeyframe();
-  void addOdometryMeasurement(Eigen::Vector3d pose);
+  void addOdometryMeasurement(Eigen::Vector3d const &pose);
   void optimizeGraph();
-  void localizer(Eigen::Vector3d pose, Eigen::MatrixXd cones);
+  void localizer(Eigen::Vector3d const &pose, Eigen::Vector3d const &odometryPose, Eigen::Ref<Eigen::MatrixXd const> const &cones);
   Eigen::Vector3d updatePoseFromGraph();
   Eigen::Vector3d updatePose(Eigen::Vector3d pose, Eigen::Vector2d errorDistance);
-  void addPoseToGraph(Eigen::Vector3d pose);
-  void performSLAM(Eigen::MatrixXd Cones);
-  Eigen::MatrixXd conesToGlobal(Eigen::Vector3d pose, Eigen::MatrixXd Cones);
-  Eigen::Vector3d coneToGlobal(Eigen::Vector3d pose, Eigen::MatrixXd Cone);
+  void addPoseToGraph(Eigen::Vector3d const &pose);
+  void performSLAM(Eigen::Ref<Eigen::MatrixXd const> const &cones, cluon::data::TimeStamp const &frameTimeStamp);
+  Eigen::Vector3d coneToGlobal(Eigen::Vector3d const &pose, Eigen::Vector4d const &cone);
 
   Eigen::Vector2d transformConeToCoG(double angle, double distance);
   Eigen::Vector3d Spherical2Cartesian(double azimuth, double zenimuth, double distance);
-  void addConesToMap(Eigen::MatrixXd cones, Eigen::Vector3d pose);
-  void addConeMeasurement(Cone cone, Eigen::Vector3d measurement);
-  void addConeToGraph(Cone cone, Eigen::Vector3d measurement);
-  void initializeCollection();
-  bool loopClosing(Cone cone,double distance2car);
-  double distanceBetweenCones(Cone c1, Cone c2);
+  void addConesToMap(Eigen::Ref<Eigen::MatrixXd const> const &cones, Eigen::Vector3d const &pose);
+  void addConeMeasurement(Cone const &cone, Eigen::Vector3d const &measurement);
+  void addConeMeasurement(Cone const &cone, Eigen::Vector3d const &measurement, int poseId);
+  void addConeToGraph(Cone const &cone, Eigen::Vector3d const &measurement);
+  void updateFilter();
+  int currentPoseId();
+  g2o::VertexPointXY *addLandmarkVertex(Cone const &cone);
+  void loadStoredMap();
+  bool relocalize(Eigen::Ref<Eigen::MatrixXd const> const &cones, Eigen::Vector3d const &pose);
+  void promoteCandidate(uint32_t candidate);
+  void startCollection();
+  void runCollector();
+  void collectCones();
+  void detectLoopClosure(Eigen::Ref<Eigen::MatrixXd const> const &cones, Eigen::Ref<Eigen::MatrixXd const> const &observed, std::array<uint32_t,MAX_CONES_PER_FRAME> const &observedColumns, std::array<int32_t,MAX_CONES_PER_FRAME> const &associated, Eigen::Vector3d const &pose);
   void updateMap();
+  void mergeLandmarks();
   void sendCones();
   void sendPose();
   //bool newCone(Eigen::MatrixXd cone,int poseId);
@@ -95,41 +127,95 @@ public:
 
   /*Member variables*/
   cluon::OD4Session &od4;
+  Clock m_clock;
+  PoseExtrapolator m_poseExtrapolator;
+  Publisher m_publisher;
   g2o::SparseOptimizer m_optimizer;
   int32_t m_timeDiffMilliseconds = 110;
   cluon::data::TimeStamp m_lastTimeStamp;
+  cluon::data::TimeStamp m_frameDeadline;
   Eigen::MatrixXd m_coneCollector;
+  Eigen::MatrixXd m_frameCones;
   uint32_t m_lastObjectId;
   std::mutex m_coneMutex;
   std::mutex m_sensorMutex;
   std::mutex m_mapMutex;
   std::mutex m_optimizerMutex;
   std::mutex m_yawMutex;
+  //Held from keyframe selection to the end of performSLAM
+  std::mutex m_frameMutex;
   Eigen::Vector3d m_odometryData;
   std::array<double,2> m_gpsReference;
-  std::vector<Cone> m_map;
+  LandmarkStore m_map;
+  ConeTracker m_coneTracker;
+  //Cones of the last keyframes in the odometry frame, for relocalization
+  ConeTracker m_recentCones;
   std::vector<Eigen::Vector3d> m_poses = {};
-  std::vector<std::vector<int>> m_connectivityGraph = {};
+  ObservationGraph m_connectivityGraph;
   double m_newConeThreshold= 1;
-  cluon::data::TimeStamp m_keyframeTimeStamp;
-  double m_timeBetweenKeyframes = 0.5;
+  double m_mergeThreshold = 0.5;
+  double m_mapUpdateEpsilon = 0.01;
+  uint64_t m_mergedVersion = 0;
+  PlaceRecognizer m_placeRecognizer;
+  LoopClosure m_loopClosure;
+  uint32_t m_lastLoopClosureKeyframe = 0;
+  uint32_t m_loopClosureCooldown = 10;
+  std::string m_mapFile = "";
+  std::string m_graphFile = "";
+  //Threads linearizing the cone edges of the graph, 1 keeps it on the calling thread
+  uint32_t m_optimizerThreads = 1;
+  bool m_mapLoaded = false;
+  bool m_relocalized = true;
+  //Odometry frame to stored map frame
+  g2o::SE2 m_mapOffset;
+  uint32_t m_relocalizationMinInliers = 15;
+  uint32_t m_lostKeyframes = 0;
+  uint32_t m_trackingLossKeyframes = 5;
+  Relocalizer m_relocalizer;
+  Relocalization m_relocalization;
+  KeyframeSelector m_keyframeSelector;
   double m_coneMappingThreshold = 67;
+  //Lidar ahead of the CoG and the information of its range and bearing
+  double m_lidarOffset = 1.5;
+  double m_rangeInformation = 100;
+  double m_bearingInformation = 13131;
   uint32_t m_currentConeIndex = 0;
-  int m_poseId = 1000;
+  VertexIds m_vertexIds;
+  //Vertices by their dense index, removed landmarks are left as nullptr
+  std::vector<g2o::VertexSE2*> m_poseVertices;
+  std::vector<g2o::VertexPointXY*> m_coneVertices;
+  //Vertices fixed by the first optimization
+  std::vector<int> m_anchorIds = {};
+  //Set with --backend, the pose graph is not used then
+  std::unique_ptr<FilterBackend> m_filter;
+  std::vector<FilterObservation> m_filterObservations;
+  uint32_t m_keyframes = 0;
   uint32_t m_conesPerPacket = 20;
   bool m_sendConeData = false;
   bool m_sendPoseData = false;
   bool m_newFrame;
+  //Set by the first complete cone frame, per-cone messages are ignored then
+  bool m_coneFrameInput = false;
   bool m_loopClosing = false;
   bool m_loopClosingComplete = false;
   Eigen::Vector3d m_sendPose;
   std::mutex m_sendMutex;
+  std::thread m_collector;
+  std::condition_variable m_collectorCondition;
+  bool m_collectionPending = false;
+  bool m_collectorRunning = true;
   uint32_t m_senderStamp = 0;
   float m_yawRate = 0.0f;
   cluon::data::TimeStamp m_yawReceivedTime = {};
   cluon::data::TimeStamp m_geolocationReceivedTime ={};
+  //Split pose messages since the last odometry sample
+  bool m_splitPositionUpdated = false;
+  bool m_splitHeadingUpdated = false;
   
 
+  //Highest objectId + 1 accepted from the per cone messages
+  static const uint32_t MAX_COLLECTED_CONES = 1000;
+
     // Constants for degree transformation
   const double DEG2RAD = 0.017453292522222; // PI/180.0
   const double RAD2DEG = 57.295779513082325; // 1.0 / DEG2RAD;
@@ -0,0 +1,72 @@
+/**
+ * Copyright (C) 2018 Chalmers Revere
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+
+#include "g2o/core/block_solver.h"
+#include "g2o/core/optimization_algorithm_factory.h"
+#include "g2o/core/optimization_algorithm_gauss_newton.h"
+#include "g2o/solvers/eigen/linear_solver_eigen.h"
+#include "solver.hpp"
+
+G2O_USE_OPTIMIZATION_LIBRARY(eigen);
+
+OptimizationAlgorithmParallelGaussNewton::OptimizationAlgorithmParallelGaussNewton(std::unique_ptr<SlamBlockSolver> solver, uint32_t threads):
+  g2o::OptimizationAlgorithmGaussNewton(std::move(solver))
+, m_threadPool(threads)
+, m_edges()
+, m_precompute()
+{
+  m_precompute = [this](uint32_t index){m_edges[index]->precompute();};
+}
+
+g2o::OptimizationAlgorithm::SolverResult OptimizationAlgorithmParallelGaussNewton::solve(int iteration, bool online)
+{
+  //The active edges only change when the optimization is initialized
+  if(iteration == 0){
+    m_edges.clear();
+    for(auto edge : _optimizer->activeEdges()){
+      EdgeRangeBearing *rangeBearing = dynamic_cast<EdgeRangeBearing*>(edge);
+      if(rangeBearing != nullptr){
+        m_edges.push_back(rangeBearing);
+      }
+    }
+  }
+  m_threadPool.run(static_cast<uint32_t>(m_edges.size()), m_precompute);
+  return g2o::OptimizationAlgorithmGaussNewton::solve(iteration, online);
+}
+
+g2o::OptimizationAlgorithm *makeOptimizationAlgorithm(std::string const &solver, bool blockOrdering, uint32_t threads)
+{
+  if(solver == "slam"){
+    typedef g2o::LinearSolverEigen<SlamBlockSolver::PoseMatrixType> SlamLinearSolver;
+    auto linearSolver = g2o::make_unique<SlamLinearSolver>();
+    linearSolver->setBlockOrdering(blockOrdering);
+    if(threads > 1){
+      return new OptimizationAlgorithmParallelGaussNewton(g2o::make_unique<SlamBlockSolver>(std::move(linearSolver)), threads);
+    }
+    return new g2o::OptimizationAlgorithmGaussNewton(g2o::make_unique<SlamBlockSolver>(std::move(linearSolver)));
+  }
+  g2o::OptimizationAlgorithmProperty property;
+  return g2o::OptimizationAlgorithmFactory::instance()->construct(solver, property);
+}
+
+void listOptimizationAlgorithms(std::ostream &out)
+{
+  out << "slam" << std::endl;
+  g2o::OptimizationAlgorithmFactory::instance()->listSolvers(out);
+}
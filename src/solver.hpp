@@ -0,0 +1,72 @@
+/**
+ * Copyright (C) 2018 Chalmers Revere
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+
+#ifndef SOLVER_HPP
+#define SOLVER_HPP
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "g2o/core/sparse_optimizer.h"
+#include "g2o/core/block_solver.h"
+#include "g2o/core/optimization_algorithm_gauss_newton.h"
+#include "edgerangebearing.hpp"
+#include "threadpool.hpp"
+
+typedef g2o::BlockSolver<g2o::BlockSolverTraits<-1, -1> > SlamBlockSolver;
+
+/*
+ * Gauss-Newton that evaluates the errors and Jacobians of the range and
+ * bearing edges on a thread pool before each iteration. g2o then builds and
+ * solves the system on one thread in its own edge order, taking the values
+ * each edge already holds, so the result is the same bit for bit as with
+ * one thread. Other edges are linearized by g2o as before.
+ */
+class OptimizationAlgorithmParallelGaussNewton : public g2o::OptimizationAlgorithmGaussNewton {
+ private:
+  OptimizationAlgorithmParallelGaussNewton(const OptimizationAlgorithmParallelGaussNewton &) = delete;
+  OptimizationAlgorithmParallelGaussNewton(OptimizationAlgorithmParallelGaussNewton &&)      = delete;
+  OptimizationAlgorithmParallelGaussNewton &operator=(const OptimizationAlgorithmParallelGaussNewton &) = delete;
+  OptimizationAlgorithmParallelGaussNewton &operator=(OptimizationAlgorithmParallelGaussNewton &&) = delete;
+ public:
+  OptimizationAlgorithmParallelGaussNewton(std::unique_ptr<SlamBlockSolver> solver, uint32_t threads);
+  SolverResult solve(int iteration, bool online = false) override;
+
+ private:
+  ThreadPool m_threadPool;
+  std::vector<EdgeRangeBearing*> m_edges;
+  std::function<void(uint32_t)> m_precompute;
+};
+
+/*
+ * Optimization algorithms by name. "slam" is the one Slam optimizes with:
+ * Gauss-Newton on the Eigen sparse Cholesky with variable block sizes, with
+ * or without block ordering, on more than one thread the parallel variant
+ * above. Any other name is constructed by the g2o solver factory, such as
+ * lm_var_eigen, with the ordering and threading that solver comes with.
+ * Returns nullptr for an unknown name, the optimizer takes ownership.
+ */
+g2o::OptimizationAlgorithm *makeOptimizationAlgorithm(std::string const &solver, bool blockOrdering, uint32_t threads = 1);
+void listOptimizationAlgorithms(std::ostream &out);
+
+#endif
@@ -0,0 +1,166 @@
+/**
+ * Copyright (C) 2018 Chalmers Revere
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+
+#include "threadpool.hpp"
+
+ThreadPool::Block::Block():
+  mutex()
+, begin(0)
+, end(0)
+{
+}
+
+ThreadPool::ThreadPool(uint32_t threads):
+  m_threads((threads > 0)?(threads):(std::thread::hardware_concurrency()))
+, m_blocks()
+, m_workers()
+, m_task(nullptr)
+, m_mutex()
+, m_start()
+, m_done()
+, m_generation(0)
+, m_working(0)
+, m_running(true)
+{
+  m_threads = (m_threads > 0)?(m_threads):(1);
+  for(uint32_t i = 0; i < m_threads; i++){
+    m_blocks.push_back(std::unique_ptr<Block>(new Block()));
+  }
+  //Thread 0 is the caller of run
+  for(uint32_t i = 1; i < m_threads; i++){
+    m_workers.push_back(std::thread(&ThreadPool::work,this,i));
+  }
+}
+
+ThreadPool::~ThreadPool()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_running = false;
+  }
+  m_start.notify_all();
+  for(auto &worker : m_workers){
+    worker.join();
+  }
+}
+
+uint32_t ThreadPool::threads() const
+{
+  return m_threads;
+}
+
+void ThreadPool::run(uint32_t count, std::function<void(uint32_t)> const &task)
+{
+  if(m_threads == 1 || count < 2){
+    for(uint32_t i = 0; i < count; i++){
+      task(i);
+    }
+    return;
+  }
+  for(uint32_t i = 0; i < m_threads; i++){
+    std::lock_guard<std::mutex> lock(m_blocks[i]->mutex);
+    m_blocks[i]->begin = static_cast<uint32_t>(static_cast<uint64_t>(count)*i/m_threads);
+    m_blocks[i]->end = static_cast<uint32_t>(static_cast<uint64_t>(count)*(i+1)/m_threads);
+  }
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_task = &task;
+    m_working = m_threads-1;
+    m_generation++;
+  }
+  m_start.notify_all();
+  drain(0);
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_done.wait(lock, [this]{return m_working == 0;});
+  m_task = nullptr;
+}
+
+void ThreadPool::work(uint32_t thread)
+{
+  uint64_t generation = 0;
+  while(true){
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_start.wait(lock, [this,generation]{return !m_running || m_generation != generation;});
+      if(!m_running){
+        return;
+      }
+      generation = m_generation;
+    }
+    drain(thread);
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_working--;
+    }
+    m_done.notify_one();
+  }
+}
+
+void ThreadPool::drain(uint32_t thread)
+{
+  uint32_t index;
+  while(next(thread,index) || (steal(thread) && next(thread,index))){
+    (*m_task)(index);
+  }
+}
+
+bool ThreadPool::next(uint32_t thread, uint32_t &index)
+{
+  Block &block = *m_blocks[thread];
+  std::lock_guard<std::mutex> lock(block.mutex);
+  if(block.begin == block.end){
+    return false;
+  }
+  index = block.begin++;
+  return true;
+}
+
+bool ThreadPool::steal(uint32_t thread)
+{
+  //The largest block is split, the back half becomes the own block
+  while(true){
+    uint32_t victim = thread;
+    uint32_t largest = 0;
+    for(uint32_t i = 0; i < m_threads; i++){
+      std::lock_guard<std::mutex> lock(m_blocks[i]->mutex);
+      if(i != thread && m_blocks[i]->end-m_blocks[i]->begin > largest){
+        victim = i;
+        largest = m_blocks[i]->end-m_blocks[i]->begin;
+      }
+    }
+    if(victim == thread){
+      return false;
+    }
+    Block &from = *m_blocks[victim];
+    Block &to = *m_blocks[thread];
+    std::lock(from.mutex, to.mutex);
+    std::lock_guard<std::mutex> lockFrom(from.mutex, std::adopt_lock);
+    std::lock_guard<std::mutex> lockTo(to.mutex, std::adopt_lock);
+    uint32_t remaining = from.end-from.begin;
+    if(remaining == 0){
+      //Taken by its owner in the meantime, look again
+      continue;
+    }
+    uint32_t taken = (remaining+1)/2;
+    to.begin = from.end-taken;
+    to.end = from.end;
+    from.end -= taken;
+    return true;
+  }
+}
@@ -0,0 +1,77 @@
+/**
+ * Copyright (C) 2018 Chalmers Revere
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+
+#ifndef THREADPOOL_HPP
+#define THREADPOOL_HPP
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ * Runs a task for every index of a range on a fixed set of threads, the
+ * calling thread included. Each thread starts on its own contiguous block of
+ * indices and takes them from the front; a thread that runs out steals the
+ * back half of the block of another one. Which thread runs an index is not
+ * fixed, so a task must only depend on its index. No allocation per run.
+ */
+class ThreadPool {
+ private:
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool(ThreadPool &&)      = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+  ThreadPool &operator=(ThreadPool &&) = delete;
+ public:
+  //0 for one thread per core
+  ThreadPool(uint32_t threads);
+  ~ThreadPool();
+  //Returns when task has been called for all of [0, count)
+  void run(uint32_t count, std::function<void(uint32_t)> const &task);
+  uint32_t threads() const;
+
+ private:
+  struct Block {
+    Block();
+    std::mutex mutex;
+    uint32_t begin;
+    uint32_t end;
+  };
+
+  void work(uint32_t thread);
+  void drain(uint32_t thread);
+  bool next(uint32_t thread, uint32_t &index);
+  bool steal(uint32_t thread);
+
+  uint32_t m_threads;
+  std::vector<std::unique_ptr<Block>> m_blocks;
+  std::vector<std::thread> m_workers;
+  std::function<void(uint32_t)> const *m_task;
+  std::mutex m_mutex;
+  std::condition_variable m_start;
+  std::condition_variable m_done;
+  uint64_t m_generation;
+  uint32_t m_working;
+  bool m_running;
+};
+
+#endif
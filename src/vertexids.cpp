@@ -0,0 +1,66 @@
+/**
+ * Copyright (C) 2018 Chalmers Revere
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+
+#include "vertexids.hpp"
+
+VertexIds::VertexIds():
+  m_landmarks(0)
+, m_poses(0)
+{
+}
+
+int VertexIds::nextLandmark()
+{
+  return landmarkId(m_landmarks++);
+}
+
+int VertexIds::nextPose()
+{
+  return poseId(m_poses++);
+}
+
+uint32_t VertexIds::landmarks() const
+{
+  return m_landmarks;
+}
+
+uint32_t VertexIds::poses() const
+{
+  return m_poses;
+}
+
+bool VertexIds::isPose(int id)
+{
+  return (id % 2) == 1;
+}
+
+uint32_t VertexIds::index(int id)
+{
+  return static_cast<uint32_t>(id/2);
+}
+
+int VertexIds::landmarkId(uint32_t index)
+{
+  return static_cast<int>(2*index);
+}
+
+int VertexIds::poseId(uint32_t index)
+{
+  return static_cast<int>(2*index+1);
+}
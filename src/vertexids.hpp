@@ -0,0 +1,49 @@
+/**
+ * Copyright (C) 2018 Chalmers Revere
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+
+#ifndef VERTEXIDS_HPP
+#define VERTEXIDS_HPP
+
+#include <cstdint>
+
+/*
+ * Vertex ids of the graph. Landmarks get the even and poses the odd ids, each
+ * counted from zero, so the two never collide whatever the size of the map.
+ * id/2 is the dense index of a vertex among its own kind and indexes the
+ * vertex tables in Slam directly.
+ */
+class VertexIds {
+ public:
+  VertexIds();
+  int nextLandmark();
+  int nextPose();
+  uint32_t landmarks() const;
+  uint32_t poses() const;
+
+  static bool isPose(int id);
+  static uint32_t index(int id);
+  static int landmarkId(uint32_t index);
+  static int poseId(uint32_t index);
+
+ private:
+  uint32_t m_landmarks;
+  uint32_t m_poses;
+};
+
+#endif
@@ -0,0 +1,238 @@
+/**
+ * Copyright (C) 2018 Chalmers Revere
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "cluon-complete.hpp"
+#include "opendlv-standard-message-set.hpp"
+#include "WGS84toCartesian.hpp"
+#include "slam.hpp"
+#include "synthetictrack.hpp"
+
+/*
+ * Replays the same noisy laps of a synthetic track through Slam once per
+ * backend and compares the time a keyframe takes and how far the mapped
+ * cones end up from the true ones. Odometry drifts in heading and cone
+ * distances and azimuths are noisy, both from a fixed seed.
+ *
+ *   opendlv-logic-cfsd18-sensation-slam-benchmark [--laps=3] [--backends=graph,ekf,fastslam]
+ *     [--headingDrift=0.0005] [--distanceNoise=0.05] [--azimuthNoise=0.5] [Slam options...]
+ */
+namespace {
+template <typename T>
+cluon::data::Envelope toEnvelope(T &message, cluon::data::TimeStamp const &sampleTime, uint32_t senderStamp)
+{
+  cluon::ToProtoVisitor encoder;
+  message.accept(encoder);
+  cluon::data::Envelope envelope;
+  envelope.dataType(static_cast<int32_t>(message.ID()));
+  envelope.serializedData(encoder.encodedData());
+  envelope.sent(sampleTime);
+  envelope.sampleTimeStamp(sampleTime);
+  envelope.senderStamp(senderStamp);
+  return envelope;
+}
+
+//GPS position that Slam converts back to exactly x and y, the conversions are not each others inverse
+std::array<double,2> toGps(std::array<double,2> const &reference, double x, double y)
+{
+  std::array<double,2> target = {{x, y}};
+  std::array<double,2> gps = wgs84::fromCartesian(reference, target);
+  for(uint32_t i = 0; i < 10; i++){
+    std::array<double,2> position = wgs84::toCartesian(reference, gps);
+    target[0] += x-position[0];
+    target[1] += y-position[1];
+    gps = wgs84::fromCartesian(reference, target);
+  }
+  return gps;
+}
+
+struct Frame {
+  Frame() : cones(), pose() {}
+  std::vector<cluon::data::Envelope> cones;
+  cluon::data::Envelope pose;
+};
+
+struct Result {
+  Result() : keyframes(0), meanLatency(0), medianLatency(0), p99Latency(0), maxLatency(0), cones(0), meanError(0), maxError(0) {}
+  uint32_t keyframes;
+  double meanLatency;
+  double medianLatency;
+  double p99Latency;
+  double maxLatency;
+  uint32_t cones;
+  double meanError;
+  double maxError;
+};
+
+Result run(std::string const &backend, std::map<std::string, std::string> configuration, std::vector<Frame> const &frames, SyntheticTrack const &track)
+{
+  configuration["backend"] = backend;
+  cluon::OD4Session od4{253};
+  Slam slam(configuration, od4);
+
+  std::vector<double> latencies;
+  uint64_t poses = 0;
+  for(Frame const &frame : frames){
+    for(uint32_t m = 0; m < frame.cones.size(); m++){
+      //The first message of a frame closes the previous one
+      auto start = std::chrono::steady_clock::now();
+      slam.nextCone(frame.cones[m]);
+      auto stop = std::chrono::steady_clock::now();
+      if(m == 0){
+        uint64_t newPoses = slam.drawPoses().size();
+        if(newPoses > poses){
+          latencies.push_back(std::chrono::duration<double, std::micro>(stop-start).count());
+        }
+        poses = newPoses;
+        slam.nextPose(frame.pose);
+      }
+    }
+  }
+
+  Result result;
+  result.keyframes = static_cast<uint32_t>(latencies.size());
+  if(!latencies.empty()){
+    for(double latency : latencies){
+      result.meanLatency += latency/static_cast<double>(latencies.size());
+    }
+    std::sort(latencies.begin(), latencies.end());
+    //The tail also holds preemptions by the threads of Slam and OD4, the median does not
+    result.medianLatency = latencies[latencies.size()/2];
+    result.p99Latency = latencies[latencies.size()*99/100];
+    result.maxLatency = latencies.back();
+  }
+  //Error of every mapped cone to the closest true cone of its class
+  LandmarkStore map = slam.drawCones();
+  result.cones = map.size();
+  for(uint32_t i = 0; i < map.size(); i++){
+    double error = 1e9;
+    for(auto const &cone : track.cones()){
+      if(static_cast<int>(cone(2)) == map.type(i)){
+        error = std::min(error, std::sqrt((cone(0)-map.x(i))*(cone(0)-map.x(i))+(cone(1)-map.y(i))*(cone(1)-map.y(i))));
+      }
+    }
+    result.meanError += error/static_cast<double>(map.size());
+    result.maxError = std::max(result.maxError, error);
+  }
+  return result;
+}
+}
+
+int32_t main(int32_t argc, char **argv)
+{
+  auto commandlineArguments = cluon::getCommandlineArguments(argc, argv);
+  const uint32_t laps = (commandlineArguments.count("laps") != 0)?(static_cast<uint32_t>(std::stoi(commandlineArguments["laps"]))):(3);
+  std::string backends = (commandlineArguments.count("backends") != 0)?(commandlineArguments["backends"]):("graph,ekf,fastslam");
+  const double speed = 8.0;
+  const double frameRate = 10.0;
+  const std::array<double,2> reference = {{57.71, 11.94}};
+
+  std::map<std::string, std::string> configuration = {
+    {"cid", "253"}, {"id", "120"}, {"detectConeId", "118"}, {"estimationId", "114"},
+    {"gatheringTimeMs", "50"}, {"sameConeThreshold", "1.2"}, {"refLatitude", "57.71"}, {"refLongitude", "11.94"},
+    {"coneMappingThreshold", "12"}, {"conesPerPacket", "20"}, {"replay", "1"}};
+  //Other options are passed on to Slam, such as --particles or --measurementNoise
+  for(auto const &argument : commandlineArguments){
+    if(argument.first != "laps" && argument.first != "backends" && argument.first != "headingDrift" && argument.first != "distanceNoise" && argument.first != "azimuthNoise"){
+      configuration[argument.first] = argument.second;
+    }
+  }
+
+  //Same noise for every backend
+  SyntheticTrack track;
+  std::mt19937 generator(42);
+  std::normal_distribution<double> distanceNoise(0.0, (commandlineArguments.count("distanceNoise") != 0)?(std::stod(commandlineArguments["distanceNoise"])):(0.05));
+  std::normal_distribution<double> azimuthNoise(0.0, (commandlineArguments.count("azimuthNoise") != 0)?(std::stod(commandlineArguments["azimuthNoise"])):(0.5));
+  const double headingDrift = (commandlineArguments.count("headingDrift") != 0)?(std::stod(commandlineArguments["headingDrift"])):(0.0005);
+  const uint32_t framesPerLap = static_cast<uint32_t>(track.length()/speed*frameRate);
+  const uint32_t numberOfFrames = laps*framesPerLap;
+  std::vector<Frame> frames(numberOfFrames);
+  Eigen::Vector3d odometry = track.poseAt(0);
+  Eigen::Vector3d previous = odometry;
+  for(uint32_t k = 0; k < numberOfFrames; k++){
+    cluon::data::TimeStamp sampleTime = cluon::time::fromMicroseconds(1000000+static_cast<int64_t>(k*1000000/frameRate));
+    Eigen::Vector3d pose = track.poseAt(k*speed/frameRate);
+    //Odometry integrates the true motion with a slowly drifting heading
+    if(k > 0){
+      double dx = pose(0)-previous(0);
+      double dy = pose(1)-previous(1);
+      double turn = std::atan2(std::sin(pose(2)-previous(2)), std::cos(pose(2)-previous(2)));
+      double forward = std::cos(previous(2))*dx+std::sin(previous(2))*dy;
+      double left = -std::sin(previous(2))*dx+std::cos(previous(2))*dy;
+      odometry(0) += std::cos(odometry(2))*forward-std::sin(odometry(2))*left;
+      odometry(1) += std::sin(odometry(2))*forward+std::cos(odometry(2))*left;
+      odometry(2) += turn+headingDrift;
+    }
+    previous = pose;
+    std::array<double,2> gps = toGps(reference, odometry(0), odometry(1));
+    opendlv::logic::sensation::Geolocation geolocation;
+    geolocation.latitude(gps[0]).longitude(gps[1]).heading(static_cast<float>(odometry(2)));
+    frames[k].pose = toEnvelope(geolocation, sampleTime, 114);
+
+    Eigen::MatrixXd observations = track.observe(pose, 12.0, 120.0);
+    for(uint32_t i = 0; i < observations.cols(); i++){
+      opendlv::logic::perception::ObjectDirection direction;
+      direction.objectId(i).azimuthAngle(static_cast<float>(observations(0,i)+azimuthNoise(generator))).zenithAngle(static_cast<float>(observations(1,i)));
+      opendlv::logic::perception::ObjectDistance distance;
+      distance.objectId(i).distance(static_cast<float>(observations(2,i)+distanceNoise(generator)));
+      opendlv::logic::perception::ObjectType type;
+      type.objectId(i).type(static_cast<uint32_t>(observations(3,i)));
+      frames[k].cones.push_back(toEnvelope(direction, sampleTime, 118));
+      frames[k].cones.push_back(toEnvelope(distance, sampleTime, 118));
+      frames[k].cones.push_back(toEnvelope(type, sampleTime, 118));
+    }
+  }
+
+  //Slam prints a lot, keep the formatting but not the output
+  std::ofstream devNull("/dev/null");
+  std::streambuf *coutBuffer = std::cout.rdbuf(devNull.rdbuf());
+  std::vector<std::pair<std::string, Result>> results;
+  std::size_t position = 0;
+  while(position <= backends.size()){
+    std::size_t end = std::min(backends.find(',', position), backends.size());
+    std::string backend = backends.substr(position, end-position);
+    results.push_back(std::make_pair(backend, run(backend, configuration, frames, track)));
+    position = end+1;
+  }
+  std::cout.rdbuf(coutBuffer);
+
+  bool ok = true;
+  std::cerr << numberOfFrames << " frames, " << track.cones().size() << " true cones" << std::endl;
+  std::cerr << std::left << std::setw(8) << "backend" << std::right << std::setw(10) << "keyframes" << std::setw(12) << "mean [us]" << std::setw(12) << "median [us]" << std::setw(12) << "p99 [us]"
+            << std::setw(12) << "max [us]" << std::setw(8) << "cones" << std::setw(14) << "mean err [m]" << std::setw(13) << "max err [m]" << std::endl;
+  for(auto const &result : results){
+    Result const &r = result.second;
+    std::cerr << std::left << std::setw(8) << result.first << std::right << std::fixed << std::setprecision(1) << std::setw(10) << r.keyframes << std::setw(12) << r.meanLatency << std::setw(12) << r.medianLatency
+              << std::setw(12) << r.p99Latency << std::setw(12) << r.maxLatency << std::setw(8) << r.cones << std::setprecision(3) << std::setw(14) << r.meanError
+              << std::setw(13) << r.maxError << std::endl;
+    ok = ok && r.cones > 0;
+  }
+  return (ok)?(0):(1);
+}
@@ -0,0 +1,190 @@
+/**
+ * Copyright (C) 2018 Chalmers Revere
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <random>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "cluon-complete.hpp"
+#include "g2o/core/sparse_optimizer.h"
+#include "g2o/types/slam2d/vertex_se2.h"
+#include "g2o/types/slam2d/vertex_point_xy.h"
+#include "g2o/types/slam2d/edge_se2.h"
+#include "edgerangebearing.hpp"
+#include "solver.hpp"
+#include "synthetictrack.hpp"
+
+/*
+ * Optimizes the same pose graph with the edges linearized on one thread and
+ * on more, and checks that every edge ends with the same error and Jacobians
+ * bit for bit. The graph is a pose per metre over a number of laps of a
+ * synthetic track, with odometry edges between them and a range and bearing
+ * edge to every cone in view, about 850 edges per lap.
+ *
+ *   opendlv-logic-cfsd18-sensation-slam-linearization-benchmark [--laps=20] [--threads=<cores>] [--iterations=10] [--runs=5]
+ */
+namespace {
+const double DEG2RAD = 0.017453292522222; // PI/180.0
+
+typedef std::map<std::pair<int,int>,std::vector<double>> EdgeValues;
+
+struct Run {
+  Run() : optimizeTime(0), chi2(0), edges(0), values() {}
+  double optimizeTime;
+  double chi2;
+  uint32_t edges;
+  EdgeValues values;
+};
+
+Run run(SyntheticTrack const &track, uint32_t laps, uint32_t threads, int iterations)
+{
+  g2o::SparseOptimizer optimizer;
+  optimizer.setAlgorithm(makeOptimizationAlgorithm("slam", false, threads));
+
+  //Odometry drifts in heading and cones are seen with noise, the same for every run
+  std::mt19937 generator(42);
+  std::normal_distribution<double> rangeNoise(0.0, 0.1);
+  std::normal_distribution<double> bearingNoise(0.0, 0.5*DEG2RAD);
+  const int numberOfPoses = static_cast<int>(laps*track.length());
+  const int firstCone = numberOfPoses;
+  for(uint32_t j = 0; j < track.cones().size(); j++){
+    g2o::VertexPointXY *cone = new g2o::VertexPointXY();
+    cone->setId(firstCone+static_cast<int>(j));
+    cone->setEstimate(Eigen::Vector2d(track.cones()[j](0)+0.3, track.cones()[j](1)-0.2));
+    optimizer.addVertex(cone);
+  }
+  const double lidarOffset = 1.5;
+  for(int i = 0; i < numberOfPoses; i++){
+    Eigen::Vector3d truth = track.poseAt(static_cast<double>(i));
+    g2o::VertexSE2 *pose = new g2o::VertexSE2();
+    pose->setId(i);
+    pose->setEstimate(g2o::SE2(truth(0), truth(1), truth(2)+0.0005*i));
+    pose->setFixed(i == 0);
+    optimizer.addVertex(pose);
+    if(i > 0){
+      Eigen::Vector3d previous = track.poseAt(static_cast<double>(i-1));
+      g2o::EdgeSE2 *odometry = new g2o::EdgeSE2();
+      odometry->vertices()[0] = optimizer.vertex(i-1);
+      odometry->vertices()[1] = pose;
+      odometry->setMeasurement(g2o::SE2(previous(0), previous(1), previous(2)).inverse()*g2o::SE2(truth(0), truth(1), truth(2)));
+      odometry->setInformation(Eigen::Matrix3d::Identity()*100);
+      optimizer.addEdge(odometry);
+    }
+    for(uint32_t j = 0; j < track.cones().size(); j++){
+      Eigen::Vector3d const &cone = track.cones()[j];
+      double dx = std::cos(truth(2))*(cone(0)-truth(0))+std::sin(truth(2))*(cone(1)-truth(1))-lidarOffset;
+      double dy = -std::sin(truth(2))*(cone(0)-truth(0))+std::cos(truth(2))*(cone(1)-truth(1));
+      double range = std::sqrt(dx*dx+dy*dy);
+      double bearing = std::atan2(dy, dx);
+      if(range > 12.0 || std::fabs(bearing) > 60.0*DEG2RAD){
+        continue;
+      }
+      EdgeRangeBearing *measurement = new EdgeRangeBearing();
+      measurement->vertices()[0] = pose;
+      measurement->vertices()[1] = optimizer.vertex(firstCone+static_cast<int>(j));
+      measurement->setSensorOffset(Eigen::Vector2d(lidarOffset, 0));
+      measurement->setMeasurement(Eigen::Vector2d(range+rangeNoise(generator), bearing+bearingNoise(generator)));
+      measurement->setInformation(Eigen::Vector2d(100, 13131).asDiagonal());
+      optimizer.addEdge(measurement);
+    }
+  }
+
+  Run result;
+  auto start = std::chrono::steady_clock::now();
+  optimizer.initializeOptimization();
+  optimizer.optimize(iterations);
+  result.optimizeTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now()-start).count();
+  optimizer.computeActiveErrors();
+  result.chi2 = optimizer.activeChi2();
+  result.edges = static_cast<uint32_t>(optimizer.edges().size());
+  //Edge order follows addresses, so the edges are compared by pose and cone and
+  //the total chi2 may differ in the last bits between any two runs
+  for(auto edge : optimizer.activeEdges()){
+    EdgeRangeBearing *rangeBearing = dynamic_cast<EdgeRangeBearing*>(edge);
+    if(rangeBearing == nullptr){
+      continue;
+    }
+    std::vector<double> &values = result.values[std::make_pair(edge->vertices()[0]->id(), edge->vertices()[1]->id())];
+    values.insert(values.end(), rangeBearing->error().data(), rangeBearing->error().data()+2);
+    values.insert(values.end(), rangeBearing->jacobianOplusXi().data(), rangeBearing->jacobianOplusXi().data()+6);
+    values.insert(values.end(), rangeBearing->jacobianOplusXj().data(), rangeBearing->jacobianOplusXj().data()+4);
+  }
+  return result;
+}
+
+bool identical(Run const &a, Run const &b)
+{
+  if(a.values.size() != b.values.size()){
+    return false;
+  }
+  for(auto const &edge : a.values){
+    auto other = b.values.find(edge.first);
+    if(other == b.values.end() || other->second.size() != edge.second.size() ||
+       std::memcmp(edge.second.data(), other->second.data(), edge.second.size()*sizeof(double)) != 0){
+      return false;
+    }
+  }
+  return true;
+}
+}
+
+int32_t main(int32_t argc, char **argv)
+{
+  auto commandlineArguments = cluon::getCommandlineArguments(argc, argv);
+  const uint32_t laps = (commandlineArguments.count("laps") != 0)?(static_cast<uint32_t>(std::stoi(commandlineArguments["laps"]))):(20);
+  const uint32_t threads = (commandlineArguments.count("threads") != 0)?(static_cast<uint32_t>(std::stoi(commandlineArguments["threads"]))):(std::max(2u, std::thread::hardware_concurrency()));
+  const int iterations = (commandlineArguments.count("iterations") != 0)?(std::stoi(commandlineArguments["iterations"])):(10);
+  const uint32_t runs = (commandlineArguments.count("runs") != 0)?(static_cast<uint32_t>(std::stoi(commandlineArguments["runs"]))):(5);
+
+  SyntheticTrack track;
+  Run reference;
+  bool ok = true;
+  for(uint32_t threadCount : {1u, threads}){
+    double mean = 0;
+    double fastest = 0;
+    for(uint32_t i = 0; i < runs; i++){
+      Run result = run(track, laps, threadCount, iterations);
+      mean += result.optimizeTime/static_cast<double>(runs);
+      fastest = (i == 0)?(result.optimizeTime):(std::min(fastest, result.optimizeTime));
+      if(threadCount == 1 && i == 0){
+        reference = result;
+        std::cout << result.edges << " edges, " << result.values.size() << " of them range and bearing, " << iterations << " iterations, chi2 " << result.chi2 << std::endl;
+      }
+      else if(!identical(reference, result)){
+        std::cerr << threadCount << " threads, run " << i << ": edges differ from one thread" << std::endl;
+        ok = false;
+      }
+    }
+    std::cout << std::setw(3) << threadCount << " threads: mean " << std::fixed << std::setprecision(3) << mean << " ms, min " << fastest << " ms" << std::endl;
+  }
+  if(ok){
+    std::cout << "All runs match one thread bit for bit" << std::endl;
+  }
+  return (ok)?(0):(1);
+}
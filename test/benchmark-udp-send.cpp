@@ -0,0 +1,109 @@
+/**
+ * Copyright (C) 2018 Chalmers Revere
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "cluon-complete.hpp"
+#include "opendlv-standard-message-set.hpp"
+
+/*
+ * Loopback benchmark of envelopes per second, one sendto per envelope versus
+ * bursts sent with UDPSender::send(std::vector<std::string>&&). A burst has
+ * the size of a cone frame in the legacy output: three envelopes per cone.
+ * With --batchReceive=1 the receiving side uses the recvmmsg batch mode.
+ */
+static std::string coneEnvelope(uint32_t i)
+{
+  opendlv::logic::perception::ObjectDirection directionMsg;
+  directionMsg.objectId(i);
+  directionMsg.azimuthAngle(static_cast<float>(i));
+  directionMsg.zenithAngle(0.0f);
+  cluon::ToProtoVisitor protoEncoder;
+  directionMsg.accept(protoEncoder);
+  cluon::data::Envelope envelope;
+  envelope.dataType(opendlv::logic::perception::ObjectDirection::ID());
+  envelope.serializedData(protoEncoder.encodedData());
+  envelope.sent(cluon::time::now());
+  envelope.sampleTimeStamp(envelope.sent());
+  return cluon::serializeEnvelope(std::move(envelope));
+}
+
+int32_t main(int32_t argc, char **argv)
+{
+  auto commandlineArguments = cluon::getCommandlineArguments(argc, argv);
+  const uint32_t envelopes = (commandlineArguments.count("envelopes") != 0)?(static_cast<uint32_t>(std::stoi(commandlineArguments["envelopes"]))):(200000);
+  const uint32_t burst = (commandlineArguments.count("burst") != 0)?(static_cast<uint32_t>(std::stoi(commandlineArguments["burst"]))):(120);
+  const uint16_t port = (commandlineArguments.count("port") != 0)?(static_cast<uint16_t>(std::stoi(commandlineArguments["port"]))):(12176);
+
+  const bool batchReceive = (commandlineArguments.count("batchReceive") != 0)?(std::stoi(commandlineArguments["batchReceive"]) != 0):(false);
+
+  std::atomic<uint32_t> received{0};
+  std::unique_ptr<cluon::UDPReceiver> receiver;
+  if(batchReceive){
+    receiver.reset(new cluon::UDPReceiver("127.0.0.1", port,
+      [&received](std::vector<cluon::UDPReceiver::Datagram> &&batch){
+        received += static_cast<uint32_t>(batch.size());
+      }));
+  }
+  else{
+    receiver.reset(new cluon::UDPReceiver("127.0.0.1", port,
+      [&received](std::string &&, std::string &&, std::chrono::system_clock::time_point &&){
+        received++;
+      }));
+  }
+  cluon::UDPSender sender("127.0.0.1", port);
+
+  std::vector<std::string> frame;
+  for(uint32_t i = 0; i < burst; i++){
+    frame.push_back(coneEnvelope(i));
+  }
+
+  for(int batched = 0; batched < 2; batched++){
+    received = 0;
+    std::vector<std::string> batch;
+    batch.reserve(burst);
+    uint32_t sent = 0;
+    auto start = std::chrono::steady_clock::now();
+    for(; sent < envelopes; sent += burst){
+      if(batched){
+        batch = frame;
+        sender.send(std::move(batch));
+      }
+      else{
+        for(uint32_t i = 0; i < burst; i++){
+          std::string data = frame[i];
+          sender.send(std::move(data));
+        }
+      }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count();
+    //Let the receiver drain its socket before counting
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    std::cout << ((batched)?("batched  "):("single   ")) << static_cast<double>(sent)/seconds << " envelopes/s sent, "
+              << received.load() << "/" << sent << " received" << std::endl;
+  }
+  return 0;
+}
@@ -0,0 +1,117 @@
+/**
+ * Copyright (C) 2018 Chalmers Revere
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+
+#ifndef SYNTHETICTRACK_HPP
+#define SYNTHETICTRACK_HPP
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include <Eigen/Dense>
+#include <Eigen/StdVector>
+
+/*
+ * Elliptic track with cones on both sides for tests and benchmarks. The car
+ * drives the centre line counter clockwise, left cones have type 1 and right
+ * cones type 2. Observations are given the way perception reports them: from
+ * the lidar 1.5 m ahead of the CoG, azimuth in degrees positive to the left.
+ */
+class SyntheticTrack {
+ public:
+  SyntheticTrack(double semiMajor = 30.0, double semiMinor = 18.0, double width = 3.0, double coneSpacing = 4.0) :
+    m_centreLine()
+  , m_arcLength()
+  , m_cones()
+  {
+    const uint32_t samples = 4000;
+    const double pi = std::acos(-1.0);
+    double length = 0;
+    for(uint32_t i = 0; i <= samples; i++){
+      double phi = 2*pi*i/samples;
+      Eigen::Vector2d point(semiMajor*std::cos(phi), semiMinor*std::sin(phi));
+      if(i > 0){
+        length += (point-m_centreLine.back()).norm();
+      }
+      m_centreLine.push_back(point);
+      m_arcLength.push_back(length);
+    }
+    for(double s = 0; s < length-coneSpacing/2; s += coneSpacing){
+      Eigen::Vector3d pose = poseAt(s);
+      Eigen::Vector2d left(-std::sin(pose(2)), std::cos(pose(2)));
+      m_cones.push_back(Eigen::Vector3d(pose(0)+left(0)*width/2, pose(1)+left(1)*width/2, 1));
+      m_cones.push_back(Eigen::Vector3d(pose(0)-left(0)*width/2, pose(1)-left(1)*width/2, 2));
+    }
+  }
+
+  double length() const
+  {
+    return m_arcLength.back();
+  }
+
+  //Pose (x, y, heading) after driving distance along the centre line, wraps around laps
+  Eigen::Vector3d poseAt(double distance) const
+  {
+    distance = std::fmod(distance, length());
+    distance = (distance < 0)?(distance+length()):(distance);
+    uint32_t i = 1;
+    while(i < m_arcLength.size()-1 && m_arcLength[i] < distance){
+      i++;
+    }
+    double fraction = (distance-m_arcLength[i-1])/(m_arcLength[i]-m_arcLength[i-1]);
+    Eigen::Vector2d point = m_centreLine[i-1]+fraction*(m_centreLine[i]-m_centreLine[i-1]);
+    Eigen::Vector2d direction = m_centreLine[i]-m_centreLine[i-1];
+    return Eigen::Vector3d(point(0), point(1), std::atan2(direction(1), direction(0)));
+  }
+
+  //Columns of azimuth, zenith, distance and type for all cones in front of the car within range
+  Eigen::MatrixXd observe(Eigen::Vector3d const &pose, double range, double fieldOfViewDegrees) const
+  {
+    const double lidarOffset = 1.5;
+    const double rad2deg = 180.0/std::acos(-1.0);
+    std::vector<Eigen::Vector4d, Eigen::aligned_allocator<Eigen::Vector4d>> seen;
+    for(auto const &cone : m_cones){
+      double dx = cone(0)-pose(0);
+      double dy = cone(1)-pose(1);
+      double x = dx*std::cos(pose(2))+dy*std::sin(pose(2))-lidarOffset;
+      double y = -dx*std::sin(pose(2))+dy*std::cos(pose(2));
+      double distance = std::sqrt(x*x+y*y);
+      double azimuth = std::atan2(y, x)*rad2deg;
+      if(x > 0 && distance < range && std::fabs(azimuth) < fieldOfViewDegrees/2){
+        seen.push_back(Eigen::Vector4d(azimuth, 0.0, distance, cone(2)));
+      }
+    }
+    Eigen::MatrixXd observations(4, seen.size());
+    for(uint32_t i = 0; i < seen.size(); i++){
+      observations.col(i) = seen[i];
+    }
+    return observations;
+  }
+
+  std::vector<Eigen::Vector3d> const &cones() const
+  {
+    return m_cones;
+  }
+
+ private:
+  std::vector<Eigen::Vector2d, Eigen::aligned_allocator<Eigen::Vector2d>> m_centreLine;
+  std::vector<double> m_arcLength;
+  std::vector<Eigen::Vector3d> m_cones;
+};
+
+#endif
@@ -0,0 +1,447 @@
+/**
+ * Copyright (C) 2018 Chalmers Revere
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+
+#include <sys/prctl.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "cluon-complete.hpp"
+#include "opendlv-standard-message-set.hpp"
+#include "WGS84toCartesian.hpp"
+#include "slam.hpp"
+#include "synthetictrack.hpp"
+
+/*
+ * Counts heap allocations made while Slam is driven in replay mode around a
+ * synthetic track. After warm-up (the first lap, loop closure and half a lap
+ * of localization) the ingest of cone and pose messages, the closing of
+ * frames that are no keyframes and the publisher thread, which encodes and
+ * sends the cones and pose of every keyframe, must not allocate. Keyframes
+ * may only allocate what g2o needs for the vertices and edges they add, which
+ * is measured up front, and for the occasional doubling of a container that
+ * grows with the graph.
+ */
+namespace {
+thread_local bool t_counting = false;
+thread_local uint64_t t_allocations = 0;
+thread_local bool t_publisher = false;
+std::atomic<bool> g_countPublisher(false);
+std::atomic<uint64_t> g_publisherAllocations(0);
+std::atomic<uint64_t> g_publisherBursts(0);
+std::atomic<uint64_t> g_publisherEnvelopes(0);
+
+//Containers growing with the graph: the poses, the pose vertices, the rows
+//and entries of the observation graph and g2o's vertex index. Each may
+//reallocate once per doubling of the graph.
+const uint64_t GROWING_CONTAINERS = 5;
+
+//Named by Publisher::run, only the name tells its allocations apart
+bool isPublisherThread()
+{
+  if(!t_publisher){
+    char name[16] = {};
+    prctl(PR_GET_NAME, name, 0, 0, 0);
+    t_publisher = std::strcmp(name, "slam-publisher") == 0;
+  }
+  return t_publisher;
+}
+
+void count()
+{
+  if(t_counting){
+    t_allocations++;
+  }
+  else if(g_countPublisher.load(std::memory_order_relaxed) && isPublisherThread()){
+    g_publisherAllocations++;
+  }
+}
+}
+
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t number, size_t size);
+void *__libc_realloc(void *pointer, size_t size);
+void __libc_free(void *pointer);
+
+void *malloc(size_t size)
+{
+  count();
+  return __libc_malloc(size);
+}
+
+void *calloc(size_t number, size_t size)
+{
+  count();
+  return __libc_calloc(number, size);
+}
+
+void *realloc(void *pointer, size_t size)
+{
+  count();
+  return __libc_realloc(pointer, size);
+}
+
+void free(void *pointer)
+{
+  __libc_free(pointer);
+}
+
+//Shows that the publisher thread really sent the keyframe batches
+int sendmmsg(int socket, struct mmsghdr *messages, unsigned int length, int flags)
+{
+  if(g_countPublisher.load(std::memory_order_relaxed) && isPublisherThread()){
+    g_publisherBursts++;
+    g_publisherEnvelopes += length;
+  }
+  return static_cast<int>(syscall(SYS_sendmmsg, socket, messages, length, flags));
+}
+}
+
+void *operator new(std::size_t size)
+{
+  count();
+  void *pointer = __libc_malloc((size > 0)?(size):(1));
+  if(pointer == nullptr){
+    throw std::bad_alloc();
+  }
+  return pointer;
+}
+
+void *operator new[](std::size_t size)
+{
+  return operator new(size);
+}
+
+void *operator new(std::size_t size, std::nothrow_t const &) noexcept
+{
+  count();
+  return __libc_malloc((size > 0)?(size):(1));
+}
+
+void *operator new[](std::size_t size, std::nothrow_t const &) noexcept
+{
+  return operator new(size, std::nothrow);
+}
+
+void operator delete(void *pointer) noexcept
+{
+  __libc_free(pointer);
+}
+
+void operator delete[](void *pointer) noexcept
+{
+  __libc_free(pointer);
+}
+
+void operator delete(void *pointer, std::size_t) noexcept
+{
+  __libc_free(pointer);
+}
+
+void operator delete[](void *pointer, std::size_t) noexcept
+{
+  __libc_free(pointer);
+}
+
+namespace {
+class Stage {
+ public:
+  Stage(std::string const &name) : m_name(name) {}
+
+  void start()
+  {
+    t_allocations = 0;
+    t_counting = true;
+  }
+
+  uint64_t stop()
+  {
+    t_counting = false;
+    return t_allocations;
+  }
+
+  void record(uint64_t allocations, uint64_t allowed, bool enforced)
+  {
+    if(!enforced){
+      return;
+    }
+    m_calls++;
+    m_allocations += allocations;
+    m_max = (allocations > m_max)?(allocations):(m_max);
+    if(allocations > allowed){
+      m_violations++;
+    }
+  }
+
+  bool report(uint64_t frames) const
+  {
+    std::cerr << m_name << ": " << static_cast<double>(m_allocations)/static_cast<double>((frames > 0)?(frames):(1)) << " allocations per frame, "
+              << m_calls << " calls, max " << m_max << " per call, " << m_violations << " over budget" << std::endl;
+    return m_violations == 0;
+  }
+
+  std::string m_name;
+  uint64_t m_calls = 0;
+  uint64_t m_allocations = 0;
+  uint64_t m_max = 0;
+  uint64_t m_violations = 0;
+};
+
+template <typename T>
+cluon::data::Envelope toEnvelope(T &message, cluon::data::TimeStamp const &sampleTime, uint32_t senderStamp)
+{
+  cluon::ToProtoVisitor encoder;
+  message.accept(encoder);
+  cluon::data::Envelope envelope;
+  envelope.dataType(static_cast<int32_t>(message.ID()));
+  envelope.serializedData(encoder.encodedData());
+  envelope.sent(sampleTime);
+  envelope.sampleTimeStamp(sampleTime);
+  envelope.senderStamp(senderStamp);
+  return envelope;
+}
+
+//Allocations for adding one vertex or edge to a graph that already holds
+//many, the least over several additions so that no rehash is included
+struct GraphCosts {
+  GraphCosts() : pose(0), odometry(0), cone(0), measurement(0) {}
+  uint64_t pose;
+  uint64_t odometry;
+  uint64_t cone;
+  uint64_t measurement;
+};
+
+GraphCosts measureGraphCosts()
+{
+  g2o::SparseOptimizer optimizer;
+  VertexIds vertexIds;
+  std::vector<g2o::VertexSE2 *> poses;
+  std::vector<g2o::VertexPointXY *> cones;
+  GraphCosts costs;
+  costs.pose = costs.odometry = costs.cone = costs.measurement = UINT64_MAX;
+  for(uint32_t i = 0; i < 2000; i++){
+    bool measured = i >= 1000;
+
+    t_allocations = 0;
+    t_counting = measured;
+    g2o::VertexSE2 *pose = new g2o::VertexSE2;
+    pose->setId(vertexIds.nextPose());
+    pose->setEstimate(g2o::SE2(static_cast<double>(i), 0.0, 0.0));
+    optimizer.addVertex(pose);
+    t_counting = false;
+    costs.pose = (measured && t_allocations < costs.pose)?(t_allocations):(costs.pose);
+    poses.push_back(pose);
+
+    t_allocations = 0;
+    t_counting = measured;
+    g2o::VertexPointXY *cone = new g2o::VertexPointXY;
+    cone->setId(vertexIds.nextLandmark());
+    cone->setEstimate(Eigen::Vector2d(static_cast<double>(i), 2.0));
+    optimizer.addVertex(cone);
+    t_counting = false;
+    costs.cone = (measured && t_allocations < costs.cone)?(t_allocations):(costs.cone);
+    cones.push_back(cone);
+
+    if(i > 0){
+      t_allocations = 0;
+      t_counting = measured;
+      g2o::EdgeSE2 *odometry = new g2o::EdgeSE2;
+      odometry->vertices()[0] = poses[i-1];
+      odometry->vertices()[1] = pose;
+      odometry->setMeasurement(g2o::SE2(1.0, 0.0, 0.0));
+      odometry->setInformation(Eigen::Matrix3d::Identity()*5);
+      optimizer.addEdge(odometry);
+      t_counting = false;
+      costs.odometry = (measured && t_allocations < costs.odometry)?(t_allocations):(costs.odometry);
+    }
+
+    t_allocations = 0;
+    t_counting = measured;
+    EdgeRangeBearing *measurement = new EdgeRangeBearing;
+    measurement->vertices()[0] = pose;
+    measurement->vertices()[1] = cones[i/2];
+    measurement->setObservation(10.0, 0.0, 2.0);
+    measurement->setSensorOffset(Eigen::Vector2d(1.5, 0.0));
+    measurement->setInformation(Eigen::Vector2d(100.0, 1000.0).asDiagonal());
+    optimizer.addEdge(measurement);
+    t_counting = false;
+    costs.measurement = (measured && t_allocations < costs.measurement)?(t_allocations):(costs.measurement);
+  }
+  return costs;
+}
+
+struct Frame {
+  Frame() : cones(), pose() {}
+  std::vector<cluon::data::Envelope> cones;
+  cluon::data::Envelope pose;
+};
+}
+
+int32_t main(int32_t argc, char **argv)
+{
+  auto commandlineArguments = cluon::getCommandlineArguments(argc, argv);
+  const uint32_t laps = (commandlineArguments.count("laps") != 0)?(static_cast<uint32_t>(std::stoi(commandlineArguments["laps"]))):(3);
+  const bool verbose = commandlineArguments.count("verbose") != 0;
+  const double speed = 8.0;
+  const double frameRate = 10.0;
+  const std::array<double,2> reference = {{57.71, 11.94}};
+
+  //Dense keyframes put most frames through the keyframe path
+  std::map<std::string, std::string> configuration = {
+    {"cid", "253"}, {"id", "120"}, {"detectConeId", "118"}, {"estimationId", "114"},
+    {"gatheringTimeMs", "50"}, {"sameConeThreshold", "1.2"}, {"refLatitude", "57.71"}, {"refLongitude", "11.94"},
+    {"timeBetweenKeyframes", "0.5"}, {"keyframeDistance", "1.0"}, {"keyframeHeading", "10"}, {"coneMappingThreshold", "12"}, {"conesPerPacket", "20"}, {"replay", "1"}};
+
+  //All envelopes are built up front, only Slam runs while counting
+  SyntheticTrack track;
+  const uint32_t framesPerLap = static_cast<uint32_t>(track.length()/speed*frameRate);
+  const uint32_t numberOfFrames = laps*framesPerLap;
+  std::vector<Frame> frames(numberOfFrames);
+  for(uint32_t k = 0; k < numberOfFrames; k++){
+    cluon::data::TimeStamp sampleTime = cluon::time::fromMicroseconds(1000000+static_cast<int64_t>(k*1000000/frameRate));
+    Eigen::Vector3d pose = track.poseAt(k*speed/frameRate);
+    std::array<double,2> gps = wgs84::fromCartesian(reference, {{pose(0), pose(1)}});
+    opendlv::logic::sensation::Geolocation geolocation;
+    geolocation.latitude(gps[0]).longitude(gps[1]).heading(static_cast<float>(pose(2)));
+    frames[k].pose = toEnvelope(geolocation, sampleTime, 114);
+
+    Eigen::MatrixXd observations = track.observe(pose, 12.0, 120.0);
+    for(uint32_t i = 0; i < observations.cols(); i++){
+      opendlv::logic::perception::ObjectDirection direction;
+      direction.objectId(i).azimuthAngle(static_cast<float>(observations(0,i))).zenithAngle(static_cast<float>(observations(1,i)));
+      opendlv::logic::perception::ObjectDistance distance;
+      distance.objectId(i).distance(static_cast<float>(observations(2,i)));
+      opendlv::logic::perception::ObjectType type;
+      type.objectId(i).type(static_cast<uint32_t>(observations(3,i)));
+      frames[k].cones.push_back(toEnvelope(direction, sampleTime, 118));
+      frames[k].cones.push_back(toEnvelope(distance, sampleTime, 118));
+      frames[k].cones.push_back(toEnvelope(type, sampleTime, 118));
+    }
+  }
+
+  GraphCosts costs = measureGraphCosts();
+  cluon::OD4Session od4{253};
+  std::unique_ptr<Slam> slam(new Slam(configuration, od4));
+
+  Stage coneIngest("cone ingest");
+  Stage poseIngest("pose ingest");
+  Stage frameClose("frame (no keyframe)");
+  Stage keyframe("keyframe");
+
+  const uint32_t warmUpFrames = framesPerLap+framesPerLap/2;
+  uint64_t steadyFrames = 0;
+  uint64_t poses = 0;
+  uint64_t cones = 0;
+  uint64_t edges = 0;
+  uint64_t steadyElements = 0;
+  uint64_t growth = 0;
+  for(uint32_t k = 0; k < numberOfFrames; k++){
+    bool steady = k > warmUpFrames;
+    steadyFrames += (steady)?(1):(0);
+    if(steady && !g_countPublisher){
+      steadyElements = 2*poses+cones+edges;
+      g_countPublisher = true;
+    }
+    Frame const &frame = frames[k];
+    for(uint32_t m = 0; m < frame.cones.size(); m++){
+      if(m == 0){
+        //The first message of a frame closes the previous one
+        frameClose.start();
+        slam->nextCone(frame.cones[m]);
+        uint64_t allocations = frameClose.stop();
+
+        uint64_t newPoses = slam->drawPoses().size();
+        uint64_t newCones = slam->drawCones().size();
+        uint64_t newEdges = slam->drawGraph().observations();
+        bool isKeyframe = newPoses > poses;
+        uint64_t graphElements = 2*(newPoses-poses)+(newCones-cones)+(newEdges-edges);
+        if(isKeyframe){
+          //The first pose has no odometry edge, the map is complete long before the steady state
+          uint64_t allowed = (newPoses-poses)*(costs.pose+costs.odometry)+(newCones-cones)*costs.cone+(newEdges-edges)*costs.measurement;
+          uint64_t excess = (steady && allocations > allowed)?(allocations-allowed):(0);
+          growth += excess;
+          keyframe.record(allocations-excess, allowed, steady);
+        }
+        else{
+          frameClose.record(allocations, 0, steady);
+        }
+        if(verbose){
+          std::cerr << "frame " << k << ((isKeyframe)?(" keyframe"):("")) << ": " << allocations << " allocations, " << graphElements << " graph elements, " << growth << " for growth so far" << std::endl;
+        }
+        poses = newPoses;
+        cones = newCones;
+        edges = newEdges;
+
+        poseIngest.start();
+        slam->nextPose(frame.pose);
+        poseIngest.record(poseIngest.stop(), 0, steady);
+        continue;
+      }
+      coneIngest.start();
+      slam->nextCone(frame.cones[m]);
+      coneIngest.record(coneIngest.stop(), 0, steady);
+    }
+  }
+  //Stopping Slam stops its publisher once every batch handed over is sent
+  slam.reset();
+  g_countPublisher = false;
+
+  std::cerr << numberOfFrames << " frames, " << steadyFrames << " after warm-up, map of " << cones << " cones, " << poses << " poses" << std::endl;
+  std::cerr << "g2o: " << costs.pose << " per pose, " << costs.odometry << " per odometry edge, " << costs.cone << " per cone, " << costs.measurement << " per measurement" << std::endl;
+  bool ok = true;
+  ok = coneIngest.report(steadyFrames) && ok;
+  ok = poseIngest.report(steadyFrames) && ok;
+  ok = frameClose.report(steadyFrames) && ok;
+  ok = keyframe.report(steadyFrames) && ok;
+
+  //Amortized growth, the graph grew by this many doublings during the steady state
+  uint64_t finalElements = 2*poses+cones+edges;
+  uint64_t doublings = static_cast<uint64_t>(std::ceil(std::log2(static_cast<double>(finalElements)/static_cast<double>((steadyElements > 0)?(steadyElements):(1)))))+1;
+  std::cerr << "container growth: " << growth << " allocations over " << doublings << " doublings" << std::endl;
+  if(growth > GROWING_CONTAINERS*doublings){
+    std::cerr << "container growth over budget" << std::endl;
+    ok = false;
+  }
+
+  std::cerr << "publish: " << g_publisherAllocations << " allocations, " << g_publisherEnvelopes << " envelopes in " << g_publisherBursts << " bursts" << std::endl;
+  if(g_publisherAllocations > 0){
+    ok = false;
+  }
+  if(g_publisherEnvelopes <= g_publisherBursts){
+    std::cerr << "No keyframe cones were published" << std::endl;
+    ok = false;
+  }
+  if(cones == 0 || poses == 0){
+    std::cerr << "Slam did not build a map" << std::endl;
+    ok = false;
+  }
+  return (ok)?(0):(1);
+}
@@ -20,11 +20,1006 @@
 
 #include "cluon-complete.hpp"
 #include "opendlv-standard-message-set.hpp"
+#include "clock.hpp"
+#include "poseextrapolator.hpp"
+#include "coneframe.hpp"
+#include "publisher.hpp"
+#include "landmarkstore.hpp"
+#include "conetracker.hpp"
+#include "keyframeselector.hpp"
+#include "vertexids.hpp"
+#include "observationgraph.hpp"
+#include "placerecognizer.hpp"
+#include "mapfile.hpp"
+#include "filterbackend.hpp"
+#include "ekfslam.hpp"
+#include "fastslam.hpp"
+#include "landmarktree.hpp"
+#include "threadpool.hpp"
+#include "graphfile.hpp"
+#include "solver.hpp"
+#include "synthetictrack.hpp"
+#include "edgerangebearing.hpp"
+#include "slam.hpp"
+#include "WGS84toCartesian.hpp"
 
+#include <unistd.h>
+#include <array>
+#include <cmath>
 #include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <utility>
+
+namespace {
+//A new directory under /tmp per call, tests never write into the working directory
+TEST_CASE("Replayed poses are sent at the sample times.") {
+    std::map<std::string, std::string> configuration = {{"refLatitude", "57.71"}, {"refLongitude", "11.94"}, {"id", "120"}, {"poseRate", "50"}};
+    cluon::OD4Session od4{253};
+    Clock clock(true);
+    PoseExtrapolator extrapolator(configuration, od4, clock);
+    REQUIRE(extrapolator.isPublishing());
+
+    //Odometry at 10 Hz, the 20 ms ticks between two samples go out when the later one arrives
+    for(uint32_t k = 0; k < 10; k++){
+        cluon::data::TimeStamp sampleTime = cluon::time::fromMicroseconds(1000000+k*100000);
+        clock.update(sampleTime);
+        extrapolator.nextOdometry(Eigen::Vector3d(0.1*k, 0.0, 0.0), sampleTime);
+    }
+    REQUIRE(extrapolator.sentPoses() == 45);
+    clock.update(cluon::time::fromMicroseconds(1910000));
+    REQUIRE(extrapolator.sentPoses() == 45);
+    clock.update(cluon::time::fromMicroseconds(1920000));
+    REQUIRE(extrapolator.sentPoses() == 46);
+
+    //A pause in the recording starts the ticks again
+    clock.update(cluon::time::fromMicroseconds(10000000));
+    REQUIRE(extrapolator.sentPoses() == 46);
+    clock.update(cluon::time::fromMicroseconds(10040000));
+    REQUIRE(extrapolator.sentPoses() == 48);
+}
+
+std::string temporaryDirectory()
+{
+    char path[] = "/tmp/slam-test-XXXXXX";
+    return (mkdtemp(path) != nullptr)?(std::string(path)):(std::string());
+}
+
+//Irregular cones, every constellation is unique
+LandmarkStore irregularCones()
+{
+    LandmarkStore store;
+    VertexIds ids;
+    uint32_t seed = 12345;
+    for(uint32_t i = 0; i < 120; i++){
+        seed = seed*1103515245u+12345u;
+        double x = static_cast<double>((seed >> 8) % 6000)/100.0;
+        seed = seed*1103515245u+12345u;
+        double y = static_cast<double>((seed >> 8) % 6000)/100.0;
+        store.add(x, y, 1+static_cast<int>(i%2), ids.nextLandmark());
+    }
+    return store;
+}
+
+//wgs84::fromCartesian walks in steps of about a meter, refined here with Newton steps on toCartesian
+std::array<double,2> toWgs84(std::array<double,2> const &reference, double x, double y)
+{
+    std::array<double,2> position = wgs84::fromCartesian(reference, {{x, y}});
+    const double step = 1e-6;
+    for(uint32_t i = 0; i < 5; i++){
+        std::array<double,2> cartesian = wgs84::toCartesian(reference, position);
+        std::array<double,2> north = wgs84::toCartesian(reference, {{position[0]+step, position[1]}});
+        std::array<double,2> east = wgs84::toCartesian(reference, {{position[0], position[1]+step}});
+        position[0] += (y-cartesian[1])*step/(north[1]-cartesian[1]);
+        position[1] += (x-cartesian[0])*step/(east[0]-cartesian[0]);
+    }
+    return position;
+}
+
+//An envelope as OD4Session would deliver it
+template <typename T>
+cluon::data::Envelope envelopeOf(T &message, cluon::data::TimeStamp const &sampleTime)
+{
+    cluon::ToProtoVisitor encoder;
+    message.accept(encoder);
+    cluon::data::Envelope envelope;
+    envelope.dataType(static_cast<int32_t>(message.ID()));
+    envelope.serializedData(encoder.encodedData());
+    envelope.sampleTimeStamp(sampleTime);
+    return envelope;
+}
+
+//Drives Slam through a stored map in a straight line, with odometry in a frame offset from the map.
+//Returns the true pose in the map frame and the pose Slam extrapolates for the last sample.
+std::pair<Eigen::Vector3d,Eigen::Vector3d> driveThroughStoredMap(std::map<std::string, std::string> configuration, g2o::SE2 const &odometryToMap)
+{
+    LandmarkStore store = irregularCones();
+    std::string directory = temporaryDirectory();
+    std::string mapFile = directory+"/map.txt";
+    saveMap(mapFile, store);
+    configuration.insert({{"id", "120"}, {"refLatitude", "57.71"}, {"refLongitude", "11.94"}, {"timeBetweenKeyframes", "0.5"},
+        {"gatheringTimeMs", "50"}, {"sameConeThreshold", "1.2"}, {"coneMappingThreshold", "12"}, {"conesPerPacket", "20"},
+        {"replay", "1"}, {"mapFile", mapFile}, {"relocalizationKeyframes", "20"}, {"relocalizationMinInliers", "8"}});
+    const std::array<double,2> reference = {{57.71, 11.94}};
+    const double rad2deg = 180.0/std::acos(-1.0);
+
+    std::ofstream devNull("/dev/null");
+    std::streambuf *coutBuffer = std::cout.rdbuf(devNull.rdbuf());
+    cluon::OD4Session od4(231);
+    Slam slam(configuration, od4);
+    Eigen::Vector3d pose;
+    cluon::data::TimeStamp sampleTime;
+    for(uint32_t k = 0; k < 90; k++){
+        sampleTime = cluon::time::fromMicroseconds(1000000+k*100000);
+        pose << 5.0+0.5*k, 30.0, 0.0;
+        Eigen::Vector3d odometry = (odometryToMap.inverse()*g2o::SE2(pose(0), pose(1), pose(2))).toVector();
+        std::array<double,2> gps = toWgs84(reference, odometry(0), odometry(1));
+        opendlv::logic::sensation::Geolocation geolocation;
+        geolocation.latitude(gps[0]).longitude(gps[1]).heading(static_cast<float>(odometry(2)));
+        cluon::ToProtoVisitor encoder;
+        geolocation.accept(encoder);
+        cluon::data::Envelope envelope;
+        envelope.dataType(static_cast<int32_t>(geolocation.ID()));
+        envelope.serializedData(encoder.encodedData());
+        envelope.sampleTimeStamp(sampleTime);
+        slam.nextPose(envelope);
+
+        //Azimuth, zenith, distance and type from the lidar 1.5 m ahead of the CoG
+        Eigen::MatrixXd cones(4, 0);
+        for(uint32_t i = 0; i < store.size(); i++){
+            double x = store.x(i)-pose(0)-1.5;
+            double y = store.y(i)-pose(1);
+            double distance = std::sqrt(x*x+y*y);
+            if(x > 0 && distance < 12.0){
+                cones.conservativeResize(Eigen::NoChange, cones.cols()+1);
+                cones.col(cones.cols()-1) << std::atan2(y, x)*rad2deg, 0.0, distance, store.type(i);
+            }
+        }
+        slam.nextConeFrame(cones, sampleTime);
+    }
+    Eigen::Vector3d extrapolated = slam.drawExtrapolatedPose(sampleTime);
+    std::cout.rdbuf(coutBuffer);
+    std::remove(mapFile.c_str());
+    rmdir(directory.c_str());
+    return {pose, extrapolated};
+}
+}
 
 TEST_CASE("Test simulator.") {
     int32_t a = 5;
     int32_t b = 6;
     REQUIRE(a + b == 11);
 }
+
+TEST_CASE("Replay clock follows sample timestamps.") {
+    Clock clock(true);
+    REQUIRE(clock.isReplay());
+    clock.update(cluon::time::fromMicroseconds(2000000));
+    REQUIRE(cluon::time::toMicroseconds(clock.now()) == 2000000);
+    clock.update(cluon::time::fromMicroseconds(1000000));
+    REQUIRE(cluon::time::toMicroseconds(clock.now()) == 2000000);
+    REQUIRE(clock.waitUntil(cluon::time::fromMicroseconds(1500000)));
+    REQUIRE(!clock.waitUntil(cluon::time::fromMicroseconds(2500000)));
+}
+
+TEST_CASE("Poses are extrapolated from odometry and the last correction.") {
+    std::map<std::string, std::string> configuration = {{"refLatitude", "57.71"}, {"refLongitude", "11.94"}, {"id", "120"}};
+    cluon::OD4Session od4{253};
+    Clock clock(true);
+    PoseExtrapolator extrapolator(configuration, od4, clock);
+    REQUIRE(!extrapolator.isPublishing());
+
+    //10 m/s straight ahead along x
+    extrapolator.nextOdometry(Eigen::Vector3d(0.0, 0.0, 0.0), cluon::time::fromMicroseconds(1000000));
+    extrapolator.nextOdometry(Eigen::Vector3d(1.0, 0.0, 0.0), cluon::time::fromMicroseconds(1100000));
+    Eigen::Vector3d pose = extrapolator.extrapolate(cluon::time::fromMicroseconds(1150000));
+    REQUIRE(pose(0) == Approx(1.5));
+    REQUIRE(pose(1) == Approx(0.0).margin(1e-9));
+    REQUIRE(pose(2) == Approx(0.0).margin(1e-9));
+
+    //No further than --maxPoseExtrapolationMs ahead of the odometry sample, and never back in time
+    pose = extrapolator.extrapolate(cluon::time::fromMicroseconds(2100000));
+    REQUIRE(pose(0) == Approx(3.0));
+    pose = extrapolator.extrapolate(cluon::time::fromMicroseconds(1000000));
+    REQUIRE(pose(0) == Approx(1.0));
+
+    //The corrected pose of the odometry sample, carried along with the odometry
+    extrapolator.nextCorrection(Eigen::Vector3d(1.0, 0.0, 0.0), Eigen::Vector3d(1.0, 2.0, M_PI/2));
+    pose = extrapolator.extrapolate(cluon::time::fromMicroseconds(1100000));
+    REQUIRE(pose(0) == Approx(1.0));
+    REQUIRE(pose(1) == Approx(2.0));
+    REQUIRE(pose(2) == Approx(M_PI/2));
+    pose = extrapolator.extrapolate(cluon::time::fromMicroseconds(1150000));
+    REQUIRE(pose(0) == Approx(1.0));
+    REQUIRE(pose(1) == Approx(2.5));
+    REQUIRE(pose(2) == Approx(M_PI/2));
+
+    //Odometry that goes back in time is dropped as a whole
+    extrapolator.nextOdometry(Eigen::Vector3d(5.0, 0.0, 0.0), cluon::time::fromMicroseconds(1050000));
+    pose = extrapolator.extrapolate(cluon::time::fromMicroseconds(1150000));
+    REQUIRE(pose(1) == Approx(2.5));
+
+    //The heading follows the measured yaw rate
+    extrapolator.nextYawRate(1.0, cluon::time::fromMicroseconds(1100000));
+    pose = extrapolator.extrapolate(cluon::time::fromMicroseconds(1150000));
+    REQUIRE(pose(2) == Approx(M_PI/2+0.05));
+}
+
+TEST_CASE("Packed cones survive a round trip.") {
+    ConeFrameCone cones[2] = {{-12.5f, 1.0f, 7.25f, 1, 0}, {30.0f, 0.0f, 15.5f, 2, 1}};
+    std::string packed = packCones(cones, 2);
+    REQUIRE(packed.size() == 2*PACKED_CONE_SIZE);
+
+    ConeFrameCone unpacked[MAX_CONES_PER_FRAME];
+    REQUIRE(unpackCones(packed, unpacked, MAX_CONES_PER_FRAME) == 2);
+    REQUIRE(unpacked[0].azimuthAngle == Approx(-12.5f));
+    REQUIRE(unpacked[1].distance == Approx(15.5f));
+    REQUIRE(unpacked[1].type == 2);
+    REQUIRE(unpacked[1].objectId == 1);
+    REQUIRE(unpackCones(packed, unpacked, 1) == 1);
+}
+
+TEST_CASE("Cone message fields are read in place.") {
+    opendlv::logic::perception::ObjectDirection direction;
+    direction.objectId(300).azimuthAngle(-12.5f).zenithAngle(1.5f);
+    cluon::ToProtoVisitor encoder;
+    direction.accept(encoder);
+    std::string payload = encoder.encodedData();
+
+    uint32_t objectId = 0;
+    float azimuth = 0.0f;
+    float zenith = 0.0f;
+    std::size_t position = 0;
+    ProtoField field;
+    while (nextProtoField(payload, position, field)) {
+        if (field.id == 1) objectId = static_cast<uint32_t>(field.value);
+        if (field.id == 2) azimuth = protoFloat(field);
+        if (field.id == 3) zenith = protoFloat(field);
+    }
+    REQUIRE(position == payload.size());
+    REQUIRE(objectId == 300);
+    REQUIRE(azimuth == Approx(-12.5f));
+    REQUIRE(zenith == Approx(1.5f));
+
+    position = 0;
+    std::string truncated = payload.substr(0, payload.size()-1);
+    while (nextProtoField(truncated, position, field)) {}
+    REQUIRE(position <= truncated.size());
+}
+
+TEST_CASE("Proto fields are appended as cluon encodes them.") {
+    ConeFrameCone cones[2] = {{-12.5f, 1.0f, 7.25f, 1, 0}, {30.0f, 0.0f, 15.5f, 2, 1}};
+    opendlv::logic::perception::ConeFrame coneFrame;
+    coneFrame.frameId(300).numberOfCones(2).cones(packCones(cones, 2));
+    cluon::ToProtoVisitor coneFrameEncoder;
+    coneFrame.accept(coneFrameEncoder);
+    std::string appended;
+    appendProtoVarInt(appended, 1, 300);
+    appendProtoVarInt(appended, 2, 2);
+    appendProtoLength(appended, 3, 2*PACKED_CONE_SIZE);
+    appendPackedCones(appended, cones, 2);
+    REQUIRE(appended == coneFrameEncoder.encodedData());
+
+    opendlv::logic::sensation::Geolocation pose;
+    pose.latitude(57.7).longitude(-11.9).altitude(0.0f).heading(-1.5f);
+    cluon::ToProtoVisitor poseEncoder;
+    pose.accept(poseEncoder);
+    appended.clear();
+    appendProtoDouble(appended, 1, 57.7);
+    appendProtoDouble(appended, 2, -11.9);
+    appendProtoFloat(appended, 3, 0.0f);
+    appendProtoFloat(appended, 4, -1.5f);
+    REQUIRE(appended == poseEncoder.encodedData());
+
+    cluon::data::TimeStamp timeStamp;
+    timeStamp.seconds(-70000).microseconds(999999);
+    cluon::ToProtoVisitor timeStampEncoder;
+    timeStamp.accept(timeStampEncoder);
+    appended.clear();
+    appendProtoInt32(appended, 1, -70000);
+    appendProtoInt32(appended, 2, 999999);
+    REQUIRE(appended == timeStampEncoder.encodedData());
+    REQUIRE(varIntSize(zigZag32(-70000)) == 3);
+}
+
+TEST_CASE("Envelopes are encoded as cluon serializes them.") {
+    ConeFrameCone cones[2] = {{-12.5f, 1.0f, 7.25f, 1, 0}, {30.0f, 0.0f, 15.5f, 2, 1}};
+    opendlv::logic::perception::ConeFrame coneFrame;
+    coneFrame.frameId(7).numberOfCones(2).cones(packCones(cones, 2));
+    cluon::ToProtoVisitor encoder;
+    coneFrame.accept(encoder);
+
+    cluon::data::TimeStamp sent;
+    sent.seconds(1530000000).microseconds(123456);
+    cluon::data::TimeStamp sampleTime;
+    sampleTime.seconds(12).microseconds(500);
+    cluon::data::Envelope envelope;
+    envelope.dataType(static_cast<int32_t>(opendlv::logic::perception::ConeFrame::ID()));
+    envelope.serializedData(encoder.encodedData());
+    envelope.sent(sent);
+    envelope.sampleTimeStamp(sampleTime);
+    envelope.senderStamp(120);
+
+    std::string encoded;
+    std::string payload;
+    encodeEnvelope(encoded, payload, opendlv::logic::perception::ConeFrame::ID(), encoder.encodedData(), sent, sampleTime, 120);
+    REQUIRE(encoded == cluon::serializeEnvelope(std::move(envelope)));
+}
+
+TEST_CASE("Landmark store queries filter on distance and type.") {
+    LandmarkStore store;
+    for(int i = 0; i < 200; i++){
+        store.add(i, 0.0, i%2, i);
+    }
+    REQUIRE(store.size() == 200);
+    REQUIRE(store.nearest(10.2, 0.5, 0, 1.0) == 10);
+    REQUIRE(store.nearest(10.2, 0.5, 1, 1.0) == 11);
+    REQUIRE(store.nearest(10.2, 5.0, -1, 1.0) == -1);
+    REQUIRE(LandmarkStore::coneClass(7) == CONE_UNKNOWN);
+    REQUIRE(store.nearest(10.2, 0.5, 7, 1.0) == 10);
+
+    std::vector<uint32_t> indices;
+    REQUIRE(store.withinRadius(100.0, 0.0, 2.5, 0, indices) == 3);
+    REQUIRE(indices[0] == 98);
+    REQUIRE(indices[2] == 102);
+    REQUIRE(store.withinRadius(100.0, 0.0, 2.5, -1, indices) == 5);
+
+    store.setPosition(50, 0.5, 0.5);
+    store.addObservation(50);
+    Cone cone = store.cone(50);
+    REQUIRE(cone.getX() == Approx(0.5));
+    REQUIRE(cone.getType() == 0);
+    REQUIRE(store.observations(50) == 2);
+    REQUIRE(store.nearest(0.4, 0.4, 0, 1.0) == 50);
+
+    uint64_t version = store.version();
+    store.setPosition(60, 60.0, 0.1);
+    REQUIRE(store.version() == version+1);
+    REQUIRE(store.changedSince(version, indices) == 1);
+    REQUIRE(indices[0] == 60);
+}
+
+TEST_CASE("Cone candidates are confirmed or dropped.") {
+    ConeTracker tracker(3, 2, 1.0);
+    Eigen::Vector3d measurement(10.0, 0.0, 5.0);
+    int32_t candidate = tracker.observe(5.0, 0.0, 1, 1000, measurement);
+    REQUIRE(candidate == 0);
+    REQUIRE(tracker.observe(5.2, 0.0, 2, 1000, measurement) == 1);
+    tracker.endKeyframe();
+    REQUIRE(tracker.observe(5.4, 0.0, 1, 1001, measurement) == 0);
+    REQUIRE(!tracker.isConfirmed(0));
+    tracker.endKeyframe();
+    REQUIRE(tracker.observe(5.6, 0.0, 1, 1002, measurement) == 0);
+    REQUIRE(tracker.isConfirmed(0));
+    REQUIRE(tracker.x(0) == Approx((5.0+5.4+5.6)/3));
+    REQUIRE(tracker.observationPoseId(0, 1) == 1001);
+
+    //The blue candidate was last seen three keyframes ago
+    tracker.endKeyframe();
+    REQUIRE(tracker.size() == 1);
+    tracker.remove(0);
+    REQUIRE(tracker.size() == 0);
+}
+
+TEST_CASE("Keyframes follow distance, heading and time.") {
+    KeyframeSelector selector(1.0, 10.0, 0.5);
+    auto at = [](double seconds){return cluon::time::fromMicroseconds(static_cast<int64_t>(seconds*1000000));};
+    REQUIRE(selector.isKeyframe(Eigen::Vector3d(0.0, 0.0, 0.0), at(1.0)));
+    //Below every threshold
+    REQUIRE(!selector.isKeyframe(Eigen::Vector3d(0.5, 0.0, 0.0), at(1.1)));
+    //Distance and heading, each on its own
+    REQUIRE(selector.isKeyframe(Eigen::Vector3d(1.1, 0.0, 0.0), at(1.2)));
+    REQUIRE(!selector.isKeyframe(Eigen::Vector3d(1.1, 0.0, 9.0*M_PI/180), at(1.3)));
+    REQUIRE(selector.isKeyframe(Eigen::Vector3d(1.1, 0.0, 11.0*M_PI/180), at(1.4)));
+    //Heading across the wrap around
+    selector.isKeyframe(Eigen::Vector3d(1.1, 0.0, M_PI-0.05), at(1.5));
+    REQUIRE(!selector.isKeyframe(Eigen::Vector3d(1.1, 0.0, -M_PI+0.05), at(1.6)));
+    //Moving slowly, the interval adds a keyframe
+    REQUIRE(!selector.isKeyframe(Eigen::Vector3d(1.3, 0.0, M_PI-0.05), at(1.8)));
+    REQUIRE(selector.isKeyframe(Eigen::Vector3d(1.4, 0.0, M_PI-0.05), at(2.1)));
+    //Standing still, no keyframes however long it takes
+    REQUIRE(!selector.isKeyframe(Eigen::Vector3d(1.45, 0.0, M_PI-0.05), at(5.0)));
+    REQUIRE(!selector.isKeyframe(Eigen::Vector3d(1.4, 0.05, M_PI-0.05), at(60.0)));
+    selector.setDistance(0.02);
+    REQUIRE(selector.isKeyframe(Eigen::Vector3d(1.4, 0.05, M_PI-0.05), at(60.1)));
+}
+
+TEST_CASE("The default keyframes are sparser than the old fixed interval.") {
+    //Two laps of the synthetic track at 8 m/s with 10 Hz cone frames
+    SyntheticTrack track;
+    KeyframeSelector selector;
+    uint32_t keyframes = 0;
+    uint32_t timedKeyframes = 0;
+    int64_t lastTimed = 0;
+    for(int64_t frame = 0; frame*0.8 < 2*track.length(); frame++){
+        cluon::data::TimeStamp timeStamp = cluon::time::fromMicroseconds(frame*100000);
+        keyframes += selector.isKeyframe(track.poseAt(frame*0.8), timeStamp)?(1):(0);
+        //The former rule took a keyframe whenever 0.5 s had passed
+        if(frame == 0 || (frame-lastTimed)*100000 > 500000){
+            timedKeyframes++;
+            lastTimed = frame;
+        }
+    }
+    REQUIRE(keyframes > 0);
+    REQUIRE(keyframes < timedKeyframes);
+}
+
+TEST_CASE("Landmarks mapped twice are merged.") {
+    LandmarkStore store;
+    store.add(-0.1, -0.1, 1, 0);
+    store.add(4.0, 0.0, 1, 1);
+    store.add(0.1, 0.1, 1, 2);
+    store.add(0.0, 0.0, 2, 3);
+    store.add(4.2, 0.0, 1, 4);
+    store.addObservation(2);
+    store.addObservation(2);
+
+    std::vector<std::pair<uint32_t,uint32_t>> pairs;
+    REQUIRE(store.pairsWithin(0.5, pairs) == 2);
+    REQUIRE(pairs[0] == std::make_pair(0u, 2u));
+    REQUIRE(pairs[1] == std::make_pair(1u, 4u));
+
+    store.merge(0, 2);
+    REQUIRE(store.x(0) == Approx(0.05));
+    REQUIRE(store.observations(0) == 4);
+    store.compact({true, true, false, true, true});
+    REQUIRE(store.size() == 4);
+    REQUIRE(store.id(2) == 3);
+    REQUIRE(store.nearest(0.0, 0.0, 2, 0.5) == 2);
+    REQUIRE(store.pairsWithin(0.5, pairs) == 1);
+}
+
+TEST_CASE("Pose and landmark vertex ids never collide.") {
+    VertexIds ids;
+    for(int i = 0; i < 1500; i++){
+        REQUIRE(!VertexIds::isPose(ids.nextLandmark()));
+    }
+    int pose = ids.nextPose();
+    REQUIRE(VertexIds::isPose(pose));
+    REQUIRE(VertexIds::index(pose) == 0);
+    REQUIRE(VertexIds::index(VertexIds::landmarkId(1499)) == 1499);
+    REQUIRE(ids.landmarks() == 1500);
+    REQUIRE(ids.poses() == 1);
+}
+
+TEST_CASE("Observation graph rows and reverse index.") {
+    ObservationGraph graph;
+    graph.addPose();
+    graph.addObservation(0, 2);
+    graph.addObservation(0, 4);
+    graph.addPose();
+    graph.addObservation(1, 4);
+    graph.addPose();
+    graph.addObservation(2, 6);
+    //A confirmed candidate adds to an earlier pose
+    graph.addObservation(1, 6);
+    //Seen twice from one pose, kept once
+    graph.addObservation(1, 6);
+    REQUIRE(graph.poses() == 3);
+    REQUIRE(graph.observations() == 5);
+    REQUIRE(graph.observes(1, 6));
+    REQUIRE_FALSE(graph.observes(0, 6));
+    REQUIRE(graph.observationsFrom(1) == 2);
+    REQUIRE(graph.landmarkObservedFrom(1, 1) == 6);
+    REQUIRE(graph.landmarkObservedFrom(2, 0) == 6);
+
+    std::vector<uint32_t> poses;
+    REQUIRE(graph.posesObserving(6, poses) == 2);
+    REQUIRE(poses[0] == 1);
+    REQUIRE(poses[1] == 2);
+    REQUIRE(graph.posesObserving(8, poses) == 0);
+
+    graph.retarget({{6, 4}});
+    REQUIRE(graph.observations() == 4);
+    REQUIRE(graph.observationsFrom(1) == 1);
+    REQUIRE(graph.posesObserving(4, poses) == 3);
+}
+
+TEST_CASE("A revisited cone constellation closes the loop.") {
+    std::map<std::string, std::string> configuration = {{"loopMinKeyframes", "30"}, {"loopStartKeyframes", "20"}};
+    PlaceRecognizer recognizer(configuration);
+    LandmarkStore store;
+    VertexIds ids;
+    const double xs[6] = {0.0, 4.0, 8.0, 0.5, 4.5, 8.5};
+    const double ys[6] = {0.0, 0.3, -0.2, 3.0, 3.2, 2.9};
+    for(uint32_t i = 0; i < 6; i++){
+        uint32_t index = store.add(xs[i], ys[i], 1+static_cast<int>(i/3), ids.nextLandmark());
+        recognizer.addLandmark(store, index, i);
+    }
+    REQUIRE(recognizer.triangles() > 0);
+
+    //The same cones seen with 1.5 m of drift and a small heading error
+    const double heading = 0.05;
+    Eigen::MatrixXd observed(3, 6);
+    for(uint32_t i = 0; i < 6; i++){
+        observed(0,i) = std::cos(heading)*xs[i]-std::sin(heading)*ys[i]+1.5;
+        observed(1,i) = std::sin(heading)*xs[i]+std::cos(heading)*ys[i]-0.5;
+        observed(2,i) = 1+static_cast<int>(i/3);
+    }
+    LoopClosure closure;
+    Eigen::Vector3d pose(5.0, 1.0, 0.0);
+    REQUIRE(!recognizer.recognize(store, observed, pose, 20, closure));
+    REQUIRE(recognizer.recognize(store, observed, pose, 40, closure));
+    REQUIRE(closure.inliers == 6);
+    REQUIRE(closure.reachesStart);
+    REQUIRE(closure.correction(2) == Approx(-heading));
+    for(auto const &match : closure.matches){
+        REQUIRE(match.first == match.second);
+    }
+
+    //A different constellation of the same classes is not a revisit
+    observed.row(0) *= 1.8;
+    REQUIRE(!recognizer.recognize(store, observed, pose, 40, closure));
+}
+
+TEST_CASE("The last replayed cone frame is closed at the end of input.") {
+    std::map<std::string, std::string> configuration = {{"id", "120"}, {"refLatitude", "57.71"}, {"refLongitude", "11.94"},
+        {"timeBetweenKeyframes", "0.5"}, {"gatheringTimeMs", "50"}, {"sameConeThreshold", "1.2"}, {"coneMappingThreshold", "12"},
+        {"conesPerPacket", "20"}, {"replay", "1"}};
+    std::ofstream devNull("/dev/null");
+    std::streambuf *coutBuffer = std::cout.rdbuf(devNull.rdbuf());
+    cluon::OD4Session od4(232);
+    Slam slam(configuration, od4);
+    cluon::data::TimeStamp sampleTime = cluon::time::fromMicroseconds(1000000);
+
+    opendlv::logic::sensation::Geolocation geolocation;
+    geolocation.latitude(57.71).longitude(11.94).heading(0.0f);
+    slam.nextPose(envelopeOf(geolocation, sampleTime));
+    for(uint32_t i = 0; i < 3; i++){
+        opendlv::logic::perception::ObjectDirection direction;
+        direction.objectId(i).azimuthAngle(10.0f*i).zenithAngle(0.0f);
+        slam.nextCone(envelopeOf(direction, sampleTime));
+        opendlv::logic::perception::ObjectDistance distance;
+        distance.objectId(i).distance(5.0f+i);
+        slam.nextCone(envelopeOf(distance, sampleTime));
+        opendlv::logic::perception::ObjectType type;
+        type.objectId(i).type(1);
+        slam.nextCone(envelopeOf(type, sampleTime));
+    }
+    //No later message passes the gathering time
+    REQUIRE(slam.drawPoses().empty());
+    slam.flush();
+    REQUIRE(slam.drawPoses().size() == 1);
+    slam.flush();
+    REQUIRE(slam.drawPoses().size() == 1);
+    std::cout.rdbuf(coutBuffer);
+}
+
+TEST_CASE("Only the triangles of moved landmarks are built again.") {
+    std::map<std::string, std::string> configuration = {{"loopMinKeyframes", "30"}, {"loopStartKeyframes", "20"}};
+    PlaceRecognizer updated(configuration);
+    LandmarkStore store;
+    VertexIds ids;
+    for(uint32_t i = 0; i < 40; i++){
+        uint32_t index = store.add(2.0*i, (i%2 == 0)?(0.0):(3.0), 1+static_cast<int>(i%2), ids.nextLandmark());
+        updated.addLandmark(store, index, i);
+    }
+    uint32_t triangles = updated.triangles();
+    updated.update(store);
+    REQUIRE(updated.triangles() == triangles);
+
+    //Moved out of reach of its neighbours, then back into a different constellation
+    uint64_t version = store.version();
+    store.setPosition(10, 20.0, 40.0);
+    std::vector<uint32_t> changed;
+    REQUIRE(store.changedSince(version, changed) == 1);
+    REQUIRE(changed[0] == 10);
+    updated.update(store);
+    REQUIRE(updated.triangles() < triangles);
+    store.setPosition(10, 21.0, 1.0);
+    store.setPosition(11, 22.5, 2.5);
+    updated.update(store);
+
+    PlaceRecognizer rebuilt(configuration);
+    for(uint32_t i = 0; i < store.size(); i++){
+        rebuilt.addLandmark(store, i, i);
+    }
+    rebuilt.rebuild(store);
+    REQUIRE(updated.triangles() == rebuilt.triangles());
+
+    //Both find the moved constellation again
+    Eigen::MatrixXd observed(3, 6);
+    for(uint32_t k = 0; k < 6; k++){
+        observed(0,k) = store.x(8+k)+0.5;
+        observed(1,k) = store.y(8+k)-0.3;
+        observed(2,k) = store.type(8+k);
+    }
+    LoopClosure updatedClosure;
+    LoopClosure rebuiltClosure;
+    Eigen::Vector3d pose(22.0, 1.0, 0.0);
+    REQUIRE(updated.recognize(store, observed, pose, 80, updatedClosure));
+    REQUIRE(rebuilt.recognize(store, observed, pose, 80, rebuiltClosure));
+    REQUIRE(updatedClosure.inliers == rebuiltClosure.inliers);
+    REQUIRE((updatedClosure.correction-rebuiltClosure.correction).norm() == Approx(0.0).margin(1e-9));
+}
+
+TEST_CASE("A stored map is found again from any pose.") {
+    //Irregular cones, every constellation is unique
+    LandmarkStore store;
+    VertexIds ids;
+    uint32_t seed = 12345;
+    for(uint32_t i = 0; i < 120; i++){
+        seed = seed*1103515245u+12345u;
+        double x = static_cast<double>((seed >> 8) % 6000)/100.0;
+        seed = seed*1103515245u+12345u;
+        double y = static_cast<double>((seed >> 8) % 6000)/100.0;
+        store.add(x, y, 1+static_cast<int>(i%2), ids.nextLandmark());
+    }
+    REQUIRE(saveMap("test-map.txt", store));
+    LandmarkStore loaded;
+    VertexIds loadedIds;
+    REQUIRE(loadMap("test-map.txt", loaded, loadedIds));
+    std::remove("test-map.txt");
+    REQUIRE(loaded.size() == store.size());
+    REQUIRE(loaded.x(17) == Approx(store.x(17)));
+    REQUIRE(loaded.type(18) == store.type(18));
+    REQUIRE(!loadMap("test-missing-map.txt", loaded, loadedIds));
+
+    //The cones around the car, in the car frame
+    std::map<std::string, std::string> configuration;
+    PlaceRecognizer recognizer(configuration);
+    recognizer.rebuild(loaded);
+    Eigen::Vector3d pose(31.0, 24.0, 2.0);
+    std::vector<uint32_t> around;
+    loaded.withinRadius(pose(0), pose(1), 12.0, -1, around);
+    Eigen::MatrixXd observed(3, around.size());
+    for(uint32_t i = 0; i < around.size(); i++){
+        double dx = loaded.x(around[i])-pose(0);
+        double dy = loaded.y(around[i])-pose(1);
+        observed(0,i) = std::cos(pose(2))*dx+std::sin(pose(2))*dy;
+        observed(1,i) = -std::sin(pose(2))*dx+std::cos(pose(2))*dy;
+        observed(2,i) = loaded.type(around[i]);
+    }
+    std::vector<LoopClosure> candidates;
+    REQUIRE(recognizer.relocalize(loaded, observed, 5, candidates) > 0);
+    REQUIRE(candidates[0].inliers == around.size());
+    REQUIRE(candidates[0].correction(0) == Approx(pose(0)));
+    REQUIRE(candidates[0].correction(1) == Approx(pose(1)));
+    REQUIRE(candidates[0].correction(2) == Approx(pose(2)));
+    for(uint32_t k = 1; k < candidates.size(); k++){
+        REQUIRE(candidates[k].inliers <= candidates[k-1].inliers);
+    }
+}
+
+TEST_CASE("Poses are extrapolated in the frame of a stored map.") {
+    //Far from the identity, an extrapolation left in the odometry frame misses by meters
+    g2o::SE2 odometryToMap(4.0, -2.0, 0.3);
+    std::map<std::string, std::string> configuration;
+    auto poses = driveThroughStoredMap(configuration, odometryToMap);
+    REQUIRE(poses.second(0) == Approx(poses.first(0)).margin(0.05));
+    REQUIRE(poses.second(1) == Approx(poses.first(1)).margin(0.05));
+    REQUIRE(poses.second(2) == Approx(poses.first(2)).margin(0.01));
+
+    //The filter backends correct the pose themselves, the extrapolator still starts from odometry
+    for(std::string backend : {"ekf", "fastslam"}){
+        configuration["backend"] = backend;
+        poses = driveThroughStoredMap(configuration, odometryToMap);
+        REQUIRE(poses.second(0) == Approx(poses.first(0)).margin(0.2));
+        REQUIRE(poses.second(1) == Approx(poses.first(1)).margin(0.2));
+        REQUIRE(poses.second(2) == Approx(poses.first(2)).margin(0.02));
+    }
+}
+
+TEST_CASE("EKF landmarks converge while the car drives past.") {
+    std::map<std::string, std::string> configuration = {{"backend", "ekf"}};
+    std::unique_ptr<FilterBackend> backend = makeFilterBackend(configuration);
+    REQUIRE(backend != nullptr);
+    configuration["backend"] = "graph";
+    REQUIRE(makeFilterBackend(configuration) == nullptr);
+
+    //Odometry is exact, the car drives along x past two cones
+    EkfSlam ekf(configuration);
+    Eigen::Vector2d cones[2] = {Eigen::Vector2d(10.0, 2.0), Eigen::Vector2d(14.0, -2.0)};
+    Eigen::Matrix2d firstCovariance = Eigen::Matrix2d::Zero();
+    for(uint32_t k = 0; k < 10; k++){
+        Eigen::Vector3d pose(static_cast<double>(k), 0.0, 0.0);
+        ekf.predict(pose);
+        FilterObservation observations[2];
+        for(uint32_t i = 0; i < 2; i++){
+            observations[i] = {i, cones[i](0)-pose(0), cones[i](1), k == 0};
+        }
+        ekf.update(observations, 2);
+        if(k == 0){
+            firstCovariance = ekf.landmarkCovariance(0);
+        }
+    }
+    REQUIRE(ekf.landmarks() == 2);
+    REQUIRE(ekf.landmarkCovariance(0).trace() < firstCovariance.trace());
+    REQUIRE(ekf.landmark(1)(0) == Approx(14.0));
+    REQUIRE(ekf.landmark(1)(1) == Approx(-2.0));
+    REQUIRE(ekf.pose()(0) == Approx(9.0));
+
+    //Odometry that overshoots is pulled back by the landmarks
+    ekf.predict(Eigen::Vector3d(11.0, 0.0, 0.0));
+    REQUIRE(ekf.pose()(0) == Approx(11.0));
+    FilterObservation observations[2] = {{0, 0.0, 2.0, false}, {1, 4.0, -2.0, false}};
+    ekf.update(observations, 2);
+    REQUIRE(std::fabs(ekf.pose()(0)-10.0) < 0.5);
+
+    //A stored landmark is taken as it is
+    ekf.addMappedLandmark(20.0, 5.0);
+    REQUIRE(ekf.landmarks() == 3);
+    REQUIRE(ekf.landmarkCovariance(2).trace() == Approx(0.0));
+}
+
+TEST_CASE("Landmark trees are shared until they change.") {
+    LandmarkTree tree;
+    for(uint32_t i = 0; i < 100; i++){
+        tree.push(LandmarkEstimate(static_cast<double>(i), 0.0, 1.0, 0.0, 1.0));
+    }
+    REQUIRE(tree.size() == 100);
+    REQUIRE(tree.get(73).x == Approx(73.0));
+
+    LandmarkTree copy = tree;
+    REQUIRE(copy.sharesAll(tree));
+    copy.set(42, LandmarkEstimate(-1.0, 0.0, 1.0, 0.0, 1.0));
+    REQUIRE(!copy.sharesAll(tree));
+    REQUIRE(copy.get(42).x == Approx(-1.0));
+    REQUIRE(tree.get(42).x == Approx(42.0));
+    REQUIRE(copy.get(43).x == Approx(43.0));
+    copy.push(LandmarkEstimate(100.0, 0.0, 1.0, 0.0, 1.0));
+    REQUIRE(copy.size() == 101);
+    REQUIRE(tree.size() == 100);
+
+    //The original no longer changes nodes it shares, even once the copy has let go of them
+    LandmarkTree second = tree;
+    second = copy;
+    tree.set(43, LandmarkEstimate(-2.0, 0.0, 1.0, 0.0, 1.0));
+    REQUIRE(tree.get(43).x == Approx(-2.0));
+    REQUIRE(copy.get(43).x == Approx(43.0));
+    REQUIRE(second.get(43).x == Approx(43.0));
+    REQUIRE(second.get(100).x == Approx(100.0));
+
+    //Every index is run exactly once, whichever thread takes it
+    ThreadPool pool(4);
+    std::vector<uint32_t> runs(1000, 0);
+    pool.run(static_cast<uint32_t>(runs.size()), [&runs](uint32_t i){runs[i]++;});
+    pool.run(static_cast<uint32_t>(runs.size()), [&runs](uint32_t i){runs[i]++;});
+    for(uint32_t runsOfIndex : runs){
+        REQUIRE(runsOfIndex == 2);
+    }
+}
+
+TEST_CASE("FastSLAM gives the same particles on any number of threads.") {
+    std::vector<std::vector<Particle>> results;
+    for(std::string threads : {"1", "3"}){
+        std::map<std::string, std::string> configuration = {{"particles", "20"}, {"particleThreads", threads}};
+        FastSlam fastSlam(configuration);
+        REQUIRE(fastSlam.threads() == static_cast<uint32_t>(std::stoi(threads)));
+        Eigen::Vector2d cones[2] = {Eigen::Vector2d(10.0, 2.0), Eigen::Vector2d(14.0, -2.0)};
+        for(uint32_t k = 0; k < 10; k++){
+            Eigen::Vector3d pose(static_cast<double>(k), 0.0, 0.0);
+            fastSlam.predict(pose);
+            FilterObservation observations[2];
+            for(uint32_t i = 0; i < 2; i++){
+                observations[i] = {i, cones[i](0)-pose(0), cones[i](1), k == 0};
+            }
+            fastSlam.update(observations, 2);
+        }
+        REQUIRE(fastSlam.landmarks() == 2);
+        REQUIRE(fastSlam.pose()(0) == Approx(9.0).margin(0.5));
+        REQUIRE(fastSlam.landmark(1)(0) == Approx(14.0).margin(0.5));
+        REQUIRE(fastSlam.landmark(1)(1) == Approx(-2.0).margin(0.5));
+        results.push_back(fastSlam.particles());
+    }
+    for(uint32_t i = 0; i < results[0].size(); i++){
+        REQUIRE(results[0][i].pose == results[1][i].pose);
+        REQUIRE(results[0][i].landmarks.get(0).x == results[1][i].landmarks.get(0).x);
+    }
+}
+
+TEST_CASE("Pose graphs are saved for the offline optimizer.") {
+    REQUIRE(makeOptimizationAlgorithm("no_such_solver", false) == nullptr);
+    g2o::SparseOptimizer optimizer;
+    optimizer.setAlgorithm(makeOptimizationAlgorithm("slam", false));
+
+    //Two poses, the first fixed, and a cone seen from the second
+    g2o::VertexSE2 *first = new g2o::VertexSE2();
+    first->setId(0);
+    first->setEstimate(g2o::SE2(1.0, 2.0, 0.5));
+    first->setFixed(true);
+    optimizer.addVertex(first);
+    g2o::VertexSE2 *second = new g2o::VertexSE2();
+    second->setId(1);
+    second->setEstimate(g2o::SE2(3.5, 2.25, -0.25));
+    optimizer.addVertex(second);
+    g2o::VertexPointXY *cone = new g2o::VertexPointXY();
+    cone->setId(2);
+    cone->setEstimate(Eigen::Vector2d(8.0, -1.5));
+    optimizer.addVertex(cone);
+
+    g2o::EdgeSE2 *odometry = new g2o::EdgeSE2();
+    odometry->vertices()[0] = first;
+    odometry->vertices()[1] = second;
+    odometry->setMeasurement(g2o::SE2(2.5, 0.25, -0.75));
+    Eigen::Matrix3d odometryInformation;
+    odometryInformation << 100.0, 2.0, 0.5,
+                           2.0, 50.0, 0.25,
+                           0.5, 0.25, 400.0;
+    odometry->setInformation(odometryInformation);
+    optimizer.addEdge(odometry);
+    EdgeRangeBearing *measurement = new EdgeRangeBearing();
+    measurement->vertices()[0] = second;
+    measurement->vertices()[1] = cone;
+    measurement->setSensorOffset(Eigen::Vector2d(1.5, 0.0));
+    measurement->setObservation(-12.5, 0.0, 5.75);
+    Eigen::Matrix2d measurementInformation;
+    measurementInformation << 100.0, 0.5,
+                              0.5, 13000.0;
+    measurement->setInformation(measurementInformation);
+    optimizer.addEdge(measurement);
+
+    std::string directory = temporaryDirectory();
+    std::string path = directory+"/graph.g2o";
+    REQUIRE(saveGraph(path, optimizer));
+    std::ifstream temporary(path+".tmp");
+    REQUIRE(!temporary.is_open());
+    g2o::SparseOptimizer loaded;
+    REQUIRE(loadGraph(path, loaded));
+    std::remove(path.c_str());
+    REQUIRE(!loadGraph(path, loaded));
+    REQUIRE(!saveGraph(directory+"/missing-directory/graph.g2o", optimizer));
+    rmdir(directory.c_str());
+
+    REQUIRE(loaded.vertices().size() == 3);
+    REQUIRE(loaded.edges().size() == 2);
+    g2o::VertexSE2 *loadedFirst = dynamic_cast<g2o::VertexSE2 *>(loaded.vertex(0));
+    g2o::VertexSE2 *loadedSecond = dynamic_cast<g2o::VertexSE2 *>(loaded.vertex(1));
+    g2o::VertexPointXY *loadedCone = dynamic_cast<g2o::VertexPointXY *>(loaded.vertex(2));
+    REQUIRE(loadedFirst != nullptr);
+    REQUIRE(loadedSecond != nullptr);
+    REQUIRE(loadedCone != nullptr);
+    REQUIRE(loadedFirst->fixed());
+    REQUIRE(!loadedSecond->fixed());
+    REQUIRE(!loadedCone->fixed());
+    REQUIRE((loadedFirst->estimate().toVector()-first->estimate().toVector()).norm() == Approx(0.0).margin(1e-9));
+    REQUIRE((loadedSecond->estimate().toVector()-second->estimate().toVector()).norm() == Approx(0.0).margin(1e-9));
+    REQUIRE((loadedCone->estimate()-cone->estimate()).norm() == Approx(0.0).margin(1e-9));
+
+    g2o::EdgeSE2 *loadedOdometry = nullptr;
+    EdgeRangeBearing *loadedMeasurement = nullptr;
+    for(g2o::HyperGraph::Edge *edge : loaded.edges()){
+        if(dynamic_cast<g2o::EdgeSE2 *>(edge) != nullptr){
+            loadedOdometry = dynamic_cast<g2o::EdgeSE2 *>(edge);
+        }
+        if(dynamic_cast<EdgeRangeBearing *>(edge) != nullptr){
+            loadedMeasurement = dynamic_cast<EdgeRangeBearing *>(edge);
+        }
+    }
+    REQUIRE(loadedOdometry != nullptr);
+    REQUIRE(loadedMeasurement != nullptr);
+    REQUIRE(loadedOdometry->vertices()[0] == loadedFirst);
+    REQUIRE(loadedOdometry->vertices()[1] == loadedSecond);
+    REQUIRE((loadedOdometry->measurement().toVector()-odometry->measurement().toVector()).norm() == Approx(0.0).margin(1e-9));
+    REQUIRE((loadedOdometry->information()-odometryInformation).norm() == Approx(0.0).margin(1e-9));
+    REQUIRE(loadedMeasurement->vertices()[0] == loadedSecond);
+    REQUIRE(loadedMeasurement->vertices()[1] == loadedCone);
+    REQUIRE((loadedMeasurement->measurement()-measurement->measurement()).norm() == Approx(0.0).margin(1e-9));
+    REQUIRE((loadedMeasurement->sensorOffset()-measurement->sensorOffset()).norm() == Approx(0.0).margin(1e-9));
+    REQUIRE((loadedMeasurement->information()-measurementInformation).norm() == Approx(0.0).margin(1e-9));
+}
+
+TEST_CASE("Range and bearing edges have analytic Jacobians.") {
+    g2o::VertexSE2 pose;
+    pose.setEstimate(g2o::SE2(2.0, -1.0, 0.4));
+    g2o::VertexPointXY cone;
+    cone.setEstimate(Eigen::Vector2d(9.0, 3.0));
+    EdgeRangeBearing edge;
+    edge.vertices()[0] = &pose;
+    edge.vertices()[1] = &cone;
+    edge.setSensorOffset(Eigen::Vector2d(1.5, 0.0));
+
+    //The measurement perception would send for this cone
+    double dx = std::cos(0.4)*7.0+std::sin(0.4)*4.0-1.5;
+    double dy = -std::sin(0.4)*7.0+std::cos(0.4)*4.0;
+    edge.setObservation(std::atan2(dy, dx)*180.0/M_PI, 0.0, std::sqrt(dx*dx+dy*dy));
+    edge.computeError();
+    REQUIRE(edge.error().norm() == Approx(0.0).margin(1e-9));
+
+    //Against central differences of the error
+    cone.setEstimate(Eigen::Vector2d(8.5, 3.7));
+    edge.linearizeOplus();
+    Eigen::Matrix<double,2,3> poseJacobian = edge.jacobianOplusXi();
+    Eigen::Matrix2d coneJacobian = edge.jacobianOplusXj();
+    const double step = 1e-6;
+    for(uint32_t k = 0; k < 3; k++){
+        Eigen::Vector3d delta = Eigen::Vector3d::Zero();
+        delta(k) = step;
+        Eigen::Vector3d estimate = pose.estimate().toVector();
+        pose.setEstimate(g2o::SE2(estimate+delta));
+        edge.computeError();
+        Eigen::Vector2d plus = edge.error();
+        pose.setEstimate(g2o::SE2(estimate-delta));
+        edge.computeError();
+        Eigen::Vector2d minus = edge.error();
+        pose.setEstimate(g2o::SE2(estimate));
+        for(uint32_t i = 0; i < 2; i++){
+            REQUIRE(poseJacobian(i,k) == Approx((plus(i)-minus(i))/(2*step)).margin(1e-6));
+        }
+    }
+    for(uint32_t k = 0; k < 2; k++){
+        Eigen::Vector2d delta = Eigen::Vector2d::Zero();
+        delta(k) = step;
+        Eigen::Vector2d estimate = cone.estimate();
+        cone.setEstimate(estimate+delta);
+        edge.computeError();
+        Eigen::Vector2d plus = edge.error();
+        cone.setEstimate(estimate-delta);
+        edge.computeError();
+        Eigen::Vector2d minus = edge.error();
+        cone.setEstimate(estimate);
+        for(uint32_t i = 0; i < 2; i++){
+            REQUIRE(coneJacobian(i,k) == Approx((plus(i)-minus(i))/(2*step)).margin(1e-6));
+        }
+    }
+
+    //Saved and read back
+    edge.setInformation(Eigen::Vector2d(100.0, 13000.0).asDiagonal());
+    std::stringstream stream;
+    REQUIRE(edge.write(stream));
+    EdgeRangeBearing loaded;
+    REQUIRE(loaded.read(stream));
+    REQUIRE(loaded.measurement()(1) == Approx(edge.measurement()(1)));
+    REQUIRE(loaded.sensorOffset()(0) == Approx(1.5));
+    REQUIRE(loaded.information()(1,1) == Approx(13000.0));
+    edge.vertices()[0] = nullptr;
+    edge.vertices()[1] = nullptr;
+}
+
+TEST_CASE("Parallel linearization matches one thread bit for bit.") {
+    std::vector<std::map<std::pair<int,int>,std::vector<double>>> results;
+    for(uint32_t threads : {1u, 3u}){
+        g2o::SparseOptimizer optimizer;
+        optimizer.setAlgorithm(makeOptimizationAlgorithm("slam", false, threads));
+        for(int i = 0; i < 10; i++){
+            g2o::VertexSE2 *pose = new g2o::VertexSE2();
+            pose->setId(i);
+            pose->setEstimate(g2o::SE2(i*1.1, 0.1*std::sin(i), 0.05*i));
+            pose->setFixed(i == 0);
+            optimizer.addVertex(pose);
+        }
+        for(int j = 0; j < 20; j++){
+            g2o::VertexPointXY *cone = new g2o::VertexPointXY();
+            cone->setId(1000+j);
+            cone->setEstimate(Eigen::Vector2d(j*0.6, (j%2 == 0)?(2.5):(-2.5)));
+            optimizer.addVertex(cone);
+        }
+        for(int i = 0; i < 10; i++){
+            for(int j = i; j < i+8 && j < 20; j++){
+                EdgeRangeBearing *edge = new EdgeRangeBearing();
+                edge->vertices()[0] = optimizer.vertex(i);
+                edge->vertices()[1] = optimizer.vertex(1000+j);
+                edge->setSensorOffset(Eigen::Vector2d(1.5, 0.0));
+                edge->setObservation(10.0*(j-i)-30.0, 1.0, 2.0+0.3*j);
+                edge->setInformation(Eigen::Vector2d(100.0, 13000.0).asDiagonal());
+                optimizer.addEdge(edge);
+            }
+        }
+        optimizer.initializeOptimization();
+        optimizer.optimize(3);
+
+        //Errors and Jacobians as g2o last saw them, by pose and cone
+        std::map<std::pair<int,int>,std::vector<double>> edges;
+        for(auto edge : optimizer.activeEdges()){
+            EdgeRangeBearing *rangeBearing = dynamic_cast<EdgeRangeBearing*>(edge);
+            REQUIRE(rangeBearing != nullptr);
+            std::vector<double> &values = edges[std::make_pair(edge->vertices()[0]->id(), edge->vertices()[1]->id())];
+            values.insert(values.end(), rangeBearing->error().data(), rangeBearing->error().data()+2);
+            values.insert(values.end(), rangeBearing->jacobianOplusXi().data(), rangeBearing->jacobianOplusXi().data()+6);
+            values.insert(values.end(), rangeBearing->jacobianOplusXj().data(), rangeBearing->jacobianOplusXj().data()+4);
+        }
+        REQUIRE(edges.size() == optimizer.activeEdges().size());
+        results.push_back(edges);
+    }
+    REQUIRE(results[0].size() == results[1].size());
+    for(auto const &edge : results[0]){
+        std::vector<double> const &other = results[1][edge.first];
+        REQUIRE(other.size() == 12);
+        REQUIRE(std::memcmp(edge.second.data(), other.data(), 12*sizeof(double)) == 0);
+    }
+}